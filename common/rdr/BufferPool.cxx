@@ -0,0 +1,137 @@
+/* Copyright (C) 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+#include <rdr/BufferPool.h>
+
+using namespace rdr;
+
+// Size classes are powers of two from 1 KiB to 32 MiB, which is as
+// large as any stream will grow. Larger buffers are never kept.
+static const int MinSizeClass = 10;
+static const int MaxSizeClass = 25;
+
+// Limits on how much unused memory is kept around
+static const size_t MaxFreePerClass = 8;
+static const size_t MaxFreeBytes = 64 * 1024 * 1024;
+
+struct Pool {
+  std::mutex mutex;
+  std::vector<uint8_t*> free[MaxSizeClass + 1];
+  size_t freeBytes;
+
+  std::atomic<unsigned long long> heapAllocations;
+  std::atomic<unsigned long long> reuses;
+};
+
+// Streams may be created and destroyed during static construction and
+// destruction, so the pool is created on first use and never freed
+static Pool* getPool()
+{
+  static Pool* pool = new Pool();
+  return pool;
+}
+
+static int sizeClass(size_t size)
+{
+  int sc;
+
+  sc = MinSizeClass;
+  while ((sc <= MaxSizeClass) && (((size_t)1 << sc) < size))
+    sc++;
+
+  return sc;
+}
+
+uint8_t* BufferPool::get(size_t* size)
+{
+  Pool* pool;
+  int sc;
+
+  pool = getPool();
+
+  sc = sizeClass(*size);
+  if (sc > MaxSizeClass) {
+    pool->heapAllocations++;
+    return new uint8_t[*size];
+  }
+
+  *size = (size_t)1 << sc;
+
+  {
+    const std::lock_guard<std::mutex> lock(pool->mutex);
+
+    if (!pool->free[sc].empty()) {
+      uint8_t* buffer;
+
+      buffer = pool->free[sc].back();
+      pool->free[sc].pop_back();
+      pool->freeBytes -= *size;
+
+      pool->reuses++;
+
+      return buffer;
+    }
+  }
+
+  pool->heapAllocations++;
+
+  return new uint8_t[*size];
+}
+
+void BufferPool::put(uint8_t* buffer, size_t size)
+{
+  Pool* pool;
+  int sc;
+
+  if (buffer == nullptr)
+    return;
+
+  pool = getPool();
+
+  sc = sizeClass(size);
+  if ((sc <= MaxSizeClass) && (((size_t)1 << sc) == size)) {
+    const std::lock_guard<std::mutex> lock(pool->mutex);
+
+    if ((pool->free[sc].size() < MaxFreePerClass) &&
+        (pool->freeBytes + size <= MaxFreeBytes)) {
+      pool->free[sc].push_back(buffer);
+      pool->freeBytes += size;
+      return;
+    }
+  }
+
+  delete [] buffer;
+}
+
+unsigned long long BufferPool::heapAllocations()
+{
+  return getPool()->heapAllocations;
+}
+
+unsigned long long BufferPool::reuses()
+{
+  return getPool()->reuses;
+}
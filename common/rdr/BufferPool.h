@@ -0,0 +1,53 @@
+/* Copyright (C) 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+//
+// BufferPool hands out the buffers used by the streams. Sizes are
+// rounded up to a power of two and released buffers are kept for
+// reuse, so streams that grow, shrink or are only used briefly don't
+// have to go to the heap every time.
+//
+
+#ifndef __RDR_BUFFERPOOL_H__
+#define __RDR_BUFFERPOOL_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace rdr {
+
+  class BufferPool {
+  public:
+    // get() returns a buffer of at least *size bytes, and updates
+    // *size with how large the buffer actually is
+    static uint8_t* get(size_t* size);
+
+    // put() returns a buffer to the pool. The size must be the one
+    // that get() gave.
+    static void put(uint8_t* buffer, size_t size);
+
+    // heapAllocations() returns how many times a buffer had to be
+    // allocated from the heap, and reuses() how many times one could
+    // be taken from the pool instead
+    static unsigned long long heapAllocations();
+    static unsigned long long reuses();
+  };
+
+}
+
+#endif
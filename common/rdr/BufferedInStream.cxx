@@ -25,6 +25,7 @@
 
 #include <core/string.h>
 
+#include <rdr/BufferPool.h>
 #include <rdr/BufferedInStream.h>
 
 using namespace rdr;
@@ -35,14 +36,14 @@ static const size_t MAX_BUF_SIZE = 32 * 1024 * 1024;
 BufferedInStream::BufferedInStream()
   : bufSize(DEFAULT_BUF_SIZE), offset(0)
 {
-  ptr = end = start = new uint8_t[bufSize];
+  ptr = end = start = BufferPool::get(&bufSize);
   gettimeofday(&lastSizeCheck, nullptr);
   peakUsage = 0;
 }
 
 BufferedInStream::~BufferedInStream()
 {
-  delete [] start;
+  BufferPool::put(start, bufSize);
 }
 
 size_t BufferedInStream::pos()
@@ -73,9 +74,9 @@ void BufferedInStream::ensureSpace(size_t needed)
     while (newSize < needed)
       newSize *= 2;
 
-    newBuffer = new uint8_t[newSize];
+    newBuffer = BufferPool::get(&newSize);
     memcpy(newBuffer, ptr, end - ptr);
-    delete [] start;
+    BufferPool::put(start, bufSize);
     bufSize = newSize;
 
     offset += ptr - start;
@@ -102,8 +103,8 @@ void BufferedInStream::ensureSpace(size_t needed)
         newSize *= 2;
 
       // We know the buffer is empty, so just reset everything
-      delete [] start;
-      ptr = end = start = new uint8_t[newSize];
+      BufferPool::put(start, bufSize);
+      ptr = end = start = BufferPool::get(&newSize);
       bufSize = newSize;
     }
 
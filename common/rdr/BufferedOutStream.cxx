@@ -24,6 +24,7 @@
 
 #include <core/string.h>
 
+#include <rdr/BufferPool.h>
 #include <rdr/BufferedOutStream.h>
 
 using namespace rdr;
@@ -34,7 +35,7 @@ static const size_t MAX_BUF_SIZE = 32 * 1024 * 1024;
 BufferedOutStream::BufferedOutStream(bool emulateCork_)
   : bufSize(DEFAULT_BUF_SIZE), offset(0), emulateCork(emulateCork_)
 {
-  ptr = start = sentUpTo = new uint8_t[bufSize];
+  ptr = start = sentUpTo = BufferPool::get(&bufSize);
   end = start + bufSize;
   gettimeofday(&lastSizeCheck, nullptr);
   peakUsage = 0;
@@ -43,7 +44,7 @@ BufferedOutStream::BufferedOutStream(bool emulateCork_)
 BufferedOutStream::~BufferedOutStream()
 {
   // FIXME: Complain about non-flushed buffer?
-  delete [] start;
+  BufferPool::put(start, bufSize);
 }
 
 size_t BufferedOutStream::length()
@@ -87,8 +88,8 @@ void BufferedOutStream::flush()
         newSize *= 2;
 
       // We know the buffer is empty, so just reset everything
-      delete [] start;
-      ptr = start = sentUpTo = new uint8_t[newSize];
+      BufferPool::put(start, bufSize);
+      ptr = start = sentUpTo = BufferPool::get(&newSize);
       end = start + newSize;
       bufSize = newSize;
     }
@@ -147,9 +148,9 @@ void BufferedOutStream::overrun(size_t needed)
   while (newSize < totalNeeded)
     newSize *= 2;
 
-  newBuffer = new uint8_t[newSize];
+  newBuffer = BufferPool::get(&newSize);
   memcpy(newBuffer, sentUpTo, ptr - sentUpTo);
-  delete [] start;
+  BufferPool::put(start, bufSize);
   bufSize = newSize;
 
   ptr = newBuffer + (ptr - sentUpTo);
@@ -47,16 +47,44 @@
 
 using namespace rdr;
 
+// Descriptors that aren't taken are dropped beyond this, so that the
+// other end can't make us run out of them
+static const size_t MaxReceivedFds = 16;
+
 FdInStream::FdInStream(int fd_, bool closeWhenDone_)
-  : fd(fd_), closeWhenDone(closeWhenDone_)
+  : fd(fd_), closeWhenDone(closeWhenDone_), acceptingFds(false)
 {
 }
 
 FdInStream::~FdInStream()
 {
+  while (!receivedFds.empty()) {
+    close(receivedFds.front());
+    receivedFds.pop_front();
+  }
+
   if (closeWhenDone) close(fd);
 }
 
+void FdInStream::acceptFds(bool enable)
+{
+  acceptingFds = enable;
+}
+
+int FdInStream::takeFd()
+{
+  const std::lock_guard<std::mutex> lock(fdMutex);
+  int received;
+
+  if (receivedFds.empty())
+    return -1;
+
+  received = receivedFds.front();
+  receivedFds.pop_front();
+
+  return received;
+}
+
 
 bool FdInStream::fillBuffer()
 {
@@ -99,7 +127,62 @@ size_t FdInStream::readFd(uint8_t* buf, size_t len)
     return 0;
 
   do {
-    n = ::recv(fd, (char*)buf, len, 0);
+#ifndef _WIN32
+    if (acceptingFds) {
+      struct msghdr msg;
+      struct iovec iov;
+      struct cmsghdr* cmsg;
+      union {
+        char buf[CMSG_SPACE(sizeof(int) * MaxReceivedFds)];
+        struct cmsghdr align;
+      } control;
+      int flags;
+
+      iov.iov_base = buf;
+      iov.iov_len = len;
+
+      memset(&msg, 0, sizeof(msg));
+      msg.msg_iov = &iov;
+      msg.msg_iovlen = 1;
+      msg.msg_control = control.buf;
+      msg.msg_controllen = sizeof(control.buf);
+
+      flags = 0;
+#ifdef MSG_CMSG_CLOEXEC
+      flags |= MSG_CMSG_CLOEXEC;
+#endif
+
+      n = ::recvmsg(fd, &msg, flags);
+
+      for (cmsg = (n < 0) ? nullptr : CMSG_FIRSTHDR(&msg);
+           cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        const std::lock_guard<std::mutex> lock(fdMutex);
+        size_t i, count;
+
+        if ((cmsg->cmsg_level != SOL_SOCKET) ||
+            (cmsg->cmsg_type != SCM_RIGHTS))
+          continue;
+
+        count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        for (i = 0; i < count; i++) {
+          int received;
+
+          memcpy(&received, CMSG_DATA(cmsg) + i * sizeof(int),
+                 sizeof(int));
+
+          if (receivedFds.size() >= MaxReceivedFds) {
+            close(received);
+            continue;
+          }
+
+          receivedFds.push_back(received);
+        }
+      }
+    } else
+#endif
+    {
+      n = ::recv(fd, (char*)buf, len, 0);
+    }
   } while (n < 0 && errorNumber == EINTR);
 
   if (n < 0)
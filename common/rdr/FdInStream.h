@@ -23,6 +23,9 @@
 #ifndef __RDR_FDINSTREAM_H__
 #define __RDR_FDINSTREAM_H__
 
+#include <list>
+#include <mutex>
+
 #include <rdr/BufferedInStream.h>
 
 namespace rdr {
@@ -36,6 +39,17 @@ namespace rdr {
 
     int getFd() { return fd; }
 
+    // acceptFds() makes the stream keep file descriptors passed by the
+    // other end (see FdOutStream::sendFd()). Otherwise they are
+    // discarded.
+    void acceptFds(bool enable);
+
+    // takeFd() returns the oldest received file descriptor, or -1 if
+    // there is none. The caller becomes responsible for closing it.
+    // It is safe to call this from another thread than the one
+    // reading the stream.
+    int takeFd();
+
   private:
     bool fillBuffer() override;
 
@@ -43,6 +57,10 @@ namespace rdr {
 
     int fd;
     bool closeWhenDone;
+
+    bool acceptingFds;
+    std::mutex fdMutex;
+    std::list<int> receivedFds;
   };
 
 } // end of namespace rdr
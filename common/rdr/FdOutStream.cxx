@@ -25,6 +25,9 @@
 #include <stdio.h>
 #include <string.h>
 #include <errno.h>
+
+#include <stdexcept>
+
 #ifdef _WIN32
 #include <winsock2.h>
 #define errorNumber WSAGetLastError()
@@ -64,6 +67,12 @@ FdOutStream::FdOutStream(int fd_)
 
 FdOutStream::~FdOutStream()
 {
+#ifndef _WIN32
+  while (!pendingFds.empty()) {
+    ::close(pendingFds.front().fd);
+    pendingFds.pop_front();
+  }
+#endif
 }
 
 unsigned FdOutStream::getIdleTime()
@@ -81,12 +90,60 @@ void FdOutStream::cork(bool enable)
 #endif
 }
 
+void FdOutStream::sendFd(int passFd)
+{
+#ifdef _WIN32
+  (void)passFd;
+  throw std::logic_error("Passing file descriptors is not supported");
+#else
+  PendingFd pending;
+
+  // The caller might close its descriptor before we get to send it
+  pending.fd = dup(passFd);
+  if (pending.fd < 0)
+    throw core::posix_error("dup", errno);
+
+  pending.pos = length();
+  pendingFds.push_back(pending);
+#endif
+}
+
 bool FdOutStream::flushBuffer()
 {
-  size_t n = writeFd(sentUpTo, ptr - sentUpTo);
+  size_t pos, len, n;
+  int passFd;
+
+  len = ptr - sentUpTo;
+  passFd = -1;
+
+  if (!pendingFds.empty()) {
+    std::list<PendingFd>::iterator next;
+
+    pos = length() - len;
+
+    next = pendingFds.begin();
+    if (next->pos == pos) {
+      passFd = next->fd;
+      ++next;
+    }
+
+    // A descriptor has to be sent with the right byte, so stop short
+    // of the next one
+    if ((next != pendingFds.end()) && (next->pos < pos + len))
+      len = next->pos - pos;
+  }
+
+  n = writeFd(sentUpTo, len, passFd);
   if (n == 0)
     return false;
 
+  if (passFd != -1) {
+#ifndef _WIN32
+    ::close(passFd);
+#endif
+    pendingFds.pop_front();
+  }
+
   sentUpTo += n;
 
   return true;
@@ -94,14 +151,16 @@ bool FdOutStream::flushBuffer()
 
 //
 // writeFd() writes up to the given length in bytes from the given
-// buffer to the file descriptor. It returns the number of bytes written.  It
+// buffer to the file descriptor, passing along passFd unless it is -1.
+// It returns the number of bytes written.  It
 // never attempts to send() unless select() indicates that the fd is writable
 // - this means it can be used on an fd which has been set non-blocking.  It
 // also has to cope with the annoying possibility of both select() and send()
 // returning EINTR.
 //
 
-size_t FdOutStream::writeFd(const uint8_t* data, size_t length)
+size_t FdOutStream::writeFd(const uint8_t* data, size_t length,
+                            int passFd)
 {
   int n;
 
@@ -123,14 +182,44 @@ size_t FdOutStream::writeFd(const uint8_t* data, size_t length)
     return 0;
 
   do {
-    // select only guarantees that you can write SO_SNDLOWAT without
-    // blocking, which is normally 1. Use MSG_DONTWAIT to avoid
-    // blocking, when possible.
+#ifndef _WIN32
+    if (passFd != -1) {
+      struct msghdr msg;
+      struct iovec iov;
+      struct cmsghdr* cmsg;
+      union {
+        char buf[CMSG_SPACE(sizeof(int))];
+        struct cmsghdr align;
+      } control;
+
+      iov.iov_base = (void*)data;
+      iov.iov_len = length;
+
+      memset(&msg, 0, sizeof(msg));
+      msg.msg_iov = &iov;
+      msg.msg_iovlen = 1;
+      msg.msg_control = control.buf;
+      msg.msg_controllen = sizeof(control.buf);
+
+      cmsg = CMSG_FIRSTHDR(&msg);
+      cmsg->cmsg_level = SOL_SOCKET;
+      cmsg->cmsg_type = SCM_RIGHTS;
+      cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+      memcpy(CMSG_DATA(cmsg), &passFd, sizeof(int));
+
+      n = ::sendmsg(fd, &msg, MSG_DONTWAIT);
+    } else
+#endif
+    {
+      // select only guarantees that you can write SO_SNDLOWAT without
+      // blocking, which is normally 1. Use MSG_DONTWAIT to avoid
+      // blocking, when possible.
 #ifndef MSG_DONTWAIT
-    n = ::send(fd, (const char*)data, length, 0);
+      n = ::send(fd, (const char*)data, length, 0);
 #else
-    n = ::send(fd, (const char*)data, length, MSG_DONTWAIT);
+      n = ::send(fd, (const char*)data, length, MSG_DONTWAIT);
 #endif
+    }
   } while (n < 0 && (errorNumber == EINTR));
 
   if (n < 0)
@@ -26,6 +26,8 @@
 
 #include <sys/time.h>
 
+#include <list>
+
 #include <rdr/BufferedOutStream.h>
 
 namespace rdr {
@@ -43,11 +45,23 @@ namespace rdr {
 
     void cork(bool enable) override;
 
+    // sendFd() passes a copy of the given file descriptor to the other
+    // end, along with the next byte written to the stream. Only
+    // possible on UNIX sockets, and the other end must be prepared to
+    // receive it (see FdInStream::acceptFds()).
+    void sendFd(int fd);
+
   private:
     bool flushBuffer() override;
-    size_t writeFd(const uint8_t* data, size_t length);
+    size_t writeFd(const uint8_t* data, size_t length, int passFd);
     int fd;
     struct timeval lastWrite;
+
+    struct PendingFd {
+      size_t pos;
+      int fd;
+    };
+    std::list<PendingFd> pendingFds;
   };
 
 }
@@ -23,6 +23,7 @@
 #ifndef __RDR_MEMOUTSTREAM_H__
 #define __RDR_MEMOUTSTREAM_H__
 
+#include <rdr/BufferPool.h>
 #include <rdr/OutStream.h>
 
 namespace rdr {
@@ -32,12 +33,13 @@ namespace rdr {
   public:
 
     MemOutStream(int len=1024) {
-      start = ptr = new uint8_t[len];
-      end = start + len;
+      size_t size = len;
+      start = ptr = BufferPool::get(&size);
+      end = start + size;
     }
 
     virtual ~MemOutStream() {
-      delete [] start;
+      BufferPool::put(start, end - start);
     }
 
     size_t length() override { return ptr - start; }
@@ -62,10 +64,10 @@ namespace rdr {
       if (len < (size_t)(end - start))
         throw std::out_of_range("Overflow in MemOutStream::overrun()");
 
-      uint8_t* newStart = new uint8_t[len];
+      uint8_t* newStart = BufferPool::get(&len);
       memcpy(newStart, start, ptr - start);
       ptr = newStart + (ptr - start);
-      delete [] start;
+      BufferPool::put(start, end - start);
       start = newStart;
       end = newStart + len;
     }
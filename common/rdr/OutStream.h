@@ -53,22 +53,55 @@ namespace rdr {
 
     // writeU/SN() methods write unsigned and signed N-bit integers.
 
-    inline void writeU8( uint8_t  u) { check(1); *ptr++ = u; }
-    inline void writeU16(uint16_t u) { check(2); *ptr++ = u >> 8;
-                                       *ptr++ = (uint8_t)u; }
-    inline void writeU32(uint32_t u) { check(4); *ptr++ = u >> 24;
-                                       *ptr++ = u >> 16;
-                                       *ptr++ = u >> 8;
-                                       *ptr++ = u; }
+    inline void writeU8( uint8_t  u) { check(1); putU8(ptr, u); }
+    inline void writeU16(uint16_t u) { check(2); putU16(ptr, u); }
+    inline void writeU32(uint32_t u) { check(4); putU32(ptr, u); }
 
     inline void writeS8( int8_t  s) { writeU8((uint8_t)s); }
     inline void writeS16(int16_t s) { writeU16((uint16_t)s); }
     inline void writeS32(int32_t s) { writeU32((uint32_t)s); }
 
     inline void pad(size_t bytes) {
-      while (bytes-- > 0) writeU8(0);
+      while (bytes > 0) {
+        check(1);
+        size_t n = bytes;
+        if (bytes > avail())
+          n = avail();
+        memset(ptr, 0, n);
+        ptr += n;
+        bytes -= n;
+      }
     }
 
+    // reserve() and commit() allow a larger chunk of data to be
+    // written directly in to the buffer, without checking for space
+    // for every value. reserve() makes sure there is room for at least
+    // length bytes and returns where they should be written. commit()
+    // is then given the position just after the last byte that was
+    // written. Nothing else may be written to the stream in between.
+
+    inline uint8_t* reserve(size_t length) { check(length); return ptr; }
+    inline void commit(uint8_t* pos) {
+      if ((pos < ptr) || (pos > end))
+        throw std::out_of_range("Output stream overflow");
+      ptr = pos;
+    }
+
+    // putU/SN() store values in space returned by reserve() and
+    // advance the given position
+
+    static inline void putU8( uint8_t*& p, uint8_t  u) { *p++ = u; }
+    static inline void putU16(uint8_t*& p, uint16_t u) { *p++ = u >> 8;
+                                                         *p++ = (uint8_t)u; }
+    static inline void putU32(uint8_t*& p, uint32_t u) { *p++ = u >> 24;
+                                                         *p++ = u >> 16;
+                                                         *p++ = u >> 8;
+                                                         *p++ = u; }
+
+    static inline void putS8( uint8_t*& p, int8_t  s) { putU8(p, (uint8_t)s); }
+    static inline void putS16(uint8_t*& p, int16_t s) { putU16(p, (uint16_t)s); }
+    static inline void putS32(uint8_t*& p, int32_t s) { putU32(p, (uint32_t)s); }
+
     // writeBytes() writes an exact number of bytes.
 
     void writeBytes(const uint8_t* data, size_t length) {
@@ -40,6 +40,10 @@ namespace rdr {
     void flushUnderlying();
     void reset();
 
+    // bytesLeft() is how much of the compressed data has not yet been
+    // taken from the underlying stream
+    size_t bytesLeft() const { return bytesIn; }
+
   private:
     void init();
     void deinit();
@@ -43,6 +43,8 @@
 #include <rfb/PixelBuffer.h>
 #include <rfb/Security.h>
 #include <rfb/SecurityClient.h>
+#include <rfb/SharedMemory.h>
+#include <rfb/TileCache.h>
 #include <rfb/CConnection.h>
 
 #define XK_MISCELLANY
@@ -64,11 +66,12 @@ CConnection::CConnection()
   : csecurity(nullptr),
     supportsLocalCursor(false), supportsCursorPosition(false),
     supportsDesktopResize(false), supportsLEDState(false),
+    supportsCursorCache(false), supportsSharedMemory(false),
     is(nullptr), os(nullptr), reader_(nullptr), writer_(nullptr),
     shared(false),
     state_(RFBSTATE_UNINITIALISED),
     pendingPFChange(false), preferredEncoding(encodingTight),
-    compressLevel(2), qualityLevel(-1),
+    compressLevel(2), qualityLevel(-1), tileCacheSize(0),
     formatChange(false), encodingChange(false),
     firstUpdate(true), pendingUpdate(false), continuousUpdates(false),
     forceNonincremental(true),
@@ -513,6 +516,33 @@ void CConnection::supportsExtendedMouseButtons()
   server.supportsExtendedMouseButtons = true;
 }
 
+void CConnection::setSharedMemory(uint32_t size)
+{
+  SharedMemory* shm;
+  int fd;
+
+  // The server passes the buffer before announcing it. If it got lost
+  // on the way we simply don't attach, and the server will keep
+  // sending normal rects.
+  fd = takeFd();
+  if (fd == -1) {
+    vlog.error("Server announced shared memory, but didn't pass it");
+    return;
+  }
+
+  try {
+    shm = new SharedMemory(fd, size);
+  } catch (std::exception& e) {
+    vlog.error("Unable to use shared memory: %s", e.what());
+    return;
+  }
+
+  decoder.setSharedMemory(shm);
+  shm->attach();
+
+  vlog.info("Using shared memory for framebuffer updates");
+}
+
 void CConnection::serverInit(int width, int height,
                              const PixelFormat& pf,
                              const char* name)
@@ -736,6 +766,11 @@ void CConnection::handleClipboardData(const char* /*data*/)
 {
 }
 
+int CConnection::takeFd()
+{
+  return -1;
+}
+
 void CConnection::requestClipboard()
 {
   if (hasRemoteClipboard) {
@@ -930,6 +965,20 @@ int CConnection::getQualityLevel()
   return qualityLevel;
 }
 
+void CConnection::setTileCacheSize(int size)
+{
+  if (tileCacheSize == size)
+    return;
+
+  tileCacheSize = size;
+  encodingChange = true;
+}
+
+int CConnection::getTileCacheSize()
+{
+  return tileCacheSize;
+}
+
 void CConnection::setPF(const PixelFormat& pf)
 {
   if (server.pf() == pf && !formatChange)
@@ -999,6 +1048,8 @@ void CConnection::updateEncodings()
   std::list<uint32_t> encodings;
 
   if (supportsLocalCursor) {
+    if (supportsCursorCache)
+      encodings.push_back(pseudoEncodingCursorCache);
     encodings.push_back(pseudoEncodingCursorWithAlpha);
     encodings.push_back(pseudoEncodingVMwareCursor);
     encodings.push_back(pseudoEncodingCursor);
@@ -1035,10 +1086,35 @@ void CConnection::updateEncodings()
     if ((i != preferredEncoding) && Decoder::supported(i)) {
       if (noJpeg && i == encodingJPEG)
         continue;
+      // Only used if we also tell the server the size of the cache
+      if (i == encodingTileCache)
+        continue;
+      // Or that we can receive shared memory
+      if (i == encodingSharedMemory)
+        continue;
       encodings.push_back(i);
     }
   }
 
+  if (tileCacheSize > 0) {
+    int level;
+
+    // Round down to a power of two
+    level = 0;
+    while ((level < tileCacheMaxLevel) && ((2 << level) <= tileCacheSize))
+      level++;
+
+    decoder.setTileCacheSize((size_t)tileCacheTilesPerMiB << level);
+
+    encodings.push_back(encodingTileCache);
+    encodings.push_back(pseudoEncodingTileCacheSize0 + level);
+  }
+
+  if (supportsSharedMemory && Decoder::supported(encodingSharedMemory)) {
+    encodings.push_back(encodingSharedMemory);
+    encodings.push_back(pseudoEncodingSharedMemory);
+  }
+
   if (compressLevel >= 0 && compressLevel <= 9)
       encodings.push_back(pseudoEncodingCompressLevel0 + compressLevel);
   // Tight JPEG is enabled by setting a quality level
@@ -153,6 +153,11 @@ namespace rfb {
     int getCompressLevel();
     void setQualityLevel(int level);
     int getQualityLevel();
+    // setTileCacheSize() controls how much memory (in MiB) the server
+    // may use for caching tiles in the client. Zero disables the
+    // cache. It can only be grown once the connection is running.
+    void setTileCacheSize(int size);
+    int getTileCacheSize();
     // setPF() controls the pixel format requested from the server.
     // server.pf() will automatically be adjusted once the new format
     // is active.
@@ -223,6 +228,8 @@ namespace rfb {
 
     void supportsExtendedMouseButtons() override;
 
+    void setSharedMemory(uint32_t size) override;
+
     void serverInit(int width, int height, const PixelFormat& pf,
                     const char* name) override;
 
@@ -282,6 +289,11 @@ namespace rfb {
     // server received the request.
     virtual void handleClipboardData(const char* data);
 
+    // takeFd() returns the next file descriptor the server has passed
+    // over the connection, or -1 if there is none. Must be implemented
+    // by a subclass that sets supportsSharedMemory.
+    virtual int takeFd();
+
   protected:
     CSecurity *csecurity;
     SecurityClient security;
@@ -301,6 +313,10 @@ namespace rfb {
     bool supportsCursorPosition;
     bool supportsDesktopResize;
     bool supportsLEDState;
+    // Private extension, so only if the user asks for it
+    bool supportsCursorCache;
+    // Only over a connection that can pass file descriptors
+    bool supportsSharedMemory;
 
   private:
     bool processVersionMsg();
@@ -331,6 +347,7 @@ namespace rfb {
     int preferredEncoding;
     int compressLevel;
     int qualityLevel;
+    int tileCacheSize;
 
     bool formatChange;
     rfb::PixelFormat nextPF;
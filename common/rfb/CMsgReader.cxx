@@ -34,9 +34,11 @@
 
 #include <rfb/msgTypes.h>
 #include <rfb/clipboardTypes.h>
+#include <rfb/ClipboardInflater.h>
 #include <rfb/Exception.h>
 #include <rfb/CMsgHandler.h>
 #include <rfb/CMsgReader.h>
+#include <rfb/CursorCache.h>
 #include <rfb/PixelBuffer.h>
 #include <rfb/ScreenSet.h>
 #include <rfb/encodings.h>
@@ -52,12 +54,15 @@ using namespace rfb;
 
 CMsgReader::CMsgReader(CMsgHandler* handler_, rdr::InStream* is_)
   : imageBufIdealSize(0), handler(handler_), is(is_),
-    state(MSGSTATE_IDLE), cursorEncoding(-1)
+    state(MSGSTATE_IDLE), cursorEncoding(-1), clipboard(nullptr)
 {
+  cursorCache = new CursorCache();
 }
 
 CMsgReader::~CMsgReader()
 {
+  delete cursorCache;
+  delete clipboard;
 }
 
 bool CMsgReader::readServerInit()
@@ -183,6 +188,9 @@ bool CMsgReader::readMsg()
     case pseudoEncodingVMwareCursor:
       ret = readSetVMwareCursor(dataRect.width(), dataRect.height(), dataRect.tl);
       break;
+    case pseudoEncodingCursorCache:
+      ret = readCursorCache(dataRect.width(), dataRect.height(), dataRect.tl);
+      break;
     case pseudoEncodingVMwareCursorPosition:
       handler->setCursorPos(dataRect.tl);
       ret = true;
@@ -205,6 +213,9 @@ bool CMsgReader::readMsg()
     case pseudoEncodingVMwareLEDState:
       ret = readVMwareLEDState();
       break;
+    case pseudoEncodingSharedMemory:
+      ret = readSharedMemory();
+      break;
     case pseudoEncodingQEMUKeyEvent:
       handler->supportsQEMUKeyEvent();
       ret = true;
@@ -262,6 +273,9 @@ bool CMsgReader::readBell()
 
 bool CMsgReader::readServerCutText()
 {
+  if (clipboard != nullptr)
+    return readClipboardProvide();
+
   if (!is->hasData(3 + 4))
     return false;
 
@@ -273,13 +287,7 @@ bool CMsgReader::readServerCutText()
   if (len & 0x80000000) {
     int32_t slen = len;
     slen = -slen;
-    if (readExtendedClipboard(slen)) {
-      is->clearRestorePoint();
-      return true;
-    } else {
-      is->gotoRestorePoint();
-      return false;
-    }
+    return readExtendedClipboard(slen);
   }
 
   if (!is->hasDataOrRestore(len))
@@ -308,20 +316,39 @@ bool CMsgReader::readExtendedClipboard(int32_t len)
   uint32_t flags;
   uint32_t action;
 
-  if (!is->hasData(len))
-    return false;
-
   if (len < 4)
     throw protocol_error("Invalid extended clipboard message");
+
+  if (!is->hasDataOrRestore(4))
+    return false;
+
+  flags = is->readU32();
+  action = flags & clipboardActionMask;
+
+  // The data can be large, so it is decompressed as it arrives rather
+  // than waiting for the whole message
+  if (action == clipboardProvide) {
+    is->clearRestorePoint();
+    clipboard = new ClipboardInflater(is, flags, len - 4,
+                                      (size_t)maxCutText);
+    // Don't spend time decompressing something we won't keep
+    if (len > maxCutText) {
+      vlog.error("Extended clipboard message too long (%d bytes) - ignoring", len);
+      clipboard->skip();
+    }
+    return readClipboardProvide();
+  }
+
+  if (!is->hasDataOrRestore(len - 4))
+    return false;
+  is->clearRestorePoint();
+
   if (len > maxCutText) {
     vlog.error("Extended clipboard message too long (%d bytes) - ignoring", len);
-    is->skip(len);
+    is->skip(len - 4);
     return true;
   }
 
-  flags = is->readU32();
-  action = flags & clipboardActionMask;
-
   if (action & clipboardCaps) {
     int i;
     size_t num;
@@ -343,69 +370,6 @@ bool CMsgReader::readExtendedClipboard(int32_t len)
     }
 
     handler->handleClipboardCaps(flags, lengths);
-  } else if (action == clipboardProvide) {
-    rdr::ZlibInStream zis;
-
-    int i;
-    size_t num;
-    size_t lengths[16];
-    uint8_t* buffers[16];
-
-    zis.setUnderlying(is, len - 4);
-
-    num = 0;
-    for (i = 0;i < 16;i++) {
-      if (!(flags & 1 << i))
-        continue;
-
-      if (!zis.hasData(4))
-        throw protocol_error("Extended clipboard decode error");
-
-      lengths[num] = zis.readU32();
-
-      if (lengths[num] > (size_t)maxCutText) {
-        vlog.error("Extended clipboard data too long (%d bytes) - ignoring",
-                   (unsigned)lengths[num]);
-
-        // Slowly (safely) drain away the data
-        while (lengths[num] > 0) {
-          size_t chunk;
-
-          if (!zis.hasData(1))
-            throw protocol_error("Extended clipboard decode error");
-
-          chunk = zis.avail();
-          if (chunk > lengths[num])
-            chunk = lengths[num];
-
-          zis.skip(chunk);
-          lengths[num] -= chunk;
-        }
-
-        flags &= ~(1 << i);
-
-        continue;
-      }
-
-      if (!zis.hasData(lengths[num]))
-        throw protocol_error("Extended clipboard decode error");
-
-      buffers[num] = new uint8_t[lengths[num]];
-      zis.readBytes(buffers[num], lengths[num]);
-      num++;
-    }
-
-    zis.flushUnderlying();
-    zis.setUnderlying(nullptr, 0);
-
-    handler->handleClipboardProvide(flags, lengths, buffers);
-
-    num = 0;
-    for (i = 0;i < 16;i++) {
-      if (!(flags & 1 << i))
-        continue;
-      delete [] buffers[num++];
-    }
   } else {
     switch (action) {
     case clipboardRequest:
@@ -425,6 +389,23 @@ bool CMsgReader::readExtendedClipboard(int32_t len)
   return true;
 }
 
+bool CMsgReader::readClipboardProvide()
+{
+  if (!clipboard->read())
+    return false;
+
+  if (clipboard->getFlags() & clipboardFormatMask) {
+    handler->handleClipboardProvide(clipboard->getFlags(),
+                                    clipboard->getLengths(),
+                                    clipboard->getData());
+  }
+
+  delete clipboard;
+  clipboard = nullptr;
+
+  return true;
+}
+
 bool CMsgReader::readFence()
 {
   uint32_t flags;
@@ -487,7 +468,8 @@ bool CMsgReader::readRect(const core::Rect& r, int encoding)
     throw protocol_error("Rect too big");
   }
 
-  if (r.is_empty())
+  // Tile cache resets don't cover any area
+  if (r.is_empty() && (encoding != encodingTileCache))
     vlog.error("Zero size rect");
 
   return handler->dataRect(r, encoding);
@@ -771,6 +753,67 @@ bool CMsgReader::readSetVMwareCursor(int width, int height,
   return true;
 }
 
+bool CMsgReader::readCursorCache(int width, int height,
+                                 const core::Point& hotspot)
+{
+  if (width > maxCursorSize || height > maxCursorSize)
+    throw protocol_error("Too big cursor");
+
+  uint8_t op;
+  uint32_t id, len;
+
+  if (!is->hasData(1 + 4))
+    return false;
+
+  is->setRestorePoint();
+
+  op = is->readU8();
+  id = is->readU32();
+
+  if (op == cursorCacheUse) {
+    const uint8_t* data;
+
+    is->clearRestorePoint();
+
+    if (!cursorCache->get(id, width, height, &data))
+      throw protocol_error("Unknown cached cursor");
+
+    handler->setCursor(width, height, hotspot, data);
+
+    return true;
+  }
+
+  if (op != cursorCacheStore)
+    throw protocol_error("Invalid cursor cache operation");
+
+  if (!is->hasDataOrRestore(4))
+    return false;
+
+  len = is->readU32();
+
+  if (!is->hasDataOrRestore(len))
+    return false;
+  is->clearRestorePoint();
+
+  rdr::ZlibInStream zis;
+  std::vector<uint8_t> data(width*height*4);
+
+  zis.setUnderlying(is, len);
+
+  if (!zis.hasData(data.size()))
+    throw protocol_error("Cached cursor decode error");
+  zis.readBytes(data.data(), data.size());
+
+  zis.flushUnderlying();
+  zis.setUnderlying(nullptr, 0);
+
+  cursorCache->add(id, width, height, data.data());
+
+  handler->setCursor(width, height, hotspot, data.data());
+
+  return true;
+}
+
 bool CMsgReader::readSetDesktopName(int x, int y, int w, int h)
 {
   uint32_t len;
@@ -870,3 +913,19 @@ bool CMsgReader::readVMwareLEDState()
 
   return true;
 }
+
+bool CMsgReader::readSharedMemory()
+{
+  uint32_t size;
+
+  if (!is->hasData(4))
+    return false;
+
+  size = is->readU32();
+  if (size == 0)
+    throw protocol_error("Invalid shared memory size");
+
+  handler->setSharedMemory(size);
+
+  return true;
+}
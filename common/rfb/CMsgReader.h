@@ -33,6 +33,8 @@ namespace rdr { class InStream; }
 namespace rfb {
 
   class CMsgHandler;
+  class ClipboardInflater;
+  class CursorCache;
 
   class CMsgReader {
   public:
@@ -53,6 +55,7 @@ namespace rfb {
     bool readBell();
     bool readServerCutText();
     bool readExtendedClipboard(int32_t len);
+    bool readClipboardProvide();
     bool readFence();
     bool readEndOfContinuousUpdates();
 
@@ -68,10 +71,13 @@ namespace rfb {
                                 const core::Point& hotspot);
     bool readSetVMwareCursor(int width, int height,
                              const core::Point& hotspot);
+    bool readCursorCache(int width, int height,
+                         const core::Point& hotspot);
     bool readSetDesktopName(int x, int y, int w, int h);
     bool readExtendedDesktopSize(int x, int y, int w, int h);
     bool readLEDState();
     bool readVMwareLEDState();
+    bool readSharedMemory();
 
   private:
     CMsgHandler* handler;
@@ -93,6 +99,10 @@ namespace rfb {
 
     int cursorEncoding;
 
+    CursorCache* cursorCache;
+
+    ClipboardInflater* clipboard;
+
     static const int maxCursorSize = 256;
   };
 
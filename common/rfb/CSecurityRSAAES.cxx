@@ -31,6 +31,11 @@
 #endif
 #include <assert.h>
 
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+
 #include <nettle/bignum.h>
 #include <nettle/sha1.h>
 #include <nettle/sha2.h>
@@ -60,6 +65,33 @@ using namespace rfb;
 
 static core::LogWriter vlog("CSecurityRSAAES");
 
+// Generating a key pair takes a long time, so we try to have one
+// ready before it is needed. We don't know the size until we've seen
+// the server key, so we guess that it is the same as last time.
+static const uint32_t DefaultKeyLength = 2048;
+
+struct KeyPair {
+  KeyPair(uint32_t length);
+  ~KeyPair();
+
+  uint32_t length;
+  bool ready;
+  bool failed;
+  struct rsa_public_key pub;
+  struct rsa_private_key priv;
+};
+
+// Shared with the generating threads. Never freed as a detached
+// thread might still be running when the process exits.
+struct KeyCache {
+  std::mutex mutex;
+  std::condition_variable cond;
+  std::shared_ptr<KeyPair> spare;
+  uint32_t lastLength;
+};
+
+static KeyCache* keyCache = new KeyCache{ {}, {}, {}, DefaultKeyLength };
+
 CSecurityRSAAES::CSecurityRSAAES(CConnection* cc_, uint32_t _secType,
                                  int _keySize, bool _isAllEncrypted)
   : CSecurity(cc_), state(ReadPublicKey),
@@ -70,6 +102,10 @@ CSecurityRSAAES::CSecurityRSAAES(CConnection* cc_, uint32_t _secType,
     rais(nullptr), raos(nullptr), rawis(nullptr), rawos(nullptr)
 {
   assert(keySize == 128 || keySize == 256);
+
+  // Might not have been done earlier, but we can still get some work
+  // done whilst waiting for the server
+  prepareKeyPair();
 }
 
 CSecurityRSAAES::~CSecurityRSAAES()
@@ -158,10 +194,87 @@ static void random_func(void*, size_t length, uint8_t* dst)
   rs.readBytes(dst, length);
 }
 
+KeyPair::KeyPair(uint32_t length_)
+  : length(length_), ready(false), failed(false)
+{
+  rsa_public_key_init(&pub);
+  rsa_private_key_init(&priv);
+}
+
+KeyPair::~KeyPair()
+{
+  rsa_public_key_clear(&pub);
+  rsa_private_key_clear(&priv);
+}
+
+static bool generateKeyPair(uint32_t length,
+                            struct rsa_public_key* pub,
+                            struct rsa_private_key* priv)
+{
+  // set e = 65537
+  mpz_set_ui(pub->e, 65537);
+  try {
+    return rsa_generate_keypair(pub, priv, nullptr, random_func,
+                                nullptr, nullptr, length, 0);
+  } catch (std::exception&) {
+    return false;
+  }
+}
+
+static void keyWorker(std::shared_ptr<KeyPair> keyPair)
+{
+  struct rsa_public_key pub;
+  struct rsa_private_key priv;
+  bool ok;
+
+  rsa_public_key_init(&pub);
+  rsa_private_key_init(&priv);
+
+  ok = generateKeyPair(keyPair->length, &pub, &priv);
+
+  std::unique_lock<std::mutex> lock(keyCache->mutex);
+
+  if (ok) {
+    mpz_swap(keyPair->pub.n, pub.n);
+    mpz_swap(keyPair->pub.e, pub.e);
+    keyPair->pub.size = pub.size;
+    mpz_swap(keyPair->priv.d, priv.d);
+    mpz_swap(keyPair->priv.p, priv.p);
+    mpz_swap(keyPair->priv.q, priv.q);
+    mpz_swap(keyPair->priv.a, priv.a);
+    mpz_swap(keyPair->priv.b, priv.b);
+    mpz_swap(keyPair->priv.c, priv.c);
+    keyPair->priv.size = priv.size;
+  }
+
+  keyPair->ready = true;
+  keyPair->failed = !ok;
+
+  keyCache->cond.notify_all();
+
+  lock.unlock();
+
+  rsa_public_key_clear(&pub);
+  rsa_private_key_clear(&priv);
+}
+
+void CSecurityRSAAES::prepareKeyPair()
+{
+  const std::lock_guard<std::mutex> lock(keyCache->mutex);
+
+  if (keyCache->spare &&
+      (keyCache->spare->length == keyCache->lastLength))
+    return;
+
+  keyCache->spare = std::make_shared<KeyPair>(keyCache->lastLength);
+  std::thread(keyWorker, keyCache->spare).detach();
+}
+
 void CSecurityRSAAES::writePublicKey()
 {
   rdr::OutStream* os = cc->getOutStream();
-  // generate client key
+  std::shared_ptr<KeyPair> keyPair;
+
   rsa_public_key_init(&clientPublicKey);
   rsa_private_key_init(&clientKey);
   // match the server key size
@@ -170,12 +283,42 @@ void CSecurityRSAAES::writePublicKey()
   // set key size to non-zero to allow clearing the keys when cleanup
   clientPublicKey.size = rsaKeySize;
   clientKey.size = rsaKeySize;
-  // set e = 65537
-  mpz_set_ui(clientPublicKey.e, 65537);
-  if (!rsa_generate_keypair(&clientPublicKey, &clientKey,
-                            nullptr, random_func, nullptr, nullptr,
-                            clientKeyLength, 0))
-    throw std::runtime_error("Failed to generate key");
+
+  // Use the key pair generated in the background, if we guessed the
+  // right size
+  {
+    std::unique_lock<std::mutex> lock(keyCache->mutex);
+
+    if (keyCache->spare && (keyCache->spare->length == clientKeyLength)) {
+      keyPair = keyCache->spare;
+      keyCache->spare.reset();
+      while (!keyPair->ready)
+        keyCache->cond.wait(lock);
+    }
+
+    keyCache->lastLength = clientKeyLength;
+  }
+
+  if (keyPair && !keyPair->failed) {
+    mpz_set(clientPublicKey.n, keyPair->pub.n);
+    mpz_set(clientPublicKey.e, keyPair->pub.e);
+    clientPublicKey.size = keyPair->pub.size;
+    mpz_set(clientKey.d, keyPair->priv.d);
+    mpz_set(clientKey.p, keyPair->priv.p);
+    mpz_set(clientKey.q, keyPair->priv.q);
+    mpz_set(clientKey.a, keyPair->priv.a);
+    mpz_set(clientKey.b, keyPair->priv.b);
+    mpz_set(clientKey.c, keyPair->priv.c);
+    clientKey.size = keyPair->priv.size;
+  } else {
+    vlog.debug("No key pair ready, generating one now");
+    if (!generateKeyPair(clientKeyLength, &clientPublicKey, &clientKey))
+      throw std::runtime_error("Failed to generate key");
+  }
+
+  // Get the next one going for the next connection
+  prepareKeyPair();
+
   clientKeyN = new uint8_t[rsaKeySize];
   clientKeyE = new uint8_t[rsaKeySize];
   nettle_mpz_get_str_256(rsaKeySize, clientKeyN, clientPublicKey.n);
@@ -51,6 +51,10 @@ namespace rfb {
 
     static core::IntParameter RSAKeyLength;
 
+    // prepareKeyPair() starts generating a key pair in the background
+    // so that it is ready for the next connection
+    static void prepareKeyPair();
+
   private:
     void cleanup();
     void writePublicKey();
@@ -33,6 +33,7 @@
 #include <rfb/ClientParams.h>
 #include <rfb/Cursor.h>
 #include <rfb/ScreenSet.h>
+#include <rfb/TileCache.h>
 
 using namespace rfb;
 
@@ -41,7 +42,7 @@ static core::LogWriter vlog("ClientParams");
 ClientParams::ClientParams()
   : majorVersion(0), minorVersion(0),
     compressLevel(2), qualityLevel(-1), fineQualityLevel(-1),
-    subsampling(subsampleUndefined),
+    subsampling(subsampleUndefined), tileCacheSize(0),
     width_(0), height_(0),
     cursorPos_(0, 0), ledState_(ledUnknown)
 {
@@ -126,6 +127,7 @@ void ClientParams::setEncodings(int nEncodings, const int32_t* encodings)
   qualityLevel = -1;
   fineQualityLevel = -1;
   subsampling = subsampleUndefined;
+  tileCacheSize = 0;
 
   encodings_.clear();
   encodings_.insert(encodingRaw);
@@ -164,6 +166,11 @@ void ClientParams::setEncodings(int nEncodings, const int32_t* encodings)
         encodings[i] <= pseudoEncodingFineQualityLevel100)
       fineQualityLevel = encodings[i] - pseudoEncodingFineQualityLevel0;
 
+    if (encodings[i] >= pseudoEncodingTileCacheSize0 &&
+        encodings[i] <= pseudoEncodingTileCacheSize15)
+      tileCacheSize = (size_t)tileCacheTilesPerMiB <<
+                      (encodings[i] - pseudoEncodingTileCacheSize0);
+
     encodings_.insert(encodings[i]);
   }
 }
@@ -201,6 +208,8 @@ void ClientParams::setClipboardCaps(uint32_t flags, const uint32_t* lengths)
 
 bool ClientParams::supportsLocalCursor() const
 {
+  if (supportsEncoding(pseudoEncodingCursorCache))
+    return true;
   if (supportsEncoding(pseudoEncodingCursorWithAlpha))
     return true;
   if (supportsEncoding(pseudoEncodingVMwareCursor))
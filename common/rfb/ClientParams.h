@@ -26,6 +26,7 @@
 #include <set>
 #include <string>
 
+#include <stddef.h>
 #include <stdint.h>
 
 #include <core/Rect.h>
@@ -109,6 +110,8 @@ namespace rfb {
     int qualityLevel;
     int fineQualityLevel;
     int subsampling;
+    // Number of tiles the client can cache, or zero if unsupported
+    size_t tileCacheSize;
 
   private:
 
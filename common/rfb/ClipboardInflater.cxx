@@ -0,0 +1,136 @@
+/* Copyright (C) 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <core/LogWriter.h>
+
+#include <rfb/ClipboardInflater.h>
+#include <rfb/Exception.h>
+
+using namespace rfb;
+
+static core::LogWriter vlog("ClipboardInflater");
+
+ClipboardInflater::ClipboardInflater(rdr::InStream* is_, uint32_t flags_,
+                                     size_t len, size_t maxLength_)
+  : is(is_), flags(flags_), maxLength(maxLength_), format(0), num(0),
+    haveLength(false), left(0)
+{
+  zis.setUnderlying(is, len);
+}
+
+ClipboardInflater::~ClipboardInflater()
+{
+  zis.setUnderlying(nullptr, 0);
+}
+
+bool ClipboardInflater::read()
+{
+  while (format < 16) {
+    if (!(flags & (1 << format))) {
+      format++;
+      continue;
+    }
+
+    if (!haveLength) {
+      if (!ensure(4))
+        return false;
+
+      left = zis.readU32();
+      haveLength = true;
+
+      // The later formats can't be reached without decompressing this
+      // one, so they are dropped as well
+      if (left > maxLength) {
+        vlog.error("Extended clipboard data too long (%d bytes) - ignoring",
+                   (unsigned)left);
+        skip();
+        break;
+      }
+
+      buffers[num].reserve(left);
+    }
+
+    while (left > 0) {
+      size_t chunk;
+      const uint8_t* ptr;
+
+      if (!ensure(1))
+        return false;
+
+      chunk = zis.avail();
+      if (chunk > left)
+        chunk = left;
+
+      ptr = zis.getptr(chunk);
+      buffers[num].insert(buffers[num].end(), ptr, ptr + chunk);
+      zis.setptr(chunk);
+
+      left -= chunk;
+    }
+
+    lengths[num] = buffers[num].size();
+    data[num] = buffers[num].data();
+    num++;
+
+    haveLength = false;
+    format++;
+  }
+
+  // Anything after the last format is either dropped data, or just the
+  // end of the zlib stream, which doesn't always inflate to any output,
+  // so skip it directly
+  while (zis.bytesLeft() > 0) {
+    size_t chunk;
+
+    if (!is->hasData(1))
+      return false;
+
+    chunk = is->avail();
+    if (chunk > zis.bytesLeft())
+      chunk = zis.bytesLeft();
+
+    is->skip(chunk);
+    zis.setUnderlying(is, zis.bytesLeft() - chunk);
+  }
+
+  return true;
+}
+
+void ClipboardInflater::skip()
+{
+  for (; format < 16; format++)
+    flags &= ~(1 << format);
+
+  haveLength = false;
+  left = 0;
+}
+
+bool ClipboardInflater::ensure(size_t needed)
+{
+  if (zis.avail() >= needed)
+    return true;
+
+  if (zis.bytesLeft() == 0)
+    throw protocol_error("Extended clipboard decode error");
+
+  return zis.hasData(needed);
+}
@@ -0,0 +1,79 @@
+/* Copyright (C) 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+//
+// ClipboardInflater decodes the data of an extended clipboard "provide"
+// message as it arrives, so that a large clipboard doesn't have to be
+// received in full before any of it can be decompressed. A format that
+// is larger than the given limit is dropped together with all formats
+// after it, and the rest of the message is skipped without being
+// decompressed.
+//
+
+#ifndef __RFB_CLIPBOARDINFLATER_H__
+#define __RFB_CLIPBOARDINFLATER_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include <rdr/ZlibInStream.h>
+
+namespace rfb {
+
+  class ClipboardInflater {
+  public:
+    ClipboardInflater(rdr::InStream* is, uint32_t flags, size_t len,
+                      size_t maxLength);
+    ~ClipboardInflater();
+
+    // read() consumes whatever part of the message is available, and
+    // returns true once all of it has been read
+    bool read();
+
+    // skip() drops all formats that haven't been read yet
+    void skip();
+
+    // Formats that were dropped are cleared from the flags
+    uint32_t getFlags() const { return flags; }
+    const size_t* getLengths() const { return lengths; }
+    const uint8_t* const* getData() const { return data; }
+
+  private:
+    bool ensure(size_t needed);
+
+    rdr::InStream* is;
+    rdr::ZlibInStream zis;
+
+    uint32_t flags;
+    size_t maxLength;
+
+    int format;
+    size_t num;
+    bool haveLength;
+    size_t left;
+
+    std::vector<uint8_t> buffers[16];
+    size_t lengths[16];
+    const uint8_t* data[16];
+  };
+
+}
+
+#endif
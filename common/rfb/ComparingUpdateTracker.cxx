@@ -37,7 +37,8 @@ static core::LogWriter vlog("ComparingUpdateTracker");
 
 ComparingUpdateTracker::ComparingUpdateTracker(PixelBuffer* buffer)
   : fb(buffer), oldFb(fb->getPF(), 0, 0), firstCompare(true),
-    enabled(true), totalPixels(0), missedPixels(0)
+    enabled(true), detectScroll(false), totalPixels(0), missedPixels(0),
+    scrolledPixels(0)
 {
     changed.assign_union(fb->getRect());
 }
@@ -78,6 +79,12 @@ bool ComparingUpdateTracker::compare()
   for (i = rects.begin(); i != rects.end(); i++)
     oldFb.copyRect(*i, copy_delta);
 
+  // Copies we've been told about are more reliable than anything we
+  // can figure out ourselves
+  bool scrolled = false;
+  if (detectScroll && copied.is_empty())
+    scrolled = findScroll();
+
   changed.get_rects(&rects);
 
   core::Region newChanged;
@@ -92,13 +99,50 @@ bool ComparingUpdateTracker::compare()
     missedPixels += i->area();
 
   if (changed == newChanged)
-    return false;
+    return scrolled;
 
   changed = newChanged;
 
   return true;
 }
 
+// findScroll() checks if the largest changed area is really something
+// that has moved. If so, it is added as a copy and oldFb is updated so
+// that compareRect() will no longer see that area as changed.
+
+bool ComparingUpdateTracker::findScroll()
+{
+  std::vector<core::Rect> rects;
+  std::vector<core::Rect>::iterator i;
+  core::Rect largest;
+  core::Region dest;
+  core::Point delta;
+
+  changed.get_rects(&rects);
+  for (i = rects.begin(); i != rects.end(); i++) {
+    if (i->area() > largest.area())
+      largest = *i;
+  }
+
+  largest = largest.intersect(fb->getRect());
+  if (largest.is_empty())
+    return false;
+
+  if (!scrollDetector.detect(&oldFb, fb, largest, &dest, &delta))
+    return false;
+
+  copied = dest;
+  copy_delta = delta;
+
+  dest.get_rects(&rects, delta.x<=0, delta.y<=0);
+  for (i = rects.begin(); i != rects.end(); i++) {
+    oldFb.copyRect(*i, delta);
+    scrolledPixels += i->area();
+  }
+
+  return true;
+}
+
 void ComparingUpdateTracker::enable()
 {
   enabled = true;
@@ -268,6 +312,9 @@ void ComparingUpdateTracker::logStats()
              core::siPrefix(totalPixels, "pixels").c_str(),
              core::siPrefix(missedPixels, "pixels").c_str());
   vlog.debug("(1:%g ratio)", ratio);
+  if (scrolledPixels != 0)
+    vlog.debug("%s detected as moved",
+               core::siPrefix(scrolledPixels, "pixels").c_str());
 
-  totalPixels = missedPixels = 0;
+  totalPixels = missedPixels = scrolledPixels = 0;
 }
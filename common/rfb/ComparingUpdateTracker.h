@@ -20,6 +20,7 @@
 #define __RFB_COMPARINGUPDATETRACKER_H__
 
 #include <rfb/PixelBuffer.h>
+#include <rfb/ScrollDetector.h>
 #include <rfb/UpdateTracker.h>
 
 namespace rfb {
@@ -42,16 +43,23 @@ namespace rfb {
     virtual void enable();
     virtual void disable();
 
+    // setDetectScroll() controls if compare() should also look for
+    // content that has moved, and turn it in to a copy
+    void setDetectScroll(bool detect) { detectScroll = detect; }
+
     void logStats();
 
   private:
     void compareRect(const core::Rect& r, core::Region* newchanged);
+    bool findScroll();
     PixelBuffer* fb;
     ManagedPixelBuffer oldFb;
     bool firstCompare;
     bool enabled;
+    bool detectScroll;
+    ScrollDetector scrollDetector;
 
-    unsigned long long totalPixels, missedPixels;
+    unsigned long long totalPixels, missedPixels, scrolledPixels;
   };
 
 }
@@ -83,7 +83,7 @@ static core::LogWriter vlog("Congestion");
 
 Congestion::Congestion() :
     lastPosition(0), extraBuffer(0),
-    baseRTT(-1), congWindow(INITIAL_WINDOW), inSlowStart(true),
+    baseRTT(-1), lastRTT(0), congWindow(INITIAL_WINDOW), inSlowStart(true),
     safeBaseRTT(-1), measurements(0), minRTT(-1), minCongestedRTT(-1)
 {
   gettimeofday(&lastUpdate, nullptr);
@@ -123,6 +123,7 @@ void Congestion::updatePosition(unsigned pos)
     if (congWindow > INITIAL_WINDOW)
       congWindow = INITIAL_WINDOW;
     baseRTT = -1;
+    lastRTT = 0;
     measurements = 0;
     gettimeofday(&lastAdjustment, nullptr);
     minRTT = minCongestedRTT = -1;
@@ -181,6 +182,8 @@ void Congestion::gotPong()
   if (rtt < 1)
     rtt = 1;
 
+  lastRTT = rtt;
+
   // Try to estimate wire latency by tracking lowest seen latency
   if (rtt < baseRTT)
     safeBaseRTT = baseRTT = rtt;
@@ -315,6 +318,19 @@ size_t Congestion::getBandwidth()
   return bandwidth;
 }
 
+unsigned Congestion::getRTT()
+{
+  return lastRTT;
+}
+
+unsigned Congestion::getBaseRTT()
+{
+  if (baseRTT == (unsigned)-1)
+    return 0;
+
+  return baseRTT;
+}
+
 void Congestion::debugTrace(const char* filename, int fd)
 {
   (void)filename;
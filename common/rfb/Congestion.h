@@ -51,6 +51,16 @@ namespace rfb {
     // per second.
     size_t getBandwidth();
 
+    // getRTT() returns the most recently measured round trip time, and
+    // getBaseRTT() the estimated latency of the wire itself, both in
+    // milliseconds. They return 0 when there is no measurement yet.
+    unsigned getRTT();
+    unsigned getBaseRTT();
+
+    // getInFlight() returns the estimated number of bytes that have
+    // been sent but not yet received by the other end.
+    unsigned getInFlight();
+
     // debugTrace() writes the current congestion window, as well as the
     // congestion window of the underlying TCP layer, to the specified
     // file
@@ -58,7 +68,6 @@ namespace rfb {
 
   protected:
     unsigned getExtraBuffer();
-    unsigned getInFlight();
 
     void updateCongestion();
 
@@ -69,6 +78,7 @@ namespace rfb {
     struct timeval lastSent;
 
     unsigned baseRTT;
+    unsigned lastRTT;
     unsigned congWindow;
     bool inSlowStart;
 
@@ -0,0 +1,135 @@
+/* Copyright (C) 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include <rfb/CursorCache.h>
+
+using namespace rfb;
+
+CursorCache::CursorCache()
+  : nextId(0)
+{
+}
+
+CursorCache::~CursorCache()
+{
+}
+
+bool CursorCache::lookup(int width, int height, const uint8_t* data,
+                         uint32_t* id)
+{
+  uint64_t hash;
+  std::list<Entry>::iterator iter;
+
+  hash = hashImage(width, height, data);
+
+  // The hash only saves us from comparing every image, so we still
+  // check the pixels of a match
+  for (iter = lru.begin(); iter != lru.end(); ++iter) {
+    if (iter->hash != hash)
+      continue;
+    if ((iter->width != width) || (iter->height != height))
+      continue;
+    if (!iter->data.empty() &&
+        (memcmp(iter->data.data(), data, iter->data.size()) != 0))
+      continue;
+
+    lru.splice(lru.begin(), lru, iter);
+    *id = iter->id;
+
+    return true;
+  }
+
+  return false;
+}
+
+bool CursorCache::get(uint32_t id, int width, int height,
+                      const uint8_t** data)
+{
+  std::list<Entry>::iterator iter;
+
+  for (iter = lru.begin(); iter != lru.end(); ++iter) {
+    if (iter->id != id)
+      continue;
+    if ((iter->width != width) || (iter->height != height))
+      return false;
+
+    lru.splice(lru.begin(), lru, iter);
+    *data = iter->data.data();
+
+    return true;
+  }
+
+  return false;
+}
+
+uint32_t CursorCache::add(int width, int height, const uint8_t* data)
+{
+  uint32_t id;
+
+  id = nextId++;
+  add(id, width, height, data);
+
+  return id;
+}
+
+void CursorCache::add(uint32_t id, int width, int height,
+                      const uint8_t* data)
+{
+  std::list<Entry>::iterator iter;
+
+  for (iter = lru.begin(); iter != lru.end(); ++iter) {
+    if (iter->id == id) {
+      lru.erase(iter);
+      break;
+    }
+  }
+
+  if (lru.size() >= cursorCacheSize)
+    lru.pop_back();
+
+  lru.emplace_front();
+  lru.front().id = id;
+  lru.front().hash = hashImage(width, height, data);
+  lru.front().width = width;
+  lru.front().height = height;
+  lru.front().data.assign(data, data + width * height * 4);
+}
+
+uint64_t CursorCache::hashImage(int width, int height,
+                                const uint8_t* data)
+{
+  uint64_t hash;
+  size_t len;
+
+  // FNV-1a, which is plenty for the few shapes a session has
+  hash = 0xcbf29ce484222325ULL;
+  hash = (hash ^ (uint64_t)width) * 0x100000001b3ULL;
+  hash = (hash ^ (uint64_t)height) * 0x100000001b3ULL;
+
+  len = width * height * 4;
+  while (len--)
+    hash = (hash ^ *data++) * 0x100000001b3ULL;
+
+  return hash;
+}
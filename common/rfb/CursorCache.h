@@ -0,0 +1,82 @@
+/* Copyright (C) 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+//
+// CursorCache holds the cursor shapes most recently sent to a client,
+// so that a shape that is shown again can be sent as a short reference
+// instead. The same class is used on both sides. The server picks the
+// ids, and since both sides evict the least recently used shape first
+// they always agree on what is cached.
+//
+
+#ifndef __RFB_CURSORCACHE_H__
+#define __RFB_CURSORCACHE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <list>
+#include <vector>
+
+namespace rfb {
+
+  // Operations for pseudoEncodingCursorCache rects
+  const int cursorCacheStore = 0;
+  const int cursorCacheUse = 1;
+
+  // Both sides keep exactly this many shapes
+  const size_t cursorCacheSize = 32;
+
+  class CursorCache {
+  public:
+    CursorCache();
+    ~CursorCache();
+
+    // lookup() checks if an identical RGBA image is cached, and if so
+    // marks it as the most recently used
+    bool lookup(int width, int height, const uint8_t* data, uint32_t* id);
+
+    // get() checks if an image is stored with the given id and size,
+    // and if so marks it as the most recently used and sets *data to
+    // its pixels. An empty image has no pixels, so *data is then
+    // nullptr.
+    bool get(uint32_t id, int width, int height, const uint8_t** data);
+
+    // add() stores a new image, evicting the least recently used one
+    // if the cache is full. The server lets the cache pick the id,
+    // whilst the client uses the one it was sent.
+    uint32_t add(int width, int height, const uint8_t* data);
+    void add(uint32_t id, int width, int height, const uint8_t* data);
+
+  private:
+    struct Entry {
+      uint32_t id;
+      uint64_t hash;
+      int width, height;
+      std::vector<uint8_t> data;
+    };
+
+    static uint64_t hashImage(int width, int height, const uint8_t* data);
+
+    uint32_t nextId;
+    std::list<Entry> lru;
+  };
+
+}
+
+#endif
@@ -31,6 +31,9 @@
 #include <rfb/DecodeManager.h>
 #include <rfb/Decoder.h>
 #include <rfb/Exception.h>
+#include <rfb/TileCacheDecoder.h>
+#include <rfb/SharedMemory.h>
+#include <rfb/SharedMemoryDecoder.h>
 
 #include <rdr/MemOutStream.h>
 
@@ -39,7 +42,9 @@ using namespace rfb;
 static core::LogWriter vlog("DecodeManager");
 
 DecodeManager::DecodeManager(CConnection *conn_) :
-  conn(conn_), partialEntry(nullptr), threadException(nullptr)
+  conn(conn_), tileCacheSize(0), sharedMemory(nullptr),
+  partialEntry(nullptr),
+  threadException(nullptr)
 {
   size_t cpuCount;
 
@@ -88,6 +93,8 @@ DecodeManager::~DecodeManager()
   for (Decoder* decoder : decoders)
     delete decoder;
 
+  delete sharedMemory;
+
   delete partialEntry;
 }
 
@@ -113,6 +120,12 @@ bool DecodeManager::decodeRect(const core::Rect& r, int encoding,
         vlog.error("Unknown encoding %d", encoding);
         throw protocol_error("Unknown encoding");
       }
+
+      if (encoding == encodingTileCache)
+        ((TileCacheDecoder*)decoders[encoding])->setMaxTiles(tileCacheSize);
+      if (encoding == encodingSharedMemory)
+        ((SharedMemoryDecoder*)decoders[encoding])->
+          setSharedMemory(sharedMemory);
     }
 
     decoder = decoders[encoding];
@@ -200,6 +213,40 @@ void DecodeManager::flush()
   throwThreadException();
 }
 
+void DecodeManager::setTileCacheSize(size_t tiles)
+{
+  TileCacheDecoder* decoder;
+
+  if (tiles <= tileCacheSize)
+    return;
+
+  tileCacheSize = tiles;
+
+  decoder = (TileCacheDecoder*)decoders[encodingTileCache];
+  if (decoder == nullptr)
+    return;
+
+  // The worker threads might be using the cache
+  flush();
+
+  decoder->setMaxTiles(tileCacheSize);
+}
+
+void DecodeManager::setSharedMemory(SharedMemory* shm)
+{
+  SharedMemoryDecoder* decoder;
+
+  // Rects already received refer to the old buffer
+  flush();
+
+  decoder = (SharedMemoryDecoder*)decoders[encodingSharedMemory];
+  if (decoder != nullptr)
+    decoder->setSharedMemory(shm);
+
+  delete sharedMemory;
+  sharedMemory = shm;
+}
+
 void DecodeManager::logStats()
 {
   size_t i;
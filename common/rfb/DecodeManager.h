@@ -42,6 +42,7 @@ namespace rfb {
   class CConnection;
   class Decoder;
   class ModifiablePixelBuffer;
+  class SharedMemory;
 
   class DecodeManager {
   public:
@@ -53,6 +54,15 @@ namespace rfb {
 
     void flush();
 
+    // setTileCacheSize() sets how many tiles the tile cache may hold.
+    // It can only grow during a connection.
+    void setTileCacheSize(size_t tiles);
+
+    // setSharedMemory() switches to a new buffer shared with the
+    // server, once everything from the old one has been decoded. The
+    // DecodeManager takes ownership of the buffer.
+    void setSharedMemory(SharedMemory* shm);
+
   private:
     void logStats();
 
@@ -63,6 +73,9 @@ namespace rfb {
     CConnection *conn;
     Decoder *decoders[encodingMax+1];
 
+    size_t tileCacheSize;
+    SharedMemory* sharedMemory;
+
     struct DecoderStats {
       unsigned rects;
       unsigned long long bytes;
@@ -34,6 +34,9 @@
 #include <rfb/JPEGDecoder.h>
 #include <rfb/ZRLEDecoder.h>
 #include <rfb/TightDecoder.h>
+#include <rfb/TileCacheDecoder.h>
+#include <rfb/SharedMemory.h>
+#include <rfb/SharedMemoryDecoder.h>
 #ifdef HAVE_H264
 #include <rfb/H264Decoder.h>
 #endif
@@ -78,10 +81,13 @@ bool Decoder::supported(int encoding)
   case encodingJPEG:
   case encodingZRLE:
   case encodingTight:
+  case encodingTileCache:
 #ifdef HAVE_H264
   case encodingH264:
 #endif
     return true;
+  case encodingSharedMemory:
+    return SharedMemory::isSupported();
   default:
     return false;
   }
@@ -104,6 +110,10 @@ Decoder* Decoder::createDecoder(int encoding)
     return new ZRLEDecoder();
   case encodingTight:
     return new TightDecoder();
+  case encodingTileCache:
+    return new TileCacheDecoder();
+  case encodingSharedMemory:
+    return new SharedMemoryDecoder();
 #ifdef HAVE_H264
   case encodingH264:
     return new H264Decoder();
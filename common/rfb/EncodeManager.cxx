@@ -25,15 +25,23 @@
 
 #include <stdlib.h>
 
+#include <algorithm>
+
 #include <core/LogWriter.h>
 #include <core/string.h>
+#include <core/time.h>
+
+#include <rdr/BufferPool.h>
 
+#include <rfb/Congestion.h>
 #include <rfb/Cursor.h>
 #include <rfb/EncodeManager.h>
 #include <rfb/Encoder.h>
 #include <rfb/Palette.h>
 #include <rfb/SConnection.h>
 #include <rfb/SMsgWriter.h>
+#include <rfb/ServerCore.h>
+#include <rfb/SharedMemory.h>
 #include <rfb/UpdateTracker.h>
 #include <rfb/encodings.h>
 
@@ -63,6 +71,40 @@ static const int SolidBlockMinArea = 2048;
 // How long we consider a region recently changed (in ms)
 static const int RecentChangeTimeout = 50;
 
+// How many updates in a row need to be comfortably within the frame
+// time before we raise the quality again
+static const unsigned QualityRaiseUpdates = 10;
+
+// Steps in fine quality for each quality level we adapt
+static const int FineQualityStep = 10;
+
+// How many updates before we try an encoder again to see if it has
+// become a better choice for some type of content
+static const unsigned EncoderModelMaxAge = 256;
+
+// How many pixels we need to have seen before we fully trust a new
+// measurement of an encoder
+static const unsigned EncoderModelPixels = 65536;
+
+// How often we use an encoder we are measuring rather than the best
+// known one
+static const unsigned EncoderExploreInterval = 8;
+
+// Largest rect we try another encoder on, to limit the damage if it
+// turns out to be a poor choice
+static const int EncoderExploreMaxArea = 16384;
+
+// How much cheaper another encoder must look before we switch to it
+static const double EncoderSwitchMargin = 0.1;
+
+// How much better than lossless we expect the refinement step to
+// compress (kept low, as areas that were sent lossy are usually the
+// ones that compress badly)
+static const int RefineCompression = 2;
+
+// Link speed to assume if we haven't been told (bytes per second)
+static const size_t DefaultBandwidth = 1000000;
+
 namespace rfb {
 
 enum EncoderClass {
@@ -140,12 +182,15 @@ static const char *encoderTypeName(EncoderType type)
 }
 
 EncodeManager::EncodeManager(SConnection* conn_)
-  : conn(conn_), recentChangeTimer(this)
+  : conn(conn_), recentChangeTimer(this), sharedMemory(nullptr),
+    sharedMemoryPending(false)
 {
   StatsVector::iterator iter;
 
   encoders.resize(encoderClassMax, nullptr);
   activeEncoders.resize(encoderTypeMax, encoderRaw);
+  exploreEncoders.resize(encoderTypeMax, -1);
+  typeRects.resize(encoderTypeMax, 0);
 
   encoders[encoderRaw] = new RawEncoder(conn);
   encoders[encoderRRE] = new RREEncoder(conn);
@@ -156,7 +201,23 @@ EncodeManager::EncodeManager(SConnection* conn_)
   encoders[encoderJPEG] = new JPEGEncoder(conn);
 
   updates = 0;
+  bufferAllocs = 0;
+  bufferAllocUpdates = 0;
   memset(&copyStats, 0, sizeof(copyStats));
+  memset(&cacheHitStats, 0, sizeof(cacheHitStats));
+  memset(&cacheStoreStats, 0, sizeof(cacheStoreStats));
+  memset(&sharedMemoryStats, 0, sizeof(sharedMemoryStats));
+  memset(&encodeStart, 0, sizeof(encodeStart));
+  memset(&encodeEnd, 0, sizeof(encodeEnd));
+
+  qualityReduction = 0;
+  refining = false;
+  goodUpdates = 0;
+  gettimeofday(&lastQualityChange, nullptr);
+  lossyUpdateBytes = 0;
+  lossyEncodeTime = 0;
+  qualityDrops = 0;
+  maxQualityDrop = 0;
   stats.resize(encoderClassMax);
   for (iter = stats.begin();iter != stats.end();++iter) {
     StatsVector::value_type::iterator iter2;
@@ -164,6 +225,19 @@ EncodeManager::EncodeManager(SConnection* conn_)
     for (iter2 = iter->begin();iter2 != iter->end();++iter2)
       memset(&*iter2, 0, sizeof(EncoderStats));
   }
+
+  models.resize(encoderClassMax);
+  for (ModelVector::iterator iter3 = models.begin();
+       iter3 != models.end(); ++iter3) {
+    ModelVector::value_type::iterator iter4;
+    iter3->resize(encoderTypeMax);
+    for (iter4 = iter3->begin();iter4 != iter3->end();++iter4)
+      memset(&*iter4, 0, sizeof(EncoderModel));
+  }
+  memset(&rectStart, 0, sizeof(rectStart));
+  activeClass = encoderRaw;
+  activeArea = 0;
+  linkBandwidth = 0;
 }
 
 EncodeManager::~EncodeManager()
@@ -172,6 +246,8 @@ EncodeManager::~EncodeManager()
 
   for (Encoder* encoder : encoders)
     delete encoder;
+
+  delete sharedMemory;
 }
 
 void EncodeManager::logStats()
@@ -188,6 +264,11 @@ void EncodeManager::logStats()
 
   vlog.info("Framebuffer updates: %u", updates);
 
+  if (bufferAllocs != 0) {
+    vlog.info("  Buffer allocations: %llu, in %u updates",
+              bufferAllocs, bufferAllocUpdates);
+  }
+
   if (copyStats.rects != 0) {
     vlog.info("  %s:", "CopyRect");
 
@@ -206,6 +287,45 @@ void EncodeManager::logStats()
               core::iecPrefix(copyStats.bytes, "B").c_str(), ratio);
   }
 
+  if ((cacheHitStats.rects != 0) || (cacheStoreStats.rects != 0)) {
+    vlog.info("  %s:", "Tile cache");
+
+    rects += cacheHitStats.rects + cacheStoreStats.rects;
+    pixels += cacheHitStats.pixels;
+    bytes += cacheHitStats.bytes + cacheStoreStats.bytes;
+    equivalent += cacheHitStats.equivalent;
+
+    ratio = (double)cacheHitStats.equivalent / cacheHitStats.bytes;
+
+    vlog.info("    %s: %s, %s", "Hits",
+              core::siPrefix(cacheHitStats.rects, "rects").c_str(),
+              core::siPrefix(cacheHitStats.pixels, "pixels").c_str());
+    vlog.info("    %*s  %s (1:%g ratio)",
+              (int)strlen("Hits"), "",
+              core::iecPrefix(cacheHitStats.bytes, "B").c_str(), ratio);
+    vlog.info("    %s: %s, %s", "Stores",
+              core::siPrefix(cacheStoreStats.rects, "rects").c_str(),
+              core::iecPrefix(cacheStoreStats.bytes, "B").c_str());
+  }
+
+  if (sharedMemoryStats.rects != 0) {
+    vlog.info("  %s:", "Shared memory");
+
+    rects += sharedMemoryStats.rects;
+    pixels += sharedMemoryStats.pixels;
+    bytes += sharedMemoryStats.bytes;
+    equivalent += sharedMemoryStats.equivalent;
+
+    ratio = (double)sharedMemoryStats.equivalent / sharedMemoryStats.bytes;
+
+    vlog.info("    %s: %s, %s", "Rects",
+              core::siPrefix(sharedMemoryStats.rects, "rects").c_str(),
+              core::siPrefix(sharedMemoryStats.pixels, "pixels").c_str());
+    vlog.info("    %*s  %s (1:%g ratio)",
+              (int)strlen("Rects"), "",
+              core::iecPrefix(sharedMemoryStats.bytes, "B").c_str(), ratio);
+  }
+
   for (i = 0;i < stats.size();i++) {
     // Did this class do anything at all?
     for (j = 0;j < stats[i].size();j++) {
@@ -244,6 +364,27 @@ void EncodeManager::logStats()
             core::siPrefix(pixels, "pixels").c_str());
   vlog.info("         %s (1:%g ratio)",
             core::iecPrefix(bytes, "B").c_str(), ratio);
+
+  if (qualityDrops != 0) {
+    vlog.info("  Quality lowered %u times, at most %d levels", qualityDrops,
+              maxQualityDrop);
+  }
+
+  if (Server::adaptiveEncoders) {
+    vlog.info("  Encoder costs:");
+
+    for (j = 0;j < encoderTypeMax;j++) {
+      for (i = 0;i < models.size();i++) {
+        if (!models[i][j].valid)
+          continue;
+
+        vlog.info("    %s: %s %.3f B/pixel, %.4f us/pixel",
+                  encoderTypeName((EncoderType)j),
+                  encoderClassName((EncoderClass)i),
+                  models[i][j].bytesPerPixel, models[i][j].usecsPerPixel);
+      }
+    }
+  }
 }
 
 bool EncodeManager::supported(int encoding)
@@ -281,6 +422,7 @@ int EncodeManager::getNextLosslessRefresh(const core::Region& req)
 void EncodeManager::pruneLosslessRefresh(const core::Region& limits)
 {
   lossyRegion.assign_intersect(limits);
+  refinedRegion.assign_intersect(limits);
   pendingRefreshRegion.assign_intersect(limits);
 }
 
@@ -302,15 +444,159 @@ void EncodeManager::writeUpdate(const UpdateInfo& ui, const PixelBuffer* pb,
     recentChangeTimer.start(RecentChangeTimeout);
 }
 
+void EncodeManager::encodeUpdate(const UpdateInfo& ui, const PixelBuffer* pb)
+{
+  doUpdate(true, ui.changed, ui.copied, ui.copy_delta, pb, nullptr);
+}
+
 void EncodeManager::writeLosslessRefresh(const core::Region& req,
+                                         const std::vector<core::Rect>& focus,
                                          const PixelBuffer* pb,
                                          const RenderedCursor* renderedCursor,
                                          size_t maxUpdateSize)
 {
-  doUpdate(false, getLosslessRefresh(req, maxUpdateSize),
+  core::Region unrefined;
+
+  // Low quality areas first get an intermediate step, which is a lot
+  // cheaper to send than going directly to lossless
+  if (needsRefinement()) {
+    unrefined = req.subtract(refinedRegion);
+    if (!pendingRefreshRegion.intersect(unrefined).is_empty()) {
+      refining = true;
+      doUpdate(true,
+               getLosslessRefresh(unrefined, focus,
+                                  maxUpdateSize * RefineCompression),
+               {}, {}, pb, renderedCursor);
+      refining = false;
+
+      // The refined areas need another round later
+      if (!recentChangeTimer.isStarted())
+        recentChangeTimer.start(RecentChangeTimeout);
+
+      return;
+    }
+  }
+
+  doUpdate(false, getLosslessRefresh(req, focus, maxUpdateSize),
            {}, {}, pb, renderedCursor);
 }
 
+void EncodeManager::getEncodeTime(struct timeval* start,
+                                  struct timeval* end) const
+{
+  *start = encodeStart;
+  *end = encodeEnd;
+}
+
+void EncodeManager::adaptQuality(Congestion* congestion,
+                                 unsigned frameTime)
+{
+  int maxReduction;
+  size_t bandwidth;
+  unsigned sendTime, drainTime, queueDelay;
+  unsigned rtt, baseRTT;
+  bool overloaded;
+
+  maxReduction = getMaxQualityReduction();
+  if (maxReduction == 0) {
+    qualityReduction = 0;
+    return;
+  }
+
+  // Nothing lossy sent yet?
+  if (lossyUpdateBytes == 0)
+    return;
+
+  bandwidth = congestion->getBandwidth();
+  if (bandwidth == 0)
+    return;
+
+  // How long the last update will occupy the link
+  sendTime = lossyUpdateBytes * 1000 / bandwidth;
+
+  // How long until what is already sent has been received
+  drainTime = (size_t)congestion->getInFlight() * 1000 / bandwidth;
+
+  // How much buffers along the way are adding to the latency
+  rtt = congestion->getRTT();
+  baseRTT = congestion->getBaseRTT();
+  if (rtt > baseRTT)
+    queueDelay = rtt - baseRTT;
+  else
+    queueDelay = 0;
+
+  overloaded = (sendTime > frameTime) ||
+               (lossyEncodeTime > frameTime) ||
+               (queueDelay > frameTime) ||
+               (drainTime > baseRTT + frameTime);
+
+  if (overloaded) {
+    goodUpdates = 0;
+
+    if (qualityReduction >= maxReduction)
+      return;
+
+    // Give the previous change a chance to have an effect
+    if (core::msSince(&lastQualityChange) < std::max(rtt, frameTime))
+      return;
+
+    qualityReduction++;
+    gettimeofday(&lastQualityChange, nullptr);
+
+    qualityDrops++;
+    if (qualityReduction > maxQualityDrop)
+      maxQualityDrop = qualityReduction;
+
+    vlog.debug("Lowering quality by %d levels (send %u ms, encode %u ms, "
+               "queue %u ms, drain %u ms)", qualityReduction, sendTime,
+               lossyEncodeTime, queueDelay, drainTime);
+    return;
+  }
+
+  if (qualityReduction == 0)
+    return;
+
+  // Only raise the quality again when there is plenty of headroom
+  if ((sendTime > frameTime / 2) || (lossyEncodeTime > frameTime / 2) ||
+      (queueDelay > frameTime / 2)) {
+    goodUpdates = 0;
+    return;
+  }
+
+  goodUpdates++;
+  if (goodUpdates < QualityRaiseUpdates)
+    return;
+
+  qualityReduction--;
+  goodUpdates = 0;
+  gettimeofday(&lastQualityChange, nullptr);
+
+  vlog.debug("Raising quality to %d levels below requested",
+             qualityReduction);
+}
+
+void EncodeManager::setSharedMemory(SharedMemory* shm)
+{
+  delete sharedMemory;
+  sharedMemory = shm;
+  sharedMemoryPending = (shm != nullptr);
+}
+
+void EncodeManager::setBandwidth(size_t bandwidth)
+{
+  linkBandwidth = bandwidth;
+}
+
+const char* EncodeManager::className(int klass)
+{
+  return encoderClassName((EncoderClass)klass);
+}
+
+const char* EncodeManager::typeName(int type)
+{
+  return encoderTypeName((EncoderType)type);
+}
+
 void EncodeManager::handleTimeout(core::Timer* t)
 {
   if (t == &recentChangeTimer) {
@@ -334,6 +620,14 @@ void EncodeManager::doUpdate(bool allowLossy, const
 {
     int nRects;
     core::Region changed, cursorRegion;
+    size_t startLength;
+    unsigned long long startAllocs, allocs;
+    bool useSharedMemory, useTileCache;
+    std::vector<NewTile> newTiles;
+
+    gettimeofday(&encodeStart, nullptr);
+    startLength = conn->getOutStream()->length();
+    startAllocs = rdr::BufferPool::heapAllocations();
 
     updates++;
 
@@ -365,9 +659,28 @@ void EncodeManager::doUpdate(bool allowLossy, const
 
     conn->writer()->writeFramebufferUpdateStart(nRects);
 
+    useSharedMemory = prepareSharedMemory();
+
     if (conn->client.supportsEncoding(encodingCopyRect))
       writeCopyRects(copied, copyDelta);
 
+    /*
+     * A client on the same host can read the pixels directly, and only
+     * what doesn't fit in the shared memory needs to be encoded.
+     */
+    if (useSharedMemory) {
+      writeSharedRects(&changed, pb);
+      writeSharedRects(&cursorRegion, renderedCursor);
+    }
+
+    /*
+     * Anything the client has already seen, and still has in its tile
+     * cache, can be sent as a reference.
+     */
+    useTileCache = prepareTileCache(pb);
+    if (useTileCache)
+      writeCachedTiles(&changed, pb, &newTiles);
+
     /*
      * We start by searching for solid rects, which are then removed
      * from the changed region.
@@ -378,7 +691,27 @@ void EncodeManager::doUpdate(bool allowLossy, const
     writeRects(changed, pb);
     writeRects(cursorRegion, renderedCursor);
 
+    if (useTileCache)
+      writeNewTiles(newTiles);
+
     conn->writer()->writeFramebufferUpdateEnd();
+
+    gettimeofday(&encodeEnd, nullptr);
+
+    // Buffers should be reused once the streams have grown to fit the
+    // content, so this should stay at zero after the first updates
+    allocs = rdr::BufferPool::heapAllocations() - startAllocs;
+    if (allocs != 0) {
+      bufferAllocs += allocs;
+      bufferAllocUpdates++;
+    }
+
+    if (allowLossy && !refining) {
+      lossyUpdateBytes = conn->getOutStream()->length() - startLength;
+      lossyEncodeTime = core::msBetween(&encodeStart, &encodeEnd);
+    }
+
+    updateEncoderModels();
 }
 
 void EncodeManager::prepareEncoders(bool allowLossy)
@@ -387,7 +720,9 @@ void EncodeManager::prepareEncoders(bool allowLossy)
   enum EncoderClass indexed, indexedRLE, fullColour;
 
   int32_t preferred;
+  int qualityLevel, fineQualityLevel;
 
+  std::vector<int> usedEncoders;
   std::vector<int>::iterator iter;
 
   solid = bitmap = bitmapRLE = encoderRaw;
@@ -513,16 +848,46 @@ void EncodeManager::prepareEncoders(bool allowLossy)
   activeEncoders[encoderIndexedRLE] = indexedRLE;
   activeEncoders[encoderFullColour] = fullColour;
 
-  for (iter = activeEncoders.begin(); iter != activeEncoders.end(); ++iter) {
+  std::fill(exploreEncoders.begin(), exploreEncoders.end(), -1);
+  if (Server::adaptiveEncoders)
+    selectEncoders();
+
+  // Apply any reduction from adaptQuality(), staying within the bounds
+  // the client gave us
+  if (qualityReduction > getMaxQualityReduction())
+    qualityReduction = getMaxQualityReduction();
+
+  qualityLevel = conn->client.qualityLevel;
+  fineQualityLevel = conn->client.fineQualityLevel;
+  if (fineQualityLevel != -1)
+    fineQualityLevel -= qualityReduction * FineQualityStep;
+  else if (qualityLevel != -1)
+    qualityLevel -= qualityReduction;
+
+  if (refining) {
+    qualityLevel = Server::refineQuality;
+    fineQualityLevel = -1;
+  }
+
+  usedEncoders = activeEncoders;
+  for (iter = exploreEncoders.begin(); iter != exploreEncoders.end(); ++iter) {
+    if (*iter != -1)
+      usedEncoders.push_back(*iter);
+  }
+
+  for (iter = usedEncoders.begin(); iter != usedEncoders.end(); ++iter) {
     Encoder *encoder;
 
     encoder = encoders[*iter];
 
     encoder->setCompressLevel(conn->client.compressLevel);
 
-    if (allowLossy) {
-      encoder->setQualityLevel(conn->client.qualityLevel);
-      encoder->setFineQualityLevel(conn->client.fineQualityLevel,
+    if (refining) {
+      encoder->setQualityLevel(qualityLevel);
+      encoder->setFineQualityLevel(-1, subsampleUndefined);
+    } else if (allowLossy) {
+      encoder->setQualityLevel(qualityLevel);
+      encoder->setFineQualityLevel(fineQualityLevel,
                                    conn->client.subsampling);
     } else {
       if (conn->client.qualityLevel < encoder->losslessQuality)
@@ -534,11 +899,203 @@ void EncodeManager::prepareEncoders(bool allowLossy)
   }
 }
 
+void EncodeManager::selectEncoders()
+{
+  static const EncoderType types[] = {
+    encoderBitmap, encoderBitmapRLE, encoderIndexed, encoderIndexedRLE,
+    encoderFullColour
+  };
+  static const EncoderClass candidates[] = {
+    encoderTight, encoderZRLE, encoderHextile, encoderRRE
+  };
+
+  double linkSpeed;
+
+  linkSpeed = linkBandwidth;
+  if (linkSpeed == 0)
+    linkSpeed = DefaultBandwidth;
+
+  for (EncoderType type : types) {
+    int best, stale;
+    double bestCost;
+
+    // Lossy encoders are governed by the quality level instead, as
+    // they are not comparable to lossless ones
+    if (encoders[activeEncoders[type]]->flags & EncoderLossy)
+      continue;
+
+    best = -1;
+    bestCost = 0;
+
+    for (EncoderClass klass : candidates) {
+      const EncoderModel* model;
+      double cost;
+
+      if (!encoders[klass]->isSupported())
+        continue;
+      if (encoders[klass]->flags & EncoderLossy)
+        continue;
+      // RRE is only sensible for content with long runs
+      if ((klass == encoderRRE) &&
+          (type != encoderBitmapRLE) && (type != encoderIndexedRLE))
+        continue;
+
+      model = &models[klass][type];
+      if (!model->valid)
+        continue;
+
+      // The time it takes to get a pixel to the client, assuming the
+      // link and the CPU can't be used in parallel
+      cost = model->usecsPerPixel +
+             model->bytesPerPixel * 1000000.0 / linkSpeed;
+
+      // Measurements are noisy, so the current choice gets a head
+      // start to avoid flapping between similar encoders
+      if (klass == activeEncoders[type])
+        cost = cost * (1.0 - EncoderSwitchMargin);
+
+      if ((best == -1) || (cost < bestCost)) {
+        best = klass;
+        bestCost = cost;
+      }
+    }
+
+    if (best != -1)
+      activeEncoders[type] = best;
+
+    // Make sure every other encoder gets measured now and again, in
+    // case it has become the better choice
+    stale = -1;
+    for (EncoderClass klass : candidates) {
+      const EncoderModel* model;
+
+      if (klass == activeEncoders[type])
+        continue;
+      if (!encoders[klass]->isSupported())
+        continue;
+      if (encoders[klass]->flags & EncoderLossy)
+        continue;
+      if ((klass == encoderRRE) &&
+          (type != encoderBitmapRLE) && (type != encoderIndexedRLE))
+        continue;
+
+      model = &models[klass][type];
+      if (model->valid &&
+          ((updates - model->lastSample) <= EncoderModelMaxAge)) {
+        double cost;
+
+        if (model->weight >= 1.0)
+          continue;
+
+        // Sampling an encoder that is far behind is expensive, so wait
+        // until its data is old before trying it again
+        cost = model->usecsPerPixel +
+               model->bytesPerPixel * 1000000.0 / linkSpeed;
+        if (cost > bestCost * 2)
+          continue;
+      }
+
+      if ((stale == -1) ||
+          (model->lastSample < models[stale][type].lastSample))
+        stale = klass;
+    }
+
+    exploreEncoders[type] = stale;
+  }
+}
+
+void EncodeManager::updateEncoderModels()
+{
+  size_t i, j;
+
+  for (i = 0;i < models.size();i++) {
+    for (j = 0;j < models[i].size();j++) {
+      EncoderModel* model;
+      double bytesPerPixel, usecsPerPixel, weight;
+
+      model = &models[i][j];
+      if (model->pendingPixels == 0)
+        continue;
+
+      bytesPerPixel = (double)model->pendingBytes / model->pendingPixels;
+      usecsPerPixel = (double)model->pendingUsecs / model->pendingPixels;
+
+      // Small samples are noisy, so let them count for less
+      weight = (double)model->pendingPixels / EncoderModelPixels;
+      if (weight > 1.0)
+        weight = 1.0;
+
+      if (!model->valid) {
+        model->bytesPerPixel = bytesPerPixel;
+        model->usecsPerPixel = usecsPerPixel;
+        model->weight = weight;
+        model->valid = true;
+      } else {
+        // Start over if this is the first sample in a long while
+        if ((updates - model->lastSample) > EncoderModelMaxAge)
+          model->weight = 0;
+
+        model->weight += weight;
+        if (model->weight > 1.0)
+          model->weight = 1.0;
+
+        weight /= 2;
+        model->bytesPerPixel += (bytesPerPixel - model->bytesPerPixel) * weight;
+        model->usecsPerPixel += (usecsPerPixel - model->usecsPerPixel) * weight;
+      }
+
+      model->lastSample = updates;
+
+      model->pendingBytes = 0;
+      model->pendingPixels = 0;
+      model->pendingUsecs = 0;
+    }
+  }
+}
+
+int EncodeManager::getMaxQualityReduction()
+{
+  // Fine quality takes precedence, so that is what we need to adjust
+  if (conn->client.fineQualityLevel != -1)
+    return (conn->client.fineQualityLevel - 1) / FineQualityStep;
+
+  if (conn->client.qualityLevel != -1)
+    return conn->client.qualityLevel;
+
+  return 0;
+}
+
+bool EncodeManager::needsRefinement()
+{
+  int level;
+
+  if (Server::refineQuality < 0)
+    return false;
+
+  // The refinement would be in colour
+  if (conn->client.subsampling == subsampleGray)
+    return false;
+
+  // Only JPEG can give us an intermediate quality
+  if (!encoders[encoderJPEG]->isSupported() &&
+      !encoders[encoderTightJPEG]->isSupported())
+    return false;
+
+  if (conn->client.fineQualityLevel != -1)
+    level = (conn->client.fineQualityLevel - 1) / FineQualityStep;
+  else
+    level = conn->client.qualityLevel;
+
+  return (level - qualityReduction) < Server::refineQuality;
+}
+
 core::Region EncodeManager::getLosslessRefresh(const core::Region& req,
+                                               const std::vector<core::Rect>& focus,
                                                size_t maxUpdateSize)
 {
   std::vector<core::Rect> rects;
-  core::Region refresh;
+  std::vector<core::Rect>::const_iterator focusRect;
+  core::Region remaining, refresh;
   size_t area;
 
   // We make a conservative guess at the compression ratio at 2:1
@@ -548,43 +1105,106 @@ core::Region EncodeManager::getLosslessRefresh(const core::Region& req,
   maxUpdateSize /= 4;
 
   area = 0;
-  pendingRefreshRegion.intersect(req).get_rects(&rects);
-  while (!rects.empty()) {
-    size_t idx;
-    core::Rect rect;
+  remaining = pendingRefreshRegion.intersect(req);
+
+  // Start with what the user has been interacting with most recently,
+  // as that is most likely where they are looking
+  for (focusRect = focus.begin(); focusRect != focus.end(); ++focusRect) {
+    rects.clear();
+    remaining.intersect(*focusRect).get_rects(&rects);
+    remaining.assign_subtract(*focusRect);
+
+    sortByDistance(&rects, focus.front());
+    if (addLosslessRefresh(&rects, maxUpdateSize, &area, &refresh))
+      return refresh;
+  }
+
+  rects.clear();
+  remaining.get_rects(&rects);
+
+  if (!focus.empty()) {
+    sortByDistance(&rects, focus.front());
+  } else {
+    // Go in a random order so we don't keep damaging and restoring
+    // the same rect over and over
+    for (size_t i = rects.size(); i > 1; i--)
+      std::swap(rects[i - 1], rects[rand() % i]);
+  }
+
+  addLosslessRefresh(&rects, maxUpdateSize, &area, &refresh);
 
-    // Grab a random rect so we don't keep damaging and restoring the
-    // same rect over and over
-    idx = rand() % rects.size();
+  return refresh;
+}
+
+void EncodeManager::sortByDistance(std::vector<core::Rect>* rects,
+                                   const core::Rect& target)
+{
+  core::Point centre;
 
-    rect = rects[idx];
+  centre = core::Point((target.tl.x + target.br.x) / 2,
+                       (target.tl.y + target.br.y) / 2);
+
+  std::stable_sort(rects->begin(), rects->end(),
+                   [centre](const core::Rect& a, const core::Rect& b) {
+    return distance(a, centre) < distance(b, centre);
+  });
+}
+
+long long EncodeManager::distance(const core::Rect& rect,
+                                  const core::Point& point)
+{
+  long long dx, dy;
+
+  dx = 0;
+  if (point.x < rect.tl.x)
+    dx = rect.tl.x - point.x;
+  else if (point.x >= rect.br.x)
+    dx = point.x - rect.br.x + 1;
+
+  dy = 0;
+  if (point.y < rect.tl.y)
+    dy = rect.tl.y - point.y;
+  else if (point.y >= rect.br.y)
+    dy = point.y - rect.br.y + 1;
+
+  return dx * dx + dy * dy;
+}
+
+bool EncodeManager::addLosslessRefresh(const std::vector<core::Rect>* rects,
+                                       size_t maxArea, size_t* area,
+                                       core::Region* refresh)
+{
+  std::vector<core::Rect>::const_iterator iter;
+
+  for (iter = rects->begin(); iter != rects->end(); ++iter) {
+    core::Rect rect;
+
+    rect = *iter;
 
     // Add rects until we exceed the threshold, then include as much as
     // possible of the final rect
-    if ((area + rect.area()) > maxUpdateSize) {
+    if ((*area + rect.area()) > maxArea) {
       // Use the narrowest axis to avoid getting to thin rects
       if (rect.width() > rect.height()) {
-        int width = (maxUpdateSize - area) / rect.height();
+        int width = (maxArea - *area) / rect.height();
         if (width < 1)
           width = 1;
         rect.br.x = rect.tl.x + width;
       } else {
-        int height = (maxUpdateSize - area) / rect.width();
+        int height = (maxArea - *area) / rect.width();
         if (height < 1)
           height = 1;
         rect.br.y = rect.tl.y + height;
       }
-      refresh.assign_union(rect);
-      break;
+      refresh->assign_union(rect);
+      return true;
     }
 
-    area += rect.area();
-    refresh.assign_union(rect);
-
-    rects.erase(rects.begin() + idx);
+    *area += rect.area();
+    refresh->assign_union(rect);
   }
 
-  return refresh;
+  return false;
 }
 
 int EncodeManager::computeNumRects(const core::Region& changed)
@@ -629,7 +1249,19 @@ Encoder* EncodeManager::startRect(const core::Rect& rect, int type)
   activeType = type;
   klass = activeEncoders[activeType];
 
+  // Every so often we try another encoder to see how it performs
+  if ((exploreEncoders[activeType] != -1) &&
+      (rect.area() <= EncoderExploreMaxArea)) {
+    if ((typeRects[activeType] % EncoderExploreInterval) == 0)
+      klass = exploreEncoders[activeType];
+    typeRects[activeType]++;
+  }
+
+  activeClass = klass;
+
   beforeLength = conn->getOutStream()->length();
+  activeArea = rect.area();
+  gettimeofday(&rectStart, nullptr);
 
   stats[klass][activeType].rects++;
   stats[klass][activeType].pixels += rect.area();
@@ -641,10 +1273,16 @@ Encoder* EncodeManager::startRect(const core::Rect& rect, int type)
 
   if ((encoder->flags & EncoderLossy) &&
       ((encoder->losslessQuality == -1) ||
-       (encoder->getQualityLevel() < encoder->losslessQuality)))
+       (encoder->getQualityLevel() < encoder->losslessQuality))) {
     lossyRegion.assign_union(rect);
-  else
+    if (refining)
+      refinedRegion.assign_union(rect);
+    else
+      refinedRegion.assign_subtract(rect);
+  } else {
     lossyRegion.assign_subtract(rect);
+    refinedRegion.assign_subtract(rect);
+  }
 
   // This was either a rect getting refreshed, or a rect that just got
   // new content. Either way we should not try to refresh it anymore.
@@ -657,13 +1295,28 @@ void EncodeManager::endRect()
 {
   int klass;
   int length;
+  struct timeval now;
+  long long usecs;
 
   conn->writer()->endRect();
 
   length = conn->getOutStream()->length() - beforeLength;
 
-  klass = activeEncoders[activeType];
+  klass = activeClass;
   stats[klass][activeType].bytes += length;
+
+  gettimeofday(&now, nullptr);
+  usecs = (now.tv_sec - rectStart.tv_sec) * 1000000 +
+          (now.tv_usec - rectStart.tv_usec);
+  // Clock adjustments can make time go backwards
+  if (usecs < 0)
+    usecs = 0;
+
+  stats[klass][activeType].usecs += usecs;
+
+  models[klass][activeType].pendingBytes += length;
+  models[klass][activeType].pendingPixels += activeArea;
+  models[klass][activeType].pendingUsecs += usecs;
 }
 
 void EncodeManager::writeCopyRects(const core::Region& copied,
@@ -672,7 +1325,7 @@ void EncodeManager::writeCopyRects(const core::Region& copied,
   std::vector<core::Rect> rects;
   std::vector<core::Rect>::const_iterator rect;
 
-  core::Region lossyCopy;
+  core::Region lossyCopy, refinedCopy;
 
   beforeLength = conn->getOutStream()->length();
 
@@ -696,6 +1349,12 @@ void EncodeManager::writeCopyRects(const core::Region& copied,
   lossyCopy.assign_intersect(copied);
   lossyRegion.assign_union(lossyCopy);
 
+  refinedCopy = refinedRegion;
+  refinedCopy.translate(delta);
+  refinedCopy.assign_intersect(copied);
+  refinedRegion.assign_subtract(copied);
+  refinedRegion.assign_union(refinedCopy);
+
   // Stop any pending refresh as a copy is enough that we consider
   // this region to be recently changed
   pendingRefreshRegion.assign_subtract(copied);
@@ -860,6 +1519,198 @@ void EncodeManager::writeRects(const core::Region& changed,
   }
 }
 
+bool EncodeManager::prepareTileCache(const PixelBuffer* pb)
+{
+  size_t maxTiles;
+
+  // We have no way of counting the rects up front, so the client
+  // needs to support LastRect
+  if (!conn->client.supportsEncoding(encodingTileCache) ||
+      !conn->client.supportsEncoding(pseudoEncodingLastRect)) {
+    tileCache.setMaxTiles(0);
+    return false;
+  }
+
+  maxTiles = std::min(conn->client.tileCacheSize,
+                      (size_t)Server::tileCacheSize * tileCacheTilesPerMiB);
+
+  // The client's tiles are only ever evicted in the same order as
+  // ours, so using less than the client has is always safe
+  tileCache.setMaxTiles(maxTiles);
+  if (maxTiles == 0)
+    return false;
+
+  // Tiles are hashed in our format, but cached in the client's, so
+  // a change in either means starting over
+  if (!(tileCacheClientPF == conn->client.pf()) ||
+      !(tileCacheServerPF == pb->getPF())) {
+    tileCache.clear();
+    conn->writer()->writeTileCacheRect({0, 0, 0, 0}, tileCacheReset, 0);
+
+    tileCacheClientPF = conn->client.pf();
+    tileCacheServerPF = pb->getPF();
+  }
+
+  return true;
+}
+
+void EncodeManager::writeCachedTiles(core::Region* changed,
+                                     const PixelBuffer* pb,
+                                     std::vector<NewTile>* newTiles)
+{
+  core::Rect bounds, tile;
+  core::Region cached;
+  int x, y;
+
+  bounds = changed->get_bounding_rect();
+
+  // Tiles are aligned so that content is found again if it hasn't
+  // moved
+  for (y = (bounds.tl.y + tileCacheTileSize - 1) / tileCacheTileSize *
+           tileCacheTileSize;
+       y + tileCacheTileSize <= bounds.br.y; y += tileCacheTileSize) {
+    for (x = (bounds.tl.x + tileCacheTileSize - 1) / tileCacheTileSize *
+             tileCacheTileSize;
+         x + tileCacheTileSize <= bounds.br.x; x += tileCacheTileSize) {
+      NewTile newTile;
+      uint32_t id;
+      int equiv;
+
+      // We define it like this to guarantee alignment
+      uint32_t _buffer;
+      uint8_t* colourValue = (uint8_t*)&_buffer;
+
+      tile.setXYWH(x, y, tileCacheTileSize, tileCacheTileSize);
+      if (!core::Region(tile).subtract(*changed).is_empty())
+        continue;
+
+      // Solid areas are cheaper to send as they are
+      pb->getImage(colourValue, {x, y, x+1, y+1});
+      if (checkSolidTile(tile, colourValue, pb))
+        continue;
+
+      newTile.rect = tile;
+      newTile.hash = TileCache::hashRect(pb, tile);
+
+      if (!tileCache.lookup(newTile.hash, &id)) {
+        newTiles->push_back(newTile);
+        continue;
+      }
+
+      beforeLength = conn->getOutStream()->length();
+
+      conn->writer()->writeTileCacheRect(tile, tileCacheDraw, id);
+
+      cacheHitStats.rects++;
+      cacheHitStats.pixels += tile.area();
+      equiv = 12 + tile.area() * (conn->client.pf().bpp/8);
+      cacheHitStats.equivalent += equiv;
+      cacheHitStats.bytes += conn->getOutStream()->length() - beforeLength;
+
+      // Only lossless tiles are ever cached
+      lossyRegion.assign_subtract(tile);
+      refinedRegion.assign_subtract(tile);
+      pendingRefreshRegion.assign_subtract(tile);
+
+      cached.assign_union(tile);
+    }
+  }
+
+  changed->assign_subtract(cached);
+}
+
+void EncodeManager::writeNewTiles(const std::vector<NewTile>& newTiles)
+{
+  std::vector<NewTile>::const_iterator tile;
+
+  for (tile = newTiles.begin(); tile != newTiles.end(); ++tile) {
+    uint32_t id;
+
+    // The client would get a lossy copy
+    if (!lossyRegion.intersect(tile->rect).is_empty())
+      continue;
+
+    // Same content more than once in this update
+    if (tileCache.contains(tile->hash))
+      continue;
+
+    beforeLength = conn->getOutStream()->length();
+
+    id = tileCache.add(tile->hash);
+    conn->writer()->writeTileCacheRect(tile->rect, tileCacheStore, id);
+
+    cacheStoreStats.rects++;
+    cacheStoreStats.bytes += conn->getOutStream()->length() - beforeLength;
+  }
+}
+
+bool EncodeManager::prepareSharedMemory()
+{
+  if (sharedMemory == nullptr)
+    return false;
+
+  // Same as for the tile cache, the client needs to support LastRect
+  // as we don't know up front how many rects will fit
+  if (!conn->client.supportsEncoding(encodingSharedMemory) ||
+      !conn->client.supportsEncoding(pseudoEncodingSharedMemory) ||
+      !conn->client.supportsEncoding(pseudoEncodingLastRect))
+    return false;
+
+  if (sharedMemoryPending) {
+    conn->writer()->writeSharedMemoryAttachRect(sharedMemory->getSize());
+    sharedMemoryPending = false;
+  }
+
+  // The client tells us through the buffer once it is ready
+  return sharedMemory->isAttached();
+}
+
+void EncodeManager::writeSharedRects(core::Region* changed,
+                                     const PixelBuffer* pb)
+{
+  std::vector<core::Rect> rects;
+  std::vector<core::Rect>::const_iterator rect;
+  core::Region written;
+
+  changed->get_rects(&rects);
+  for (rect = rects.begin(); rect != rects.end(); ++rect) {
+    const uint8_t* src;
+    uint8_t* dst;
+    uint32_t offset;
+    int stride, equiv;
+
+    // The client hasn't caught up, so this one has to be encoded
+    dst = sharedMemory->alloc(rect->area() * (conn->client.pf().bpp/8),
+                              &offset);
+    if (dst == nullptr)
+      continue;
+
+    beforeLength = conn->getOutStream()->length();
+
+    src = pb->getBuffer(*rect, &stride);
+    conn->client.pf().bufferFromBuffer(dst, pb->getPF(), src,
+                                       rect->width(), rect->height(),
+                                       rect->width(), stride);
+
+    conn->writer()->writeSharedMemoryRect(*rect, offset);
+
+    sharedMemoryStats.rects++;
+    sharedMemoryStats.pixels += rect->area();
+    equiv = 12 + rect->area() * (conn->client.pf().bpp/8);
+    sharedMemoryStats.equivalent += equiv;
+    sharedMemoryStats.bytes += conn->getOutStream()->length() - beforeLength;
+
+    // Always lossless
+    lossyRegion.assign_subtract(*rect);
+    refinedRegion.assign_subtract(*rect);
+    pendingRefreshRegion.assign_subtract(*rect);
+
+    written.assign_union(*rect);
+  }
+
+  changed->assign_subtract(written);
+}
+
 void EncodeManager::writeSubRect(const core::Rect& rect,
                                  const PixelBuffer* pb)
 {
@@ -906,6 +1757,18 @@ void EncodeManager::writeSubRect(const core::Rect& rect,
   if (maxColours > encoder->maxPaletteSize)
     maxColours = encoder->maxPaletteSize;
 
+  // An encoder we're measuring might get the rect instead
+  if (exploreEncoders[encoderIndexedRLE] != -1) {
+    encoder = encoders[exploreEncoders[encoderIndexedRLE]];
+    if (maxColours > encoder->maxPaletteSize)
+      maxColours = encoder->maxPaletteSize;
+  }
+  if (exploreEncoders[encoderIndexed] != -1) {
+    encoder = encoders[exploreEncoders[encoderIndexed]];
+    if (maxColours > encoder->maxPaletteSize)
+      maxColours = encoder->maxPaletteSize;
+  }
+
   ppb = preparePixelBuffer(rect, pb, true);
 
   if (!analyseRect(ppb, &info, maxColours))
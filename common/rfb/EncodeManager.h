@@ -23,19 +23,23 @@
 #include <vector>
 
 #include <stdint.h>
+#include <sys/time.h>
 
 #include <core/Region.h>
 #include <core/Timer.h>
 
 #include <rfb/PixelBuffer.h>
+#include <rfb/TileCache.h>
 
 namespace rfb {
 
   class SConnection;
+  class Congestion;
   class Encoder;
   class UpdateInfo;
   class PixelBuffer;
   class RenderedCursor;
+  class SharedMemory;
 
   struct RectInfo;
 
@@ -59,12 +63,44 @@ namespace rfb {
     void writeUpdate(const UpdateInfo& ui, const PixelBuffer* pb,
                      const RenderedCursor* renderedCursor);
 
+    // encodeUpdate() is like writeUpdate(), but the changes aren't
+    // tracked for later lossless refreshes. No timers are used, so it
+    // is safe to call from a thread other than the main one.
+    void encodeUpdate(const UpdateInfo& ui, const PixelBuffer* pb);
+
+    // writeLosslessRefresh() prefers areas in focus, which should be
+    // given in order of importance
     void writeLosslessRefresh(const core::Region& req,
+                              const std::vector<core::Rect>& focus,
                               const PixelBuffer* pb,
                               const RenderedCursor* renderedCursor,
                               size_t maxUpdateSize);
 
+    // getEncodeTime() returns when encoding of the most recent update
+    // started and ended
+    void getEncodeTime(struct timeval* start, struct timeval* end) const;
+
+    // adaptQuality() lowers or restores the lossy quality, within what
+    // the client has asked for, so that each update can be encoded and
+    // sent within the given frame time (in ms)
+    void adaptQuality(Congestion* congestion, unsigned frameTime);
+
+    // setBandwidth() tells the encoder selection how fast the link to
+    // the client is, in bytes per second
+    void setBandwidth(size_t bandwidth);
+
+    // setSharedMemory() gives a buffer shared with the client, which
+    // is announced in the next update and used for all rects once the
+    // client has attached to it. The EncodeManager takes ownership of
+    // the buffer.
+    void setSharedMemory(SharedMemory* shm);
+    const SharedMemory* getSharedMemory() const { return sharedMemory; }
+
   protected:
+    // Names of the encoder classes and content types in stats
+    static const char* className(int klass);
+    static const char* typeName(int type);
+
     void handleTimeout(core::Timer* t) override;
 
     void doUpdate(bool allowLossy, const core::Region& changed,
@@ -73,9 +109,22 @@ namespace rfb {
                   const PixelBuffer* pb,
                   const RenderedCursor* renderedCursor);
     void prepareEncoders(bool allowLossy);
+    void selectEncoders();
+    void updateEncoderModels();
+
+    int getMaxQualityReduction();
+    bool needsRefinement();
 
     core::Region getLosslessRefresh(const core::Region& req,
+                                    const std::vector<core::Rect>& focus,
                                     size_t maxUpdateSize);
+    static void sortByDistance(std::vector<core::Rect>* rects,
+                               const core::Rect& target);
+    static long long distance(const core::Rect& rect,
+                              const core::Point& point);
+    static bool addLosslessRefresh(const std::vector<core::Rect>* rects,
+                                   size_t maxArea, size_t* area,
+                                   core::Region* refresh);
 
     int computeNumRects(const core::Region& changed);
 
@@ -89,6 +138,19 @@ namespace rfb {
                        const PixelBuffer* pb);
     void writeRects(const core::Region& changed, const PixelBuffer* pb);
 
+    struct NewTile {
+      core::Rect rect;
+      uint64_t hash;
+    };
+
+    bool prepareTileCache(const PixelBuffer* pb);
+    void writeCachedTiles(core::Region* changed, const PixelBuffer* pb,
+                          std::vector<NewTile>* newTiles);
+    void writeNewTiles(const std::vector<NewTile>& newTiles);
+
+    bool prepareSharedMemory();
+    void writeSharedRects(core::Region* changed, const PixelBuffer* pb);
+
     void writeSubRect(const core::Rect& rect, const PixelBuffer* pb);
 
     bool checkSolidTile(const core::Rect& r, const uint8_t* colourValue,
@@ -123,8 +185,12 @@ namespace rfb {
 
     std::vector<Encoder*> encoders;
     std::vector<int> activeEncoders;
+    std::vector<int> exploreEncoders;
+    std::vector<unsigned> typeRects;
 
     core::Region lossyRegion;
+    // Part of lossyRegion that has already been refined
+    core::Region refinedRegion;
     core::Region recentlyChangedRegion;
     core::Region pendingRefreshRegion;
 
@@ -135,15 +201,64 @@ namespace rfb {
       unsigned long long bytes;
       unsigned long long pixels;
       unsigned long long equivalent;
+      unsigned long long usecs;
     };
     typedef std::vector< std::vector<struct EncoderStats> > StatsVector;
 
     unsigned updates;
+    // Stream buffers that had to come from the heap, and in how many
+    // updates that happened
+    unsigned long long bufferAllocs;
+    unsigned bufferAllocUpdates;
     EncoderStats copyStats;
+    EncoderStats cacheHitStats;
+    EncoderStats cacheStoreStats;
+    EncoderStats sharedMemoryStats;
     StatsVector stats;
     int activeType;
+    int activeClass;
     int beforeLength;
 
+    struct timeval encodeStart;
+    struct timeval encodeEnd;
+
+    int qualityReduction;
+    bool refining;
+    unsigned goodUpdates;
+    struct timeval lastQualityChange;
+    size_t lossyUpdateBytes;
+    unsigned lossyEncodeTime;
+
+    unsigned qualityDrops;
+    int maxQualityDrop;
+
+    // Measured cost of each encoder for each type of content, used
+    // when picking encoders adaptively
+    struct EncoderModel {
+      bool valid;
+      double weight;
+      double bytesPerPixel;
+      double usecsPerPixel;
+      unsigned lastSample;
+
+      unsigned long long pendingBytes;
+      unsigned long long pendingPixels;
+      unsigned long long pendingUsecs;
+    };
+    typedef std::vector< std::vector<struct EncoderModel> > ModelVector;
+
+    ModelVector models;
+    struct timeval rectStart;
+    int activeArea;
+    size_t linkBandwidth;
+
+    TileCache tileCache;
+    PixelFormat tileCacheClientPF;
+    PixelFormat tileCacheServerPF;
+
+    SharedMemory* sharedMemory;
+    bool sharedMemoryPending;
+
     class OffsetPixelBuffer : public FullFramePixelBuffer {
     public:
       OffsetPixelBuffer() {}
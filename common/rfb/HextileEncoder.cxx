@@ -298,6 +298,7 @@ int HextileEncoder::testTileType(T* data, int w, int h, T* bg, T* fg)
 
 //
 // This class analyzes a separate tile and encodes its subrectangles.
+// The pixels are read straight from the framebuffer.
 //
 
 template<class T>
@@ -308,9 +309,9 @@ class HextileTile {
   HextileTile ();
 
   //
-  // Initialize existing object instance with new tile data.
+  // Analyze a new tile, filling in all the data fields.
   //
-  void newTile(const T *src, int w, int h);
+  void analyze(const T *src, int stride, int w, int h);
 
   //
   // Flags can include: hextileRaw, hextileAnySubrects and
@@ -329,12 +330,12 @@ class HextileTile {
   //
   // Return optimal background.
   //
-  int getBackground() const { return m_background; }
+  T getBackground() const { return m_background; }
 
   //
   // Return foreground if flags include hextileSubrectsColoured.
   //
-  int getForeground() const { return m_foreground; }
+  T getForeground() const { return m_foreground; }
 
   //
   // Encode subrects. This function may be called only if
@@ -347,13 +348,13 @@ class HextileTile {
  protected:
 
   //
-  // Analyze the tile pixels, fill in all the data fields.
+  // Count another subrect of the given colour. Returns false if the
+  // tile has too many colours to be worth encoding.
   //
-  void analyze();
+  inline bool addColour(T colour);
 
-  const T *m_tile;
-  int m_width;
-  int m_height;
+  // More colours than this and the tile is sent raw
+  static const int MaxColours = 48 + 2 * sizeof(T) * 8;
 
   size_t m_size;
   int m_flags;
@@ -366,89 +367,164 @@ class HextileTile {
 
  private:
 
-  bool m_processed[16][16];
-  Palette m_pal;
+  // One bit per pixel, set for pixels covered by earlier subrects
+  uint16_t m_processed[16];
+
+  // How many subrects use each colour. The background is the colour
+  // that first reached the highest count, which is what the generic
+  // Palette class would have picked.
+  int m_numColours;
+  int m_lastColour;
+  int m_bgCount;
+  T m_palColours[MaxColours];
+  int m_palCounts[MaxColours];
+
+  // Hash table for finding colours in the list above
+  static const int HashBits = 8;
+  static const int HashSize = 1 << HashBits;
+  unsigned m_generation;
+  unsigned m_hashGen[HashSize];
+  uint8_t m_hashIndex[HashSize];
 };
 
 template<class T>
 HextileTile<T>::HextileTile()
-  : m_tile(nullptr), m_width(0), m_height(0),
-    m_size(0), m_flags(0), m_background(0), m_foreground(0),
-    m_numSubrects(0)
+  : m_size(0), m_flags(0), m_background(0), m_foreground(0),
+    m_numSubrects(0), m_numColours(0), m_lastColour(0), m_bgCount(0),
+    m_generation(0)
 {
+  memset(m_hashGen, 0, sizeof(m_hashGen));
 }
 
 template<class T>
-void HextileTile<T>::newTile(const T *src, int w, int h)
+inline bool HextileTile<T>::addColour(T colour)
 {
-  m_tile = src;
-  m_width = w;
-  m_height = h;
+  unsigned hash;
+  int i;
 
-  analyze();
+  // Subrects tend to come in runs of the same colour
+  if ((m_lastColour < m_numColours) &&
+      (m_palColours[m_lastColour] == colour)) {
+    i = m_lastColour;
+  } else {
+    // Entries from earlier tiles have an older generation, which
+    // saves us from clearing the table for every tile
+    hash = ((uint32_t)colour * 2654435761U) >> (32 - HashBits);
+    while (true) {
+      if (m_hashGen[hash] != m_generation) {
+        if (m_numColours == MaxColours)
+          return false;
+        i = m_numColours++;
+        m_palColours[i] = colour;
+        m_palCounts[i] = 0;
+        m_hashGen[hash] = m_generation;
+        m_hashIndex[hash] = i;
+        break;
+      }
+      if (m_palColours[m_hashIndex[hash]] == colour) {
+        i = m_hashIndex[hash];
+        break;
+      }
+      hash = (hash + 1) & (HashSize - 1);
+    }
+
+    m_lastColour = i;
+  }
+
+  m_palCounts[i]++;
+  if (m_palCounts[i] > m_bgCount) {
+    m_bgCount = m_palCounts[i];
+    m_background = colour;
+  }
+
+  return true;
 }
 
+// Returns true if all pixels in the row have the given colour. This
+// is written without branches in the loop so that the compiler can
+// vectorise it.
 template<class T>
-void HextileTile<T>::analyze()
+static inline bool isSolidRow(const T* row, int w, T colour)
 {
-  assert(m_tile && m_width && m_height);
+  T diff;
 
-  const T *ptr = m_tile;
-  const T *end = &m_tile[m_width * m_height];
-  T color = *ptr++;
-  while (ptr != end && *ptr == color)
-    ptr++;
+  diff = 0;
+  for (int x = 0; x < w; x++)
+    diff |= row[x] ^ colour;
+
+  return diff == 0;
+}
+
+template<class T>
+void HextileTile<T>::analyze(const T *tile, int stride, int w, int h)
+{
+  assert(tile && w && h);
+
+  T color;
+  int y;
+
+  // Compute number of complete rows of the same color, at the top
+  color = tile[0];
+  for (y = 0; y < h; y++) {
+    if (!isSolidRow(&tile[y * stride], w, color))
+      break;
+  }
 
   // Handle solid tile
-  if (ptr == end) {
-    m_background = m_tile[0];
+  if (y == h) {
+    m_background = color;
     m_flags = 0;
     m_size = 0;
     return;
   }
 
-  // Compute number of complete rows of the same color, at the top
-  int y = (ptr - m_tile) / m_width;
-
   T *colorsPtr = m_colors;
   uint8_t *coordsPtr = m_coords;
-  m_pal.clear();
   m_numSubrects = 0;
+  m_numColours = 0;
+  m_lastColour = 0;
+  m_bgCount = 0;
+
+  // Forget the colours of the previous tile
+  m_generation++;
+  if (m_generation == 0) {
+    memset(m_hashGen, 0, sizeof(m_hashGen));
+    m_generation = 1;
+  }
 
   // Have we found the first subrect already?
   if (y > 0) {
     *colorsPtr++ = color;
     *coordsPtr++ = 0;
-    *coordsPtr++ = (uint8_t)(((m_width - 1) << 4) | ((y - 1) & 0x0F));
-    m_pal.insert(color, 1);
+    *coordsPtr++ = (uint8_t)(((w - 1) << 4) | ((y - 1) & 0x0F));
+    addColour(color);
     m_numSubrects++;
   }
 
-  memset(m_processed, 0, 16 * 16 * sizeof(bool));
+  memset(m_processed, 0, sizeof(m_processed));
 
   int x, sx, sy, sw, sh, max_x;
+  const T *row;
 
-  for (; y < m_height; y++) {
-    for (x = 0; x < m_width; x++) {
+  for (; y < h; y++) {
+    row = &tile[y * stride];
+    for (x = 0; x < w; x++) {
       // Skip pixels that were processed earlier
-      if (m_processed[y][x]) {
+      if (m_processed[y] & (1 << x))
         continue;
-      }
+
       // Determine dimensions of the horizontal subrect
-      color = m_tile[y * m_width + x];
-      for (sx = x + 1; sx < m_width; sx++) {
-        if (m_tile[y * m_width + sx] != color)
+      color = row[x];
+      for (sx = x + 1; sx < w; sx++) {
+        if (row[sx] != color)
           break;
       }
       sw = sx - x;
       max_x = sx;
-      for (sy = y + 1; sy < m_height; sy++) {
-        for (sx = x; sx < max_x; sx++) {
-          if (m_tile[sy * m_width + sx] != color)
-            goto done;
-        }
+      for (sy = y + 1; sy < h; sy++) {
+        if (!isSolidRow(&tile[sy * stride + x], sw, color))
+          break;
       }
-    done:
       sh = sy - y;
 
       // Save properties of this subrect
@@ -456,8 +532,7 @@ void HextileTile<T>::analyze()
       *coordsPtr++ = (uint8_t)((x << 4) | (y & 0x0F));
       *coordsPtr++ = (uint8_t)(((sw - 1) << 4) | ((sh - 1) & 0x0F));
 
-      if (!m_pal.insert(color, 1) ||
-          ((size_t)m_pal.size() > (48 + 2 * sizeof(T)*8))) {
+      if (!addColour(color)) {
         // Handle palette overflow
         m_flags = hextileRaw;
         m_size = 0;
@@ -467,27 +542,26 @@ void HextileTile<T>::analyze()
       m_numSubrects++;
 
       // Mark pixels of this subrect as processed, below this row
-      for (sy = y + 1; sy < y + sh; sy++) {
-        for (sx = x; sx < x + sw; sx++)
-          m_processed[sy][sx] = true;
-      }
+      for (sy = y + 1; sy < y + sh; sy++)
+        m_processed[sy] |= ((1 << sw) - 1) << x;
 
       // Skip processed pixels of this row
-      x += (sw - 1);
+      x = max_x - 1;
     }
   }
 
   // Save number of colors in this tile (should be no less than 2)
-  int numColors = m_pal.size();
-  assert(numColors >= 2);
+  assert(m_numColours >= 2);
 
-  m_background = (T)m_pal.getColour(0);
   m_flags = hextileAnySubrects;
-  int numSubrects = m_numSubrects - m_pal.getCount(0);
+  int numSubrects = m_numSubrects - m_bgCount;
 
-  if (numColors == 2) {
+  if (m_numColours == 2) {
     // Monochrome tile
-    m_foreground = (T)m_pal.getColour(1);
+    if (m_palColours[0] == m_background)
+      m_foreground = m_palColours[1];
+    else
+      m_foreground = m_palColours[0];
     m_size = 1 + 2 * numSubrects;
   } else {
     // Colored tile
@@ -510,17 +584,8 @@ void HextileTile<T>::encode(uint8_t *dst) const
       continue;
 
     if (m_flags & hextileSubrectsColoured) {
-      if (sizeof(T) == 1) {
-        *dst++ = m_colors[i];
-      } else if (sizeof(T) == 2) {
-        *dst++ = ((uint8_t*)&m_colors[i])[0];
-        *dst++ = ((uint8_t*)&m_colors[i])[1];
-      } else if (sizeof(T) == 4) {
-        *dst++ = ((uint8_t*)&m_colors[i])[0];
-        *dst++ = ((uint8_t*)&m_colors[i])[1];
-        *dst++ = ((uint8_t*)&m_colors[i])[2];
-        *dst++ = ((uint8_t*)&m_colors[i])[3];
-      }
+      memcpy(dst, &m_colors[i], sizeof(T));
+      dst += sizeof(T);
     }
     *dst++ = m_coords[i * 2];
     *dst++ = m_coords[i * 2 + 1];
@@ -540,11 +605,11 @@ void HextileEncoder::hextileEncodeBetter(rdr::OutStream* os,
                                          const PixelBuffer* pb)
 {
   core::Rect t;
-  T buf[256];
+  const T* data;
+  int stride;
   T oldBg = 0, oldFg = 0;
   bool oldBgValid = false;
   bool oldFgValid = false;
-  uint8_t encoded[256*sizeof(T)];
 
   HextileTile<T> tile;
 
@@ -556,17 +621,19 @@ void HextileEncoder::hextileEncodeBetter(rdr::OutStream* os,
 
       t.br.x = std::min(pb->width(), t.tl.x + 16);
 
-      pb->getImage(buf, t);
+      data = (const T*)pb->getBuffer(t, &stride);
 
-      tile.newTile(buf, t.width(), t.height());
+      tile.analyze(data, stride, t.width(), t.height());
       int tileType = tile.getFlags();
       size_t encodedLen = tile.getSize();
 
       if ( (tileType & hextileRaw) != 0 ||
            encodedLen >= t.width() * t.height() * sizeof(T)) {
         os->writeU8(hextileRaw);
-        os->writeBytes((const uint8_t*)buf,
-                       t.width() * t.height() * sizeof(T));
+        for (int y = 0; y < t.height(); y++) {
+          os->writeBytes((const uint8_t*)&data[y * stride],
+                         t.width() * sizeof(T));
+        }
         oldBgValid = oldFgValid = false;
         continue;
       }
@@ -591,13 +658,16 @@ void HextileEncoder::hextileEncodeBetter(rdr::OutStream* os,
             oldFgValid = true;
           }
         }
-        tile.encode(encoded);
       }
 
       os->writeU8(tileType);
       if (tileType & hextileBgSpecified) writePixel(os, bg);
       if (tileType & hextileFgSpecified) writePixel(os, fg);
-      if (tileType & hextileAnySubrects) os->writeBytes(encoded, encodedLen);
+      if (tileType & hextileAnySubrects) {
+        // Encode directly in to the stream's buffer
+        tile.encode(os->getptr(encodedLen));
+        os->setptr(encodedLen);
+      }
     }
   }
 }
@@ -26,6 +26,8 @@
 
 #include <core/Rect.h>
 
+#include <rdr/BufferPool.h>
+
 #include <rfb/JpegCompressor.h>
 #include <rfb/PixelFormat.h>
 #include <rfb/ClientParams.h>
@@ -221,7 +223,10 @@ void JpegCompressor::compress(const uint8_t *buf, volatile int stride,
   int pixelsize;
   uint8_t * volatile srcBuf = nullptr;
   volatile bool srcBufIsTemp = false;
+  volatile size_t srcBufSize = 0;
   JSAMPROW * volatile rowPointer = nullptr;
+  volatile size_t rowPointerSize = 0;
+  size_t size;
 
   if (qualityLevel >= 0 && qualityLevel <= 9) {
     quality = conf[qualityLevel].quality;
@@ -240,8 +245,10 @@ void JpegCompressor::compress(const uint8_t *buf, volatile int stride,
   if(setjmp(err->jmpBuffer)) {
     // this will execute if libjpeg has an error
     jpeg_abort_compress(cinfo);
-    if (srcBufIsTemp && srcBuf) delete[] srcBuf;
-    if (rowPointer) delete[] rowPointer;
+    if (srcBufIsTemp && srcBuf)
+      rdr::BufferPool::put(srcBuf, srcBufSize);
+    if (rowPointer)
+      rdr::BufferPool::put((uint8_t*)rowPointer, rowPointerSize);
     throw std::runtime_error(err->lastError);
   }
 
@@ -272,7 +279,9 @@ void JpegCompressor::compress(const uint8_t *buf, volatile int stride,
     stride = w;
 
   if (cinfo->in_color_space == JCS_RGB) {
-    srcBuf = new uint8_t[w * h * pixelsize];
+    size = w * h * pixelsize;
+    srcBuf = rdr::BufferPool::get(&size);
+    srcBufSize = size;
     srcBufIsTemp = true;
     pf.rgbFromBuffer(srcBuf, (const uint8_t *)buf, w, stride, h);
     stride = w;
@@ -310,7 +319,9 @@ void JpegCompressor::compress(const uint8_t *buf, volatile int stride,
     cinfo->comp_info[0].v_samp_factor = 1;
   }
 
-  rowPointer = new JSAMPROW[h];
+  size = sizeof(JSAMPROW) * h;
+  rowPointer = (JSAMPROW*)rdr::BufferPool::get(&size);
+  rowPointerSize = size;
   for (int dy = 0; dy < h; dy++)
     rowPointer[dy] = (JSAMPROW)(&srcBuf[dy * stride * pixelsize]);
 
@@ -321,8 +332,9 @@ void JpegCompressor::compress(const uint8_t *buf, volatile int stride,
 
   jpeg_finish_compress(cinfo);
 
-  if (srcBufIsTemp) delete[] srcBuf;
-  delete[] rowPointer;
+  if (srcBufIsTemp)
+    rdr::BufferPool::put(srcBuf, srcBufSize);
+  rdr::BufferPool::put((uint8_t*)rowPointer, rowPointerSize);
 }
 
 void JpegCompressor::writeBytes(const uint8_t* /*data*/, int /*length*/)
@@ -0,0 +1,102 @@
+/* Copyright (C) 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+#include <sys/time.h>
+
+#include <core/LogWriter.h>
+
+#include <rfb/LatencyStats.h>
+
+using namespace rfb;
+
+LatencyStats::LatencyStats()
+{
+  reset();
+}
+
+void LatencyStats::reset()
+{
+  count = 0;
+  total = 0;
+  max = 0;
+  memset(buckets, 0, sizeof(buckets));
+}
+
+void LatencyStats::add(unsigned long long usecs)
+{
+  unsigned long long ms;
+  int bucket;
+
+  count++;
+  total += usecs;
+  if (usecs > max)
+    max = usecs;
+
+  // Bucket 0 is below 1 ms, bucket n is [2^(n-1), 2^n) ms
+  ms = usecs / 1000;
+  bucket = 0;
+  while ((ms > 0) && (bucket < bucketCount - 1)) {
+    ms >>= 1;
+    bucket++;
+  }
+
+  buckets[bucket]++;
+}
+
+void LatencyStats::addInterval(const struct timeval* first,
+                               const struct timeval* second)
+{
+  long long usecs;
+
+  usecs = (second->tv_sec - first->tv_sec) * 1000000LL;
+  usecs += second->tv_usec - first->tv_usec;
+
+  // Clock adjustments can make time go backwards
+  if (usecs < 0)
+    usecs = 0;
+
+  add(usecs);
+}
+
+void LatencyStats::logStats(core::LogWriter* log, const char* name) const
+{
+  if (count == 0)
+    return;
+
+  log->info("  %s: %u samples, average %.1f ms, maximum %.1f ms",
+            name, count, (double)total / count / 1000,
+            (double)max / 1000);
+
+  for (int i = 0; i < bucketCount; i++) {
+    if (buckets[i] == 0)
+      continue;
+
+    if (i == 0)
+      log->info("    0-1 ms: %u", buckets[i]);
+    else if (i == bucketCount - 1)
+      log->info("    %u+ ms: %u", 1U << (i - 1), buckets[i]);
+    else
+      log->info("    %u-%u ms: %u", 1U << (i - 1), (1U << i) - 1,
+                buckets[i]);
+  }
+}
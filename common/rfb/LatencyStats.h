@@ -0,0 +1,61 @@
+/* Copyright (C) 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+//
+// LatencyStats collects latency samples in a power-of-two histogram so
+// that the distribution can be logged once a connection ends.
+//
+
+#ifndef __RFB_LATENCYSTATS_H__
+#define __RFB_LATENCYSTATS_H__
+
+namespace core { class LogWriter; }
+
+struct timeval;
+
+namespace rfb {
+
+  class LatencyStats {
+  public:
+    LatencyStats();
+
+    void reset();
+
+    // add() records a single sample given in microseconds
+    void add(unsigned long long usecs);
+    // addInterval() records the time between two moments
+    void addInterval(const struct timeval* first,
+                     const struct timeval* second);
+
+    unsigned getCount() const { return count; }
+
+    // logStats() writes a summary and the histogram of all samples
+    void logStats(core::LogWriter* log, const char* name) const;
+
+  private:
+    static const int bucketCount = 12;
+
+    unsigned count;
+    unsigned long long total;
+    unsigned long long max;
+    unsigned buckets[bucketCount];
+  };
+
+}
+
+#endif
@@ -0,0 +1,203 @@
+/* Copyright (C) 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <assert.h>
+
+#include <algorithm>
+#include <list>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include <core/Configuration.h>
+#include <core/LogWriter.h>
+
+#include <rfb/Exception.h>
+#include <rfb/PasswordWorker.h>
+#include <rfb/SConnection.h>
+#include <rfb/SSecurityPlain.h>
+
+using namespace rfb;
+
+static core::LogWriter vlog("PasswordWorker");
+
+core::IntParameter PasswordWorker::maxAuthThreads
+("MaxAuthThreads",
+ "Maximum number of passwords that are checked at the same time",
+ 1, 1, 64);
+
+// How many attempts may wait in line for each thread before new
+// attempts are rejected
+static const size_t MaxQueuedPerThread = 16;
+
+// How often the main thread checks if a result is available (in ms)
+static const int PollInterval = 20;
+
+namespace rfb {
+  struct PasswordRequest {
+    std::unique_ptr<PasswordValidator> validator;
+    std::string username;
+    std::string password;
+    std::string msg;
+    bool done;
+    bool valid;
+  };
+}
+
+// Shared between the main thread and all worker threads. Never freed
+// as detached workers might still be running when the process exits.
+struct PasswordQueue {
+  std::mutex mutex;
+  std::list<std::shared_ptr<PasswordRequest>> pending;
+  int running;
+};
+
+static PasswordQueue* queue = new PasswordQueue{ {}, {}, 0 };
+
+static void wipe(std::string& str)
+{
+  std::fill(str.begin(), str.end(), '\0');
+  str.clear();
+}
+
+static void worker()
+{
+  std::unique_lock<std::mutex> lock(queue->mutex);
+
+  while (!queue->pending.empty()) {
+    std::shared_ptr<PasswordRequest> request;
+    std::string msg;
+    bool valid;
+
+    request = queue->pending.front();
+    queue->pending.pop_front();
+
+    // No point in checking if the client has already gone away
+    if (request.use_count() == 1) {
+      wipe(request->password);
+      continue;
+    }
+
+    lock.unlock();
+
+    // The connection might be gone by the time we are done, so the
+    // validator doesn't get one
+    msg = "Authentication failed";
+    try {
+      valid = request->validator->validate(nullptr,
+                                           request->username.c_str(),
+                                           request->password.c_str(),
+                                           msg);
+    } catch (std::exception& e) {
+      vlog.error("Failed to check password: %s", e.what());
+      valid = false;
+    }
+
+    lock.lock();
+
+    wipe(request->password);
+    request->msg = msg;
+    request->valid = valid;
+    request->done = true;
+  }
+
+  queue->running--;
+}
+
+PasswordWorker::PasswordWorker(SConnection* sc_)
+  : sc(sc_), pollTimer(this, &PasswordWorker::handlePollTimeout)
+{
+}
+
+PasswordWorker::~PasswordWorker()
+{
+  // Any running worker holds its own reference to the request
+}
+
+void PasswordWorker::start(PasswordValidator* validator,
+                           const char* username, const char* password)
+{
+  std::shared_ptr<PasswordRequest> newRequest;
+
+  newRequest = std::make_shared<PasswordRequest>();
+  newRequest->validator.reset(validator);
+
+  if (request)
+    throw std::logic_error("Password check already started");
+
+  newRequest->username = username;
+  newRequest->password = password;
+  newRequest->done = false;
+  newRequest->valid = false;
+
+  {
+    const std::lock_guard<std::mutex> lock(queue->mutex);
+
+    if (queue->pending.size() >= maxAuthThreads * MaxQueuedPerThread) {
+      vlog.error("Too many pending authentication attempts");
+      wipe(newRequest->password);
+      throw auth_error("Too many authentication attempts");
+    }
+
+    queue->pending.push_back(newRequest);
+
+    if (queue->running < maxAuthThreads) {
+      queue->running++;
+      std::thread(worker).detach();
+    }
+  }
+
+  request = newRequest;
+
+  pollTimer.start(PollInterval);
+}
+
+bool PasswordWorker::isDone()
+{
+  const std::lock_guard<std::mutex> lock(queue->mutex);
+
+  if (!request)
+    return false;
+
+  return request->done;
+}
+
+void PasswordWorker::checkResult()
+{
+  const std::lock_guard<std::mutex> lock(queue->mutex);
+
+  assert(request);
+  assert(request->done);
+
+  if (!request->valid)
+    throw auth_error(request->msg);
+}
+
+void PasswordWorker::handlePollTimeout(core::Timer* /*t*/)
+{
+  if (!isDone()) {
+    pollTimer.repeat();
+    return;
+  }
+
+  sc->securityReady();
+}
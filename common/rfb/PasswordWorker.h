@@ -0,0 +1,75 @@
+/* Copyright (C) 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+//
+// PasswordWorker checks a user name and password using a
+// PasswordValidator on a separate thread. Backends such as PAM with
+// LDAP can take several seconds to respond, and doing that on the
+// main thread would freeze every other client of the server.
+//
+// The number of validations running at the same time is limited, and
+// further attempts wait in line, or are rejected if too many are
+// already waiting.
+//
+
+#ifndef __RFB_PASSWORDWORKER_H__
+#define __RFB_PASSWORDWORKER_H__
+
+#include <memory>
+
+#include <core/Timer.h>
+
+namespace core { class IntParameter; }
+
+namespace rfb {
+
+  class PasswordValidator;
+  class SConnection;
+  struct PasswordRequest;
+
+  class PasswordWorker {
+  public:
+    PasswordWorker(SConnection* sc);
+    ~PasswordWorker();
+
+    // start() takes ownership of the validator and queues the
+    // credentials for validation. SConnection::securityReady() is
+    // called once the result is available.
+    void start(PasswordValidator* validator,
+               const char* username, const char* password);
+
+    // isDone() returns true once the result is available, after which
+    // checkResult() throws an auth_error if the credentials were not
+    // accepted
+    bool isDone();
+    void checkResult();
+
+    static core::IntParameter maxAuthThreads;
+
+  private:
+    void handlePollTimeout(core::Timer* t);
+
+  private:
+    SConnection* sc;
+    std::shared_ptr<PasswordRequest> request;
+    core::MethodTimer<PasswordWorker> pollTimer;
+  };
+
+}
+
+#endif
@@ -21,6 +21,8 @@
 #include <config.h>
 #endif
 
+#include <string.h>
+
 #include <rdr/OutStream.h>
 #include <rfb/encodings.h>
 #include <rfb/SConnection.h>
@@ -71,12 +73,21 @@ void RawEncoder::writeSolidRect(int width, int height,
                                 const uint8_t* colour)
 {
   rdr::OutStream* os;
-  int pixels, pixel_size;
+  int pixel_size;
 
   os = conn->getOutStream();
 
-  pixels = width*height;
   pixel_size = pf.bpp/8;
-  while (pixels--)
-    os->writeBytes(colour, pixel_size);
+
+  // Fill in a row at a time directly in the output buffer
+  while (height--) {
+    uint8_t* out;
+
+    out = os->reserve(width*pixel_size);
+    for (int x = 0;x < width;x++) {
+      memcpy(out, colour, pixel_size);
+      out += pixel_size;
+    }
+    os->commit(out);
+  }
 }
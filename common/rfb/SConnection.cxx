@@ -21,6 +21,7 @@
 #include <config.h>
 #endif
 
+#include <assert.h>
 #include <stdio.h>
 #include <string.h>
 
@@ -29,7 +30,9 @@
 #include <core/LogWriter.h>
 #include <core/string.h>
 
+#include <rdr/MemOutStream.h>
 #include <rdr/OutStream.h>
+#include <rdr/ZlibOutStream.h>
 
 #include <rfb/Exception.h>
 #include <rfb/Security.h>
@@ -48,6 +51,10 @@ using namespace rfb;
 
 static core::LogWriter vlog("SConnection");
 
+// Clipboard data larger than this is compressed over several steps,
+// each step handling this much
+static const size_t ClipboardChunkSize = 256 * 1024;
+
 SConnection::SConnection(AccessRights accessRights_)
   : readyForSetColourMapEntries(false), is(nullptr), os(nullptr),
     reader_(nullptr), writer_(nullptr), ssecurity(nullptr),
@@ -55,7 +62,9 @@ SConnection::SConnection(AccessRights accessRights_)
     state_(RFBSTATE_UNINITIALISED), preferredEncoding(encodingRaw),
     accessRights(accessRights_), hasRemoteClipboard(false),
     hasLocalClipboard(false),
-    unsolicitedClipboardAttempt(false)
+    unsolicitedClipboardAttempt(false), pendingClipboardOffset(0),
+    pendingClipboardWritten(0), pendingClipboardBuffer(nullptr),
+    pendingClipboardZlib(nullptr)
 {
   defaultMajorVersion = 3;
   defaultMinorVersion = 8;
@@ -260,6 +269,19 @@ bool SConnection::processSecurityMsg()
   return false;
 }
 
+void SConnection::securityReady()
+{
+  // The client might have given up while we were waiting
+  if (state_ != RFBSTATE_SECURITY)
+    return;
+
+  try {
+    processSecurityMsg();
+  } catch (std::exception& e) {
+    close(e.what());
+  }
+}
+
 bool SConnection::processSecurityFailure()
 {
   // Silently drop any data if we are currently delaying an
@@ -672,6 +694,9 @@ void SConnection::announceClipboard(bool available)
   hasLocalClipboard = available;
   unsolicitedClipboardAttempt = false;
 
+  // Anything we were about to send is now stale
+  abortPendingClipboard();
+
   if (client.supportsEncoding(pseudoEncodingExtendedClipboard)) {
     // Attempt an unsolicited transfer?
     if (available &&
@@ -715,14 +740,134 @@ void SConnection::sendClipboardData(const char* data)
       }
     }
 
-    writer()->writeClipboardProvide(rfb::clipboardUTF8, sizes, datas);
+    abortPendingClipboard();
+
+    if (sizes[0] <= ClipboardChunkSize) {
+      writer()->writeClipboardProvide(rfb::clipboardUTF8, sizes, datas);
+      return;
+    }
+
+    vlog.debug("Preparing large clipboard transfer (%d bytes)",
+               (int)sizes[0]);
+
+    // Include the terminating null, as for the normal transfer
+    pendingClipboard = std::move(filtered);
+    pendingClipboard.push_back('\0');
+    pendingClipboardOffset = 0;
+
+    pendingClipboardBuffer = new rdr::MemOutStream();
+    pendingClipboardZlib = new rdr::ZlibOutStream();
+    pendingClipboardZlib->setUnderlying(pendingClipboardBuffer);
+    pendingClipboardZlib->writeU32(pendingClipboard.size());
   } else {
     writer()->writeServerCutText(data);
   }
 }
 
+bool SConnection::compressClipboard()
+{
+  size_t len;
+
+  assert(isClipboardPending());
+
+  // Already done, but not yet written?
+  if (pendingClipboardZlib == nullptr)
+    return true;
+
+  len = pendingClipboard.size() - pendingClipboardOffset;
+  if (len > ClipboardChunkSize)
+    len = ClipboardChunkSize;
+
+  pendingClipboardZlib->writeBytes((const uint8_t*)pendingClipboard.data() +
+                                   pendingClipboardOffset, len);
+  pendingClipboardOffset += len;
+
+  if (pendingClipboardOffset < pendingClipboard.size())
+    return false;
+
+  pendingClipboardZlib->flush();
+
+  // Only the compressed data is needed from now on
+  pendingClipboardZlib->setUnderlying(nullptr);
+  delete pendingClipboardZlib;
+  pendingClipboardZlib = nullptr;
+
+  pendingClipboard.clear();
+  pendingClipboard.shrink_to_fit();
+
+  return true;
+}
+
+bool SConnection::writeClipboard()
+{
+  size_t len;
+
+  assert(isClipboardPending());
+  assert(pendingClipboardZlib == nullptr);
+
+  if (pendingClipboardWritten == 0) {
+    // The client might have lost interest since we started
+    if (!client.supportsEncoding(pseudoEncodingExtendedClipboard) ||
+        !(client.clipboardFlags() & rfb::clipboardProvide)) {
+      clearPendingClipboard();
+      return true;
+    }
+
+    writer()->writeClipboardProvideStart(rfb::clipboardUTF8,
+                                         pendingClipboardBuffer->length());
+  }
+
+  len = pendingClipboardBuffer->length() - pendingClipboardWritten;
+  if (len > ClipboardChunkSize)
+    len = ClipboardChunkSize;
+
+  writer()->writeClipboardProvideData(pendingClipboardBuffer->data() +
+                                      pendingClipboardWritten, len);
+  pendingClipboardWritten += len;
+
+  if (pendingClipboardWritten < pendingClipboardBuffer->length())
+    return false;
+
+  clearPendingClipboard();
+
+  return true;
+}
+
+void SConnection::abortPendingClipboard()
+{
+  size_t len;
+
+  // A message that has been started can't be taken back, so the rest
+  // of it has to go out before anything else can
+  if (pendingClipboardWritten > 0) {
+    len = pendingClipboardBuffer->length() - pendingClipboardWritten;
+    writer()->writeClipboardProvideData(pendingClipboardBuffer->data() +
+                                        pendingClipboardWritten, len);
+  }
+
+  clearPendingClipboard();
+}
+
+void SConnection::clearPendingClipboard()
+{
+  if (pendingClipboardZlib != nullptr) {
+    pendingClipboardZlib->setUnderlying(nullptr);
+    delete pendingClipboardZlib;
+  }
+  pendingClipboardZlib = nullptr;
+  delete pendingClipboardBuffer;
+  pendingClipboardBuffer = nullptr;
+
+  pendingClipboard.clear();
+  pendingClipboard.shrink_to_fit();
+  pendingClipboardOffset = 0;
+  pendingClipboardWritten = 0;
+}
+
 void SConnection::cleanup()
 {
+  clearPendingClipboard();
+
   delete ssecurity;
   ssecurity = nullptr;
   delete reader_;
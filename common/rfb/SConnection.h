@@ -35,6 +35,8 @@
 namespace rdr {
   class InStream;
   class OutStream;
+  class MemOutStream;
+  class ZlibOutStream;
 }
 
 namespace rfb {
@@ -80,6 +82,11 @@ namespace rfb {
     // appropriately by the caller.
     void approveConnection(bool accept, const char* reason=nullptr);
 
+    // securityReady() is called by the security handler when it has
+    // finished some work in the background, e.g. checking a password,
+    // so that the security handshake can continue
+    void securityReady();
+
     // desktopReady() is called when the desktop has finished
     // initializing and is ready for a client.
     virtual void desktopReady();
@@ -103,9 +110,19 @@ namespace rfb {
 
     // sendClipboardData() transfers the clipboard data to the client
     // and should be called whenever the client has requested the
-    // clipboard via handleClipboardRequest().
+    // clipboard via handleClipboardRequest(). Large amounts of data
+    // are only prepared for sending, see compressClipboard().
     virtual void sendClipboardData(const char* data);
 
+    // Large clipboard transfers are compressed and sent a bit at a time
+    // so that other traffic isn't stalled. While isClipboardPending()
+    // returns true, compressClipboard() should be called repeatedly
+    // until it returns true, after which writeClipboard() should be
+    // called repeatedly until it also returns true.
+    bool isClipboardPending() const { return pendingClipboardBuffer != nullptr; }
+    bool compressClipboard();
+    bool writeClipboard();
+
     // getAccessRights() returns the access rights of a SConnection to the server.
     AccessRights getAccessRights() { return accessRights; }
 
@@ -259,6 +276,8 @@ namespace rfb {
   private:
     void cleanup();
     void writeFakeColourMap(void);
+    void abortPendingClipboard();
+    void clearPendingClipboard();
 
     bool readyForSetColourMapEntries;
 
@@ -293,6 +312,12 @@ namespace rfb {
     bool hasRemoteClipboard;
     bool hasLocalClipboard;
     bool unsolicitedClipboardAttempt;
+
+    std::string pendingClipboard;
+    size_t pendingClipboardOffset;
+    size_t pendingClipboardWritten;
+    rdr::MemOutStream* pendingClipboardBuffer;
+    rdr::ZlibOutStream* pendingClipboardZlib;
   };
 }
 #endif
@@ -30,11 +30,11 @@
 #include <core/string.h>
 
 #include <rdr/InStream.h>
-#include <rdr/ZlibInStream.h>
 
 #include <rfb/msgTypes.h>
 #include <rfb/qemuTypes.h>
 #include <rfb/clipboardTypes.h>
+#include <rfb/ClipboardInflater.h>
 #include <rfb/Exception.h>
 #include <rfb/PixelFormat.h>
 #include <rfb/ScreenSet.h>
@@ -51,12 +51,13 @@ static core::IntParameter maxCutText("MaxCutText",
                                      256*1024, 0, INT_MAX);
 
 SMsgReader::SMsgReader(SMsgHandler* handler_, rdr::InStream* is_)
-  : handler(handler_), is(is_), state(MSGSTATE_IDLE)
+  : handler(handler_), is(is_), state(MSGSTATE_IDLE), clipboard(nullptr)
 {
 }
 
 SMsgReader::~SMsgReader()
 {
+  delete clipboard;
 }
 
 bool SMsgReader::readClientInit()
@@ -311,6 +312,9 @@ bool SMsgReader::readPointerEvent()
 
 bool SMsgReader::readClientCutText()
 {
+  if (clipboard != nullptr)
+    return readClipboardProvide();
+
   if (!is->hasData(3 + 4))
     return false;
 
@@ -322,13 +326,7 @@ bool SMsgReader::readClientCutText()
   if (len & 0x80000000) {
     int32_t slen = len;
     slen = -slen;
-    if (readExtendedClipboard(slen)) {
-      is->clearRestorePoint();
-      return true;
-    } else {
-      is->gotoRestorePoint();
-      return false;
-    }
+    return readExtendedClipboard(slen);
   }
 
   if (!is->hasDataOrRestore(len))
@@ -357,20 +355,39 @@ bool SMsgReader::readExtendedClipboard(int32_t len)
   uint32_t flags;
   uint32_t action;
 
-  if (!is->hasData(len))
-    return false;
-
   if (len < 4)
     throw protocol_error("Invalid extended clipboard message");
+
+  if (!is->hasDataOrRestore(4))
+    return false;
+
+  flags = is->readU32();
+  action = flags & clipboardActionMask;
+
+  // The data can be large, so it is decompressed as it arrives rather
+  // than waiting for the whole message
+  if (action == clipboardProvide) {
+    is->clearRestorePoint();
+    clipboard = new ClipboardInflater(is, flags, len - 4,
+                                      (size_t)maxCutText);
+    // Don't spend time decompressing something we won't keep
+    if (len > maxCutText) {
+      vlog.error("Extended clipboard message too long (%d bytes) - ignoring", len);
+      clipboard->skip();
+    }
+    return readClipboardProvide();
+  }
+
+  if (!is->hasDataOrRestore(len - 4))
+    return false;
+  is->clearRestorePoint();
+
   if (len > maxCutText) {
     vlog.error("Extended clipboard message too long (%d bytes) - ignoring", len);
-    is->skip(len);
+    is->skip(len - 4);
     return true;
   }
 
-  flags = is->readU32();
-  action = flags & clipboardActionMask;
-
   if (action & clipboardCaps) {
     int i;
     size_t num;
@@ -392,69 +409,6 @@ bool SMsgReader::readExtendedClipboard(int32_t len)
     }
 
     handler->handleClipboardCaps(flags, lengths);
-  } else if (action == clipboardProvide) {
-    rdr::ZlibInStream zis;
-
-    int i;
-    size_t num;
-    size_t lengths[16];
-    uint8_t* buffers[16];
-
-    zis.setUnderlying(is, len - 4);
-
-    num = 0;
-    for (i = 0;i < 16;i++) {
-      if (!(flags & 1 << i))
-        continue;
-
-      if (!zis.hasData(4))
-        throw protocol_error("Extended clipboard decode error");
-
-      lengths[num] = zis.readU32();
-
-      if (lengths[num] > (size_t)maxCutText) {
-        vlog.error("Extended clipboard data too long (%d bytes) - ignoring",
-                   (unsigned)lengths[num]);
-
-        // Slowly (safely) drain away the data
-        while (lengths[num] > 0) {
-          size_t chunk;
-
-          if (!zis.hasData(1))
-            throw protocol_error("Extended clipboard decode error");
-
-          chunk = zis.avail();
-          if (chunk > lengths[num])
-            chunk = lengths[num];
-
-          zis.skip(chunk);
-          lengths[num] -= chunk;
-        }
-
-        flags &= ~(1 << i);
-
-        continue;
-      }
-
-      if (!zis.hasData(lengths[num]))
-        throw protocol_error("Extended clipboard decode error");
-
-      buffers[num] = new uint8_t[lengths[num]];
-      zis.readBytes(buffers[num], lengths[num]);
-      num++;
-    }
-
-    zis.flushUnderlying();
-    zis.setUnderlying(nullptr, 0);
-
-    handler->handleClipboardProvide(flags, lengths, buffers);
-
-    num = 0;
-    for (i = 0;i < 16;i++) {
-      if (!(flags & 1 << i))
-        continue;
-      delete [] buffers[num++];
-    }
   } else {
     switch (action) {
     case clipboardRequest:
@@ -474,6 +428,23 @@ bool SMsgReader::readExtendedClipboard(int32_t len)
   return true;
 }
 
+bool SMsgReader::readClipboardProvide()
+{
+  if (!clipboard->read())
+    return false;
+
+  if (clipboard->getFlags() & clipboardFormatMask) {
+    handler->handleClipboardProvide(clipboard->getFlags(),
+                                    clipboard->getLengths(),
+                                    clipboard->getData());
+  }
+
+  delete clipboard;
+  clipboard = nullptr;
+
+  return true;
+}
+
 bool SMsgReader::readQEMUMessage()
 {
   int subType;
@@ -28,6 +28,7 @@ namespace rdr { class InStream; }
 
 namespace rfb {
   class SMsgHandler;
+  class ClipboardInflater;
 
   class SMsgReader {
   public:
@@ -55,6 +56,7 @@ namespace rfb {
     bool readPointerEvent();
     bool readClientCutText();
     bool readExtendedClipboard(int32_t len);
+    bool readClipboardProvide();
 
     bool readQEMUMessage();
     bool readQEMUKeyEvent();
@@ -71,6 +73,8 @@ namespace rfb {
     stateEnum state;
 
     uint8_t currentMsgType;
+
+    ClipboardInflater* clipboard;
   };
 }
 #endif
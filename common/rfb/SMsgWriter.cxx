@@ -52,12 +52,14 @@ SMsgWriter::SMsgWriter(ClientParams* client_, rdr::OutStream* os_)
     nRectsInUpdate(0), nRectsInHeader(0),
     needSetDesktopName(false), needCursor(false),
     needCursorPos(false), needLEDState(false),
-    needQEMUKeyEvent(false), needExtMouseButtonsEvent(false)
+    needQEMUKeyEvent(false), needExtMouseButtonsEvent(false),
+    clipboardOs(nullptr), clipboardLeft(0), heldBack(nullptr)
 {
 }
 
 SMsgWriter::~SMsgWriter()
 {
+  delete heldBack;
 }
 
 void SMsgWriter::writeServerInit(uint16_t width, uint16_t height,
@@ -206,11 +208,56 @@ void SMsgWriter::writeClipboardProvide(uint32_t flags,
 
   zos.flush();
 
+  writeClipboardProvideStart(flags, mos.length());
+  writeClipboardProvideData(mos.data(), mos.length());
+}
+
+void SMsgWriter::writeClipboardProvideStart(uint32_t flags, size_t len)
+{
+  if (!client->supportsEncoding(pseudoEncodingExtendedClipboard))
+    throw std::logic_error("Client does not support extended clipboard");
+  if (!(client->clipboardFlags() & clipboardProvide))
+    throw std::logic_error("Client does not support clipboard \"provide\" action");
+  if (isClipboardInProgress())
+    throw std::logic_error("Clipboard data is already being written");
+
   startMsg(msgTypeServerCutText);
   os->pad(3);
-  os->writeS32(-(4 + mos.length()));
+  os->writeS32(-(4 + len));
   os->writeU32(flags | clipboardProvide);
-  os->writeBytes(mos.data(), mos.length());
+
+  if (len == 0) {
+    endMsg();
+    return;
+  }
+
+  // The message can't be interrupted, so anything else has to wait
+  clipboardOs = os;
+  clipboardLeft = len;
+  heldBack = new rdr::MemOutStream();
+  os = heldBack;
+}
+
+void SMsgWriter::writeClipboardProvideData(const uint8_t* data, size_t len)
+{
+  if (len > clipboardLeft)
+    throw std::logic_error("Too much clipboard data");
+
+  clipboardOs->writeBytes(data, len);
+  clipboardLeft -= len;
+
+  if (clipboardLeft > 0) {
+    clipboardOs->flush();
+    return;
+  }
+
+  os = clipboardOs;
+  clipboardOs = nullptr;
+
+  os->writeBytes(heldBack->data(), heldBack->length());
+  delete heldBack;
+  heldBack = nullptr;
+
   endMsg();
 }
 
@@ -273,6 +320,7 @@ void SMsgWriter::writeCursor()
   if (!client->supportsEncoding(pseudoEncodingCursor) &&
       !client->supportsEncoding(pseudoEncodingXCursor) &&
       !client->supportsEncoding(pseudoEncodingCursorWithAlpha) &&
+      !client->supportsEncoding(pseudoEncodingCursorCache) &&
       !client->supportsEncoding(pseudoEncodingVMwareCursor))
     throw std::logic_error("Client does not support local cursor");
 
@@ -399,11 +447,7 @@ void SMsgWriter::writeFramebufferUpdateEnd()
 
   if (nRectsInHeader == 0) {
     // Send last rect. marker
-    os->writeS16(0);
-    os->writeS16(0);
-    os->writeU16(0);
-    os->writeU16(0);
-    os->writeU32(pseudoEncodingLastRect);
+    writeRectHeader(0, 0, 0, 0, pseudoEncodingLastRect);
   }
 
   endMsg();
@@ -417,16 +461,40 @@ void SMsgWriter::writeCopyRect(const core::Rect& r, int srcX, int srcY)
   endRect();
 }
 
+void SMsgWriter::writeTileCacheRect(const core::Rect& r, int op,
+                                    uint32_t id)
+{
+  startRect(r,encodingTileCache);
+  os->writeU8(op);
+  os->writeU32(id);
+  endRect();
+}
+
+void SMsgWriter::writeSharedMemoryRect(const core::Rect& r,
+                                       uint32_t offset)
+{
+  startRect(r, encodingSharedMemory);
+  os->writeU32(offset);
+  endRect();
+}
+
+void SMsgWriter::writeSharedMemoryAttachRect(uint32_t size)
+{
+  if (!client->supportsEncoding(pseudoEncodingSharedMemory))
+    throw std::logic_error("Client does not support shared memory");
+  if (++nRectsInUpdate > nRectsInHeader && nRectsInHeader)
+    throw std::logic_error("SMsgWriter::writeSharedMemoryAttachRect: nRects out of sync");
+
+  writeRectHeader(0, 0, 0, 0, pseudoEncodingSharedMemory);
+  os->writeU32(size);
+}
+
 void SMsgWriter::startRect(const core::Rect& r, int encoding)
 {
   if (++nRectsInUpdate > nRectsInHeader && nRectsInHeader)
     throw std::logic_error("SMsgWriter::startRect: nRects out of sync");
 
-  os->writeS16(r.tl.x);
-  os->writeS16(r.tl.y);
-  os->writeU16(r.width());
-  os->writeU16(r.height());
-  os->writeU32(encoding);
+  writeRectHeader(r.tl.x, r.tl.y, r.width(), r.height(), encoding);
 }
 
 void SMsgWriter::endRect()
@@ -434,6 +502,20 @@ void SMsgWriter::endRect()
   os->flush();
 }
 
+void SMsgWriter::writeRectHeader(int x, int y, int width, int height,
+                                 int32_t encoding)
+{
+  uint8_t* out;
+
+  out = os->reserve(12);
+  rdr::OutStream::putS16(out, x);
+  rdr::OutStream::putS16(out, y);
+  rdr::OutStream::putU16(out, width);
+  rdr::OutStream::putU16(out, height);
+  rdr::OutStream::putS32(out, encoding);
+  os->commit(out);
+}
+
 void SMsgWriter::startMsg(int type)
 {
   os->writeU8(type);
@@ -449,7 +531,11 @@ void SMsgWriter::writePseudoRects()
   if (needCursor) {
     const Cursor& cursor = client->cursor();
 
-    if (client->supportsEncoding(pseudoEncodingCursorWithAlpha)) {
+    if (client->supportsEncoding(pseudoEncodingCursorCache)) {
+      writeCursorCacheRect(cursor.width(), cursor.height(),
+                           cursor.hotspot().x, cursor.hotspot().y,
+                           cursor.getBuffer());
+    } else if (client->supportsEncoding(pseudoEncodingCursorWithAlpha)) {
       writeSetCursorWithAlphaRect(cursor.width(), cursor.height(),
                                   cursor.hotspot().x, cursor.hotspot().y,
                                   cursor.getBuffer());
@@ -553,11 +639,7 @@ void SMsgWriter::writeSetDesktopSizeRect(int width, int height)
   if (++nRectsInUpdate > nRectsInHeader && nRectsInHeader)
     throw std::logic_error("SMsgWriter::writeSetDesktopSizeRect: nRects out of sync");
 
-  os->writeS16(0);
-  os->writeS16(0);
-  os->writeU16(width);
-  os->writeU16(height);
-  os->writeU32(pseudoEncodingDesktopSize);
+  writeRectHeader(0, 0, width, height, pseudoEncodingDesktopSize);
 }
 
 void SMsgWriter::writeExtendedDesktopSizeRect(uint16_t reason,
@@ -573,22 +655,23 @@ void SMsgWriter::writeExtendedDesktopSizeRect(uint16_t reason,
   if (++nRectsInUpdate > nRectsInHeader && nRectsInHeader)
     throw std::logic_error("SMsgWriter::writeExtendedDesktopSizeRect: nRects out of sync");
 
-  os->writeU16(reason);
-  os->writeU16(result);
-  os->writeU16(fb_width);
-  os->writeU16(fb_height);
-  os->writeU32(pseudoEncodingExtendedDesktopSize);
+  writeRectHeader(reason, result, fb_width, fb_height,
+                  pseudoEncodingExtendedDesktopSize);
 
   os->writeU8(layout.num_screens());
   os->pad(3);
 
   for (si = layout.begin();si != layout.end();++si) {
-    os->writeU32(si->id);
-    os->writeU16(si->dimensions.tl.x);
-    os->writeU16(si->dimensions.tl.y);
-    os->writeU16(si->dimensions.width());
-    os->writeU16(si->dimensions.height());
-    os->writeU32(si->flags);
+    uint8_t* out;
+
+    out = os->reserve(16);
+    rdr::OutStream::putU32(out, si->id);
+    rdr::OutStream::putU16(out, si->dimensions.tl.x);
+    rdr::OutStream::putU16(out, si->dimensions.tl.y);
+    rdr::OutStream::putU16(out, si->dimensions.width());
+    rdr::OutStream::putU16(out, si->dimensions.height());
+    rdr::OutStream::putU32(out, si->flags);
+    os->commit(out);
   }
 }
 
@@ -599,11 +682,7 @@ void SMsgWriter::writeSetDesktopNameRect(const char *name)
   if (++nRectsInUpdate > nRectsInHeader && nRectsInHeader)
     throw std::logic_error("SMsgWriter::writeSetDesktopNameRect: nRects out of sync");
 
-  os->writeS16(0);
-  os->writeS16(0);
-  os->writeU16(0);
-  os->writeU16(0);
-  os->writeU32(pseudoEncodingDesktopName);
+  writeRectHeader(0, 0, 0, 0, pseudoEncodingDesktopName);
   os->writeU32(strlen(name));
   os->writeBytes((const uint8_t*)name, strlen(name));
 }
@@ -618,11 +697,7 @@ void SMsgWriter::writeSetCursorRect(int width, int height,
   if (++nRectsInUpdate > nRectsInHeader && nRectsInHeader)
     throw std::logic_error("SMsgWriter::writeSetCursorRect: nRects out of sync");
 
-  os->writeS16(hotspotX);
-  os->writeS16(hotspotY);
-  os->writeU16(width);
-  os->writeU16(height);
-  os->writeU32(pseudoEncodingCursor);
+  writeRectHeader(hotspotX, hotspotY, width, height, pseudoEncodingCursor);
   os->writeBytes(data, width * height * (client->pf().bpp/8));
   os->writeBytes(mask, (width+7)/8 * height);
 }
@@ -637,18 +712,11 @@ void SMsgWriter::writeSetXCursorRect(int width, int height,
   if (++nRectsInUpdate > nRectsInHeader && nRectsInHeader)
     throw std::logic_error("SMsgWriter::writeSetXCursorRect: nRects out of sync");
 
-  os->writeS16(hotspotX);
-  os->writeS16(hotspotY);
-  os->writeU16(width);
-  os->writeU16(height);
-  os->writeU32(pseudoEncodingXCursor);
+  writeRectHeader(hotspotX, hotspotY, width, height, pseudoEncodingXCursor);
   if (width * height > 0) {
-    os->writeU8(255);
-    os->writeU8(255);
-    os->writeU8(255);
-    os->writeU8(0);
-    os->writeU8(0);
-    os->writeU8(0);
+    // Foreground (white) and background (black) colour
+    static const uint8_t colours[6] = { 255, 255, 255, 0, 0, 0 };
+    os->writeBytes(colours, sizeof(colours));
     os->writeBytes(data, (width+7)/8 * height);
     os->writeBytes(mask, (width+7)/8 * height);
   }
@@ -663,25 +731,65 @@ void SMsgWriter::writeSetCursorWithAlphaRect(int width, int height,
   if (++nRectsInUpdate > nRectsInHeader && nRectsInHeader)
     throw std::logic_error("SMsgWriter::writeSetCursorWithAlphaRect: nRects out of sync");
 
-  os->writeS16(hotspotX);
-  os->writeS16(hotspotY);
-  os->writeU16(width);
-  os->writeU16(height);
-  os->writeU32(pseudoEncodingCursorWithAlpha);
+  writeRectHeader(hotspotX, hotspotY, width, height,
+                  pseudoEncodingCursorWithAlpha);
 
   // FIXME: Use an encoder with compression?
   os->writeU32(encodingRaw);
 
   // Alpha needs to be pre-multiplied
-  for (int i = 0;i < width*height;i++) {
-    os->writeU8((unsigned)data[0] * data[3] / 255);
-    os->writeU8((unsigned)data[1] * data[3] / 255);
-    os->writeU8((unsigned)data[2] * data[3] / 255);
-    os->writeU8(data[3]);
-    data += 4;
+  for (int y = 0;y < height;y++) {
+    uint8_t* out;
+
+    out = os->reserve(width*4);
+    for (int x = 0;x < width;x++) {
+      *out++ = (unsigned)data[0] * data[3] / 255;
+      *out++ = (unsigned)data[1] * data[3] / 255;
+      *out++ = (unsigned)data[2] * data[3] / 255;
+      *out++ = data[3];
+      data += 4;
+    }
+    os->commit(out);
   }
 }
 
+void SMsgWriter::writeCursorCacheRect(int width, int height,
+                                      int hotspotX, int hotspotY,
+                                      const uint8_t* data)
+{
+  rdr::MemOutStream mos;
+  rdr::ZlibOutStream zos;
+
+  uint32_t id;
+
+  if (!client->supportsEncoding(pseudoEncodingCursorCache))
+    throw std::logic_error("Client does not support cursor cache");
+  if (++nRectsInUpdate > nRectsInHeader && nRectsInHeader)
+    throw std::logic_error("SMsgWriter::writeCursorCacheRect: nRects out of sync");
+
+  writeRectHeader(hotspotX, hotspotY, width, height,
+                  pseudoEncodingCursorCache);
+
+  if (cursorCache.lookup(width, height, data, &id)) {
+    os->writeU8(cursorCacheUse);
+    os->writeU32(id);
+    return;
+  }
+
+  id = cursorCache.add(width, height, data);
+
+  // Unlike CursorWithAlpha, the alpha is not pre-multiplied as there is
+  // no need to fit a normal encoding
+  zos.setUnderlying(&mos);
+  zos.writeBytes(data, width * height * 4);
+  zos.flush();
+
+  os->writeU8(cursorCacheStore);
+  os->writeU32(id);
+  os->writeU32(mos.length());
+  os->writeBytes(mos.data(), mos.length());
+}
+
 void SMsgWriter::writeSetVMwareCursorRect(int width, int height,
                                           int hotspotX, int hotspotY,
                                           const uint8_t* data)
@@ -691,11 +799,8 @@ void SMsgWriter::writeSetVMwareCursorRect(int width, int height,
   if (++nRectsInUpdate > nRectsInHeader && nRectsInHeader)
     throw std::logic_error("SMsgWriter::writeSetVMwareCursorRect: nRects out of sync");
 
-  os->writeS16(hotspotX);
-  os->writeS16(hotspotY);
-  os->writeU16(width);
-  os->writeU16(height);
-  os->writeU32(pseudoEncodingVMwareCursor);
+  writeRectHeader(hotspotX, hotspotY, width, height,
+                  pseudoEncodingVMwareCursor);
 
   os->writeU8(1); // Alpha cursor
   os->pad(1);
@@ -711,11 +816,8 @@ void SMsgWriter::writeSetVMwareCursorPositionRect(int hotspotX, int hotspotY)
   if (++nRectsInUpdate > nRectsInHeader && nRectsInHeader)
     throw std::logic_error("SMsgWriter::writeSetVMwareCursorRect: nRects out of sync");
 
-  os->writeS16(hotspotX);
-  os->writeS16(hotspotY);
-  os->writeU16(0);
-  os->writeU16(0);
-  os->writeU32(pseudoEncodingVMwareCursorPosition);
+  writeRectHeader(hotspotX, hotspotY, 0, 0,
+                  pseudoEncodingVMwareCursorPosition);
 }
 
 void SMsgWriter::writeLEDStateRect(uint8_t state)
@@ -728,15 +830,11 @@ void SMsgWriter::writeLEDStateRect(uint8_t state)
   if (++nRectsInUpdate > nRectsInHeader && nRectsInHeader)
     throw std::logic_error("SMsgWriter::writeLEDStateRect: nRects out of sync");
 
-  os->writeS16(0);
-  os->writeS16(0);
-  os->writeU16(0);
-  os->writeU16(0);
   if (client->supportsEncoding(pseudoEncodingLEDState)) {
-    os->writeU32(pseudoEncodingLEDState);
+    writeRectHeader(0, 0, 0, 0, pseudoEncodingLEDState);
     os->writeU8(state);
   } else {
-    os->writeU32(pseudoEncodingVMwareLEDState);
+    writeRectHeader(0, 0, 0, 0, pseudoEncodingVMwareLEDState);
     os->writeU32(state);
   }
 }
@@ -748,11 +846,7 @@ void SMsgWriter::writeQEMUKeyEventRect()
   if (++nRectsInUpdate > nRectsInHeader && nRectsInHeader)
     throw std::logic_error("SMsgWriter::writeQEMUKeyEventRect: nRects out of sync");
 
-  os->writeS16(0);
-  os->writeS16(0);
-  os->writeU16(0);
-  os->writeU16(0);
-  os->writeU32(pseudoEncodingQEMUKeyEvent);
+  writeRectHeader(0, 0, 0, 0, pseudoEncodingQEMUKeyEvent);
 }
 
 void SMsgWriter::writeExtendedMouseButtonsRect()
@@ -762,9 +856,5 @@ void SMsgWriter::writeExtendedMouseButtonsRect()
   if (++nRectsInUpdate > nRectsInHeader && nRectsInHeader)
     throw std::logic_error("SMsgWriter::writeExtendedMouseButtonsRect: nRects out of sync");
 
-  os->writeS16(0);
-  os->writeS16(0);
-  os->writeU16(0);
-  os->writeU16(0);
-  os->writeU32(pseudoEncodingExtendedMouseButtons);
+  writeRectHeader(0, 0, 0, 0, pseudoEncodingExtendedMouseButtons);
 }
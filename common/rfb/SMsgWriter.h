@@ -25,9 +25,14 @@
 
 #include <stdint.h>
 
+#include <rfb/CursorCache.h>
+
 namespace core { struct Rect; }
 
-namespace rdr { class OutStream; }
+namespace rdr {
+  class OutStream;
+  class MemOutStream;
+}
 
 namespace rfb {
 
@@ -66,6 +71,15 @@ namespace rfb {
     void writeClipboardProvide(uint32_t flags, const size_t* lengths,
                                const uint8_t* const* data);
 
+    // writeClipboardProvideStart() is like writeClipboardProvide() but
+    // for data that has already been compressed by the caller. The data
+    // is then given to writeClipboardProvideData(), in as many pieces
+    // as the caller likes. Other messages written before all of it has
+    // been sent are held back until the clipboard message is complete.
+    void writeClipboardProvideStart(uint32_t flags, size_t len);
+    void writeClipboardProvideData(const uint8_t* data, size_t len);
+    bool isClipboardInProgress() const { return clipboardLeft > 0; }
+
     // writeFence() sends a new fence request or response to the client.
     void writeFence(uint32_t flags, unsigned len, const uint8_t data[]);
 
@@ -118,6 +132,15 @@ namespace rfb {
     // There is no explicit encoder for CopyRect rects.
     void writeCopyRect(const core::Rect& r, int srcX, int srcY);
 
+    // Nor for the tile cache, which is handled by EncodeManager
+    void writeTileCacheRect(const core::Rect& r, int op, uint32_t id);
+
+    // Or for shared memory, where the pixels are at the given offset.
+    // The buffer itself is announced with an attach rect, which must
+    // come after its file descriptor has been passed.
+    void writeSharedMemoryRect(const core::Rect& r, uint32_t offset);
+    void writeSharedMemoryAttachRect(uint32_t size);
+
     // Encoders should call these to mark the start and stop of individual
     // rects.
     void startRect(const core::Rect& r, int enc);
@@ -127,6 +150,10 @@ namespace rfb {
     void startMsg(int type);
     void endMsg();
 
+    // Writes the common header of all rects in a single step
+    void writeRectHeader(int x, int y, int width, int height,
+                         int32_t encoding);
+
     void writePseudoRects();
     void writeNoDataRects();
 
@@ -144,6 +171,9 @@ namespace rfb {
     void writeSetCursorWithAlphaRect(int width, int height,
                                      int hotspotX, int hotspotY,
                                      const uint8_t* data);
+    void writeCursorCacheRect(int width, int height,
+                              int hotspotX, int hotspotY,
+                              const uint8_t* data);
     void writeSetVMwareCursorRect(int width, int height,
                                   int hotspotX, int hotspotY,
                                   const uint8_t* data);
@@ -170,6 +200,12 @@ namespace rfb {
     } ExtendedDesktopSizeMsg;
 
     std::list<ExtendedDesktopSizeMsg> extendedDesktopSizeMsgs;
+
+    CursorCache cursorCache;
+
+    rdr::OutStream* clipboardOs;
+    size_t clipboardLeft;
+    rdr::MemOutStream* heldBack;
   };
 }
 #endif
@@ -21,6 +21,8 @@
 #include <config.h>
 #endif
 
+#include <vector>
+
 #include <core/Configuration.h>
 #include <core/string.h>
 
@@ -55,8 +57,19 @@ bool PasswordValidator::validUser(const char* username)
       return true;
 #if !defined(WIN32) && !defined(__APPLE__)
     if (strcmp(user, "%u") == 0) {
-      struct passwd *pw = getpwnam(username);
-      if (pw && pw->pw_uid == getuid())
+      // Passwords are checked on other threads, so we can't use the
+      // static buffer of getpwnam()
+      struct passwd pwbuf, *pw;
+      std::vector<char> buf;
+      long size;
+
+      size = sysconf(_SC_GETPW_R_SIZE_MAX);
+      if (size <= 0)
+        size = 16384;
+      buf.resize(size);
+
+      if ((getpwnam_r(username, &pwbuf, buf.data(), buf.size(),
+                      &pw) == 0) && pw && (pw->pw_uid == getuid()))
         return true;
     }
 #endif
@@ -68,7 +81,8 @@ bool PasswordValidator::validUser(const char* username)
   return false;
 }
 
-SSecurityPlain::SSecurityPlain(SConnection* sc_) : SSecurity(sc_)
+SSecurityPlain::SSecurityPlain(SConnection* sc_)
+  : SSecurity(sc_), worker(sc_)
 {
 #ifdef WIN32
   valid = new WinPasswdValidator();
@@ -81,15 +95,21 @@ SSecurityPlain::SSecurityPlain(SConnection* sc_) : SSecurity(sc_)
   state = 0;
 }
 
+SSecurityPlain::~SSecurityPlain()
+{
+  delete valid;
+}
+
 bool SSecurityPlain::processMsg()
 {
   rdr::InStream* is = sc->getInStream();
+  PasswordValidator* validator;
   char password[1024];
 
-  if (!valid)
-    throw std::logic_error("No password validator configured");
-
   if (state == 0) {
+    if (!valid)
+      throw std::logic_error("No password validator configured");
+
     if (!is->hasData(8))
       return false;
 
@@ -113,9 +133,23 @@ bool SSecurityPlain::processMsg()
     password[plen] = 0;
     username[ulen] = 0;
     plen = 0;
-    std::string msg = "Authentication failed";
-    if (!valid->validate(sc, username, password, msg))
-      throw auth_error(msg);
+
+    // The worker owns the validator from now on
+    validator = valid;
+    valid = nullptr;
+    try {
+      worker.start(validator, username, password);
+    } catch (std::exception&) {
+      memset(password, 0, sizeof(password));
+      throw;
+    }
+    memset(password, 0, sizeof(password));
+  }
+
+  if (state == 2) {
+    if (!worker.isDone())
+      return false;
+    worker.checkResult();
   }
 
   return true;
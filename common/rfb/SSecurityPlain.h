@@ -20,6 +20,7 @@
 #ifndef __RFB_SSECURITYPLAIN_H__
 #define __RFB_SSECURITYPLAIN_H__
 
+#include <rfb/PasswordWorker.h>
 #include <rfb/Security.h>
 #include <rfb/SSecurity.h>
 
@@ -53,10 +54,11 @@ namespace rfb {
     int getType() const override { return secTypePlain; };
     const char* getUserName() const override { return username; }
 
-    virtual ~SSecurityPlain() { }
+    virtual ~SSecurityPlain();
 
   private:
     PasswordValidator* valid;
+    PasswordWorker worker;
     unsigned int ulen, plen, state;
     char username[1024];
   };
@@ -27,8 +27,11 @@
 #include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
+#include <sys/stat.h>
 
+#include <string>
 #include <vector>
 
 #include <nettle/bignum.h>
@@ -61,6 +64,7 @@ enum {
   ReadRandom,
   ReadHash,
   ReadCredentials,
+  VerifyCredentials,
 };
 
 const int MinKeyLength = 1024;
@@ -78,6 +82,50 @@ core::BoolParameter SSecurityRSAAES::requireUsername
 
 static core::LogWriter vlog("SSecurityRSAAES");
 
+// Reading and parsing the key file is done once, and then only again
+// if the file changes
+struct CachedKey {
+  std::string path;
+  dev_t dev;
+  ino_t ino;
+  off_t size;
+  time_t mtime;
+  long mtimeNsec;
+
+  struct rsa_private_key key;
+  uint32_t length;
+  std::vector<uint8_t> n;
+  std::vector<uint8_t> e;
+};
+
+static CachedKey* cachedKey = nullptr;
+
+// A file can be rewritten many times within a second, so the
+// sub-second part of the modification time is also needed
+static long getMtimeNsec(const struct stat* st)
+{
+#if defined(__APPLE__)
+  return st->st_mtimespec.tv_nsec;
+#elif defined(WIN32)
+  (void)st;
+  return 0;
+#else
+  return st->st_mtim.tv_nsec;
+#endif
+}
+
+static void copyPrivateKey(struct rsa_private_key* dst,
+                           const struct rsa_private_key* src)
+{
+  dst->size = src->size;
+  mpz_set(dst->d, src->d);
+  mpz_set(dst->p, src->p);
+  mpz_set(dst->q, src->q);
+  mpz_set(dst->a, src->a);
+  mpz_set(dst->b, src->b);
+  mpz_set(dst->c, src->c);
+}
+
 SSecurityRSAAES::SSecurityRSAAES(SConnection* sc_, uint32_t _secType,
                                  int _keySize, bool _isAllEncrypted)
   : SSecurity(sc_), state(SendPublicKey),
@@ -85,7 +133,7 @@ SSecurityRSAAES::SSecurityRSAAES(SConnection* sc_, uint32_t _secType,
     serverKey(), clientKey(),
     serverKeyN(nullptr), serverKeyE(nullptr),
     clientKeyN(nullptr), clientKeyE(nullptr),
-    accessRights(AccessDefault),
+    accessRights(AccessDefault), worker(sc_),
     rais(nullptr), raos(nullptr), rawis(nullptr), rawos(nullptr)
 {
   assert(keySize == 128 || keySize == 256);
@@ -174,9 +222,59 @@ static bool loadPEM(uint8_t* data, size_t size, const char *begin,
 
 void SSecurityRSAAES::loadPrivateKey()
 {
-  FILE* file = fopen(keyFile, "rb");
+  FILE* file;
+  struct stat st;
+
+  file = fopen(keyFile, "rb");
   if (!file)
     throw core::posix_error("Failed to open key file", errno);
+
+  // Check the file we actually opened, in case it is being replaced
+  if (fstat(fileno(file), &st) != 0) {
+    int err = errno;
+    fclose(file);
+    throw core::posix_error("Failed to open key file", err);
+  }
+
+  if ((cachedKey != nullptr) && (cachedKey->path == (const char*)keyFile) &&
+      (cachedKey->dev == st.st_dev) && (cachedKey->ino == st.st_ino) &&
+      (cachedKey->size == st.st_size) && (cachedKey->mtime == st.st_mtime) &&
+      (cachedKey->mtimeNsec == getMtimeNsec(&st))) {
+    fclose(file);
+    rsa_private_key_init(&serverKey);
+    copyPrivateKey(&serverKey, &cachedKey->key);
+    serverKeyLength = cachedKey->length;
+    serverKeyN = new uint8_t[serverKey.size];
+    serverKeyE = new uint8_t[serverKey.size];
+    memcpy(serverKeyN, cachedKey->n.data(), serverKey.size);
+    memcpy(serverKeyE, cachedKey->e.data(), serverKey.size);
+    return;
+  }
+
+  readPrivateKey(file);
+
+  if (cachedKey == nullptr) {
+    cachedKey = new CachedKey;
+    rsa_private_key_init(&cachedKey->key);
+  } else {
+    vlog.info("Key file has changed, reloading");
+  }
+
+  cachedKey->path = (const char*)keyFile;
+  cachedKey->dev = st.st_dev;
+  cachedKey->ino = st.st_ino;
+  cachedKey->size = st.st_size;
+  cachedKey->mtime = st.st_mtime;
+  cachedKey->mtimeNsec = getMtimeNsec(&st);
+
+  copyPrivateKey(&cachedKey->key, &serverKey);
+  cachedKey->length = serverKeyLength;
+  cachedKey->n.assign(serverKeyN, serverKeyN + serverKey.size);
+  cachedKey->e.assign(serverKeyE, serverKeyE + serverKey.size);
+}
+
+void SSecurityRSAAES::readPrivateKey(FILE* file)
+{
   fseek(file, 0, SEEK_END);
   size_t size = ftell(file);
   if (size == 0 || size > MaxKeyFileSize) {
@@ -289,10 +387,17 @@ bool SSecurityRSAAES::processMsg()
     case ReadCredentials:
       if (!readCredentials())
         return false;
-      if (requireUsername)
-        verifyUserPass();
-      else
+      if (!requireUsername) {
         verifyPass();
+        return true;
+      }
+      verifyUserPass();
+      state = VerifyCredentials;
+      /* fall through */
+    case VerifyCredentials:
+      if (!worker.isDone())
+        return false;
+      worker.checkResult();
       return true;
   }
 
@@ -583,12 +688,9 @@ void SSecurityRSAAES::verifyUserPass()
 #elif !defined(__APPLE__)
   UnixPasswordValidator *valid = new UnixPasswordValidator();
 #endif
-  std::string msg = "Authentication failed";
-  if (!valid->validate(sc, username, password, msg)) {
-    delete valid;
-    throw auth_error(msg);
-  }
-  delete valid;
+  // The result is picked up in processMsg() once it is available
+  worker.start(valid, username, password);
+  memset(password, 0, sizeof(password));
 #else
   throw std::logic_error("No password validator configured");
 #endif
@@ -23,8 +23,11 @@
 #error "This header should not be included without HAVE_NETTLE defined"
 #endif
 
+#include <stdio.h>
+
 #include <nettle/rsa.h>
 
+#include <rfb/PasswordWorker.h>
 #include <rfb/SSecurity.h>
 
 namespace core {
@@ -60,6 +63,7 @@ namespace rfb {
   private:
     void cleanup();
     void loadPrivateKey();
+    void readPrivateKey(FILE* file);
     void loadPKCS1Key(const uint8_t* data, size_t size);
     void loadPKCS8Key(const uint8_t* data, size_t size);
     void writePublicKey();
@@ -94,6 +98,8 @@ namespace rfb {
     char password[256];
     AccessRights accessRights;
 
+    PasswordWorker worker;
+
     rdr::AESInStream* rais;
     rdr::AESOutStream* raos;
 
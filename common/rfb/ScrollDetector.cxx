@@ -0,0 +1,297 @@
+/* Copyright (C) 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include <map>
+#include <unordered_map>
+
+#include <core/Region.h>
+
+#include <rfb/PixelBuffer.h>
+#include <rfb/ScrollDetector.h>
+
+using namespace rfb;
+
+// A moved area must be at least this many lines long, or it isn't
+// worth sending as a copy (and is likely a coincidence)
+static const int MinScrollLines = 16;
+
+// Don't bother looking at areas narrower than this
+static const int MinScrollWidth = 32;
+
+static const uint64_t HashPrime = 0x100000001b3ULL;
+static const uint64_t HashBasis = 0xcbf29ce484222325ULL;
+
+static inline uint64_t hashBytes(uint64_t hash, const uint8_t* data,
+                                 size_t len)
+{
+  while (len >= 8) {
+    uint64_t value;
+    memcpy(&value, data, 8);
+    hash = (hash ^ value) * HashPrime;
+    data += 8;
+    len -= 8;
+  }
+
+  while (len > 0) {
+    hash = (hash ^ *data) * HashPrime;
+    data++;
+    len--;
+  }
+
+  return hash;
+}
+
+ScrollDetector::ScrollDetector()
+{
+}
+
+bool ScrollDetector::detect(const PixelBuffer* oldFb,
+                            const PixelBuffer* newFb,
+                            const core::Rect& rect,
+                            core::Region* dest, core::Point* delta)
+{
+  // Scrolling up and down is by far the most common case
+  if (detectShift(oldFb, newFb, rect, true, dest, delta))
+    return true;
+
+  return detectShift(oldFb, newFb, rect, false, dest, delta);
+}
+
+bool ScrollDetector::detectShift(const PixelBuffer* oldFb,
+                                 const PixelBuffer* newFb,
+                                 const core::Rect& rect, bool vertical,
+                                 core::Region* dest, core::Point* delta)
+{
+  int lines, shift;
+  int start, end;
+  bool changed;
+
+  if (vertical) {
+    if ((rect.width() < MinScrollWidth) ||
+        (rect.height() <= MinScrollLines))
+      return false;
+    lines = rect.height();
+    hashRows(oldFb, rect, &oldHashes);
+    hashRows(newFb, rect, &newHashes);
+  } else {
+    if ((rect.height() < MinScrollWidth) ||
+        (rect.width() <= MinScrollLines))
+      return false;
+    lines = rect.width();
+    hashColumns(oldFb, rect, &oldHashes);
+    hashColumns(newFb, rect, &newHashes);
+  }
+
+  shift = findShift(lines);
+  if (shift == 0)
+    return false;
+
+  dest->clear();
+
+  // Collect every run of lines that matches with this shift. Runs that
+  // haven't changed at all are left alone, as the comparison will
+  // remove them anyway.
+  start = -1;
+  changed = false;
+  for (int line = 0; line <= lines; line++) {
+    bool match;
+
+    match = false;
+    if ((line < lines) && (line - shift >= 0) && (line - shift < lines) &&
+        (newHashes[line] == oldHashes[line - shift]) &&
+        linesEqual(oldFb, newFb, rect, vertical, line - shift, line))
+      match = true;
+
+    if (match) {
+      if (start == -1) {
+        start = line;
+        changed = false;
+      }
+      if (newHashes[line] != oldHashes[line])
+        changed = true;
+      continue;
+    }
+
+    if (start == -1)
+      continue;
+
+    end = line;
+    if (changed && (end - start >= MinScrollLines)) {
+      if (vertical)
+        dest->assign_union({{rect.tl.x, rect.tl.y + start,
+                             rect.br.x, rect.tl.y + end}});
+      else
+        dest->assign_union({{rect.tl.x + start, rect.tl.y,
+                             rect.tl.x + end, rect.br.y}});
+    }
+
+    start = -1;
+  }
+
+  if (dest->is_empty())
+    return false;
+
+  if (vertical)
+    *delta = core::Point(0, shift);
+  else
+    *delta = core::Point(shift, 0);
+
+  return true;
+}
+
+void ScrollDetector::hashRows(const PixelBuffer* pb,
+                              const core::Rect& rect,
+                              std::vector<uint64_t>* hashes)
+{
+  const uint8_t* data;
+  int stride;
+  size_t bytesPerPixel, len;
+
+  bytesPerPixel = pb->getPF().bpp/8;
+
+  data = pb->getBuffer(rect, &stride);
+  len = rect.width() * bytesPerPixel;
+
+  hashes->resize(rect.height());
+  for (int y = 0; y < rect.height(); y++) {
+    (*hashes)[y] = hashBytes(HashBasis, data, len);
+    data += stride * bytesPerPixel;
+  }
+}
+
+void ScrollDetector::hashColumns(const PixelBuffer* pb,
+                                 const core::Rect& rect,
+                                 std::vector<uint64_t>* hashes)
+{
+  const uint8_t* data;
+  int stride;
+  size_t bytesPerPixel;
+
+  bytesPerPixel = pb->getPF().bpp/8;
+
+  data = pb->getBuffer(rect, &stride);
+
+  hashes->assign(rect.width(), HashBasis);
+  for (int y = 0; y < rect.height(); y++) {
+    const uint8_t* pixel;
+
+    pixel = data;
+    if (bytesPerPixel == 4) {
+      // Fast path for the common case
+      for (int x = 0; x < rect.width(); x++) {
+        uint32_t value;
+        memcpy(&value, pixel, 4);
+        (*hashes)[x] = ((*hashes)[x] ^ value) * HashPrime;
+        pixel += 4;
+      }
+    } else {
+      for (int x = 0; x < rect.width(); x++) {
+        (*hashes)[x] = hashBytes((*hashes)[x], pixel, bytesPerPixel);
+        pixel += bytesPerPixel;
+      }
+    }
+
+    data += stride * bytesPerPixel;
+  }
+}
+
+bool ScrollDetector::linesEqual(const PixelBuffer* oldFb,
+                                const PixelBuffer* newFb,
+                                const core::Rect& rect, bool vertical,
+                                int oldLine, int newLine)
+{
+  const uint8_t *oldData, *newData;
+  int oldStride, newStride;
+  size_t bytesPerPixel;
+
+  bytesPerPixel = newFb->getPF().bpp/8;
+
+  // Hashes can collide, so we need to check the actual pixels
+  if (vertical) {
+    oldData = oldFb->getBuffer({rect.tl.x, rect.tl.y + oldLine,
+                                rect.br.x, rect.tl.y + oldLine + 1},
+                               &oldStride);
+    newData = newFb->getBuffer({rect.tl.x, rect.tl.y + newLine,
+                                rect.br.x, rect.tl.y + newLine + 1},
+                               &newStride);
+    return memcmp(oldData, newData, rect.width() * bytesPerPixel) == 0;
+  }
+
+  oldData = oldFb->getBuffer({rect.tl.x + oldLine, rect.tl.y,
+                              rect.tl.x + oldLine + 1, rect.br.y},
+                             &oldStride);
+  newData = newFb->getBuffer({rect.tl.x + newLine, rect.tl.y,
+                              rect.tl.x + newLine + 1, rect.br.y},
+                             &newStride);
+  for (int y = 0; y < rect.height(); y++) {
+    if (memcmp(oldData, newData, bytesPerPixel) != 0)
+      return false;
+    oldData += oldStride * bytesPerPixel;
+    newData += newStride * bytesPerPixel;
+  }
+
+  return true;
+}
+
+int ScrollDetector::findShift(int lines)
+{
+  std::unordered_map<uint64_t, int> oldLines;
+  std::map<int, int> votes;
+  int bestShift, bestVotes;
+
+  // Lines that repeat (e.g. blank ones) can't tell us anything about
+  // where things moved, so only unique lines are considered
+  for (int line = 0; line < lines; line++) {
+    auto result = oldLines.insert({oldHashes[line], line});
+    if (!result.second)
+      result.first->second = -1;
+  }
+
+  for (int line = 0; line < lines; line++) {
+    std::unordered_map<uint64_t, int>::const_iterator iter;
+
+    if (newHashes[line] == oldHashes[line])
+      continue;
+
+    iter = oldLines.find(newHashes[line]);
+    if ((iter == oldLines.end()) || (iter->second == -1))
+      continue;
+
+    votes[line - iter->second]++;
+  }
+
+  bestShift = 0;
+  bestVotes = 0;
+  for (const auto& vote : votes) {
+    if (vote.second > bestVotes) {
+      bestShift = vote.first;
+      bestVotes = vote.second;
+    }
+  }
+
+  if (bestVotes < MinScrollLines)
+    return 0;
+
+  return bestShift;
+}
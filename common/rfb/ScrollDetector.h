@@ -0,0 +1,77 @@
+/* Copyright (C) 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+//
+// ScrollDetector finds content that has moved between two versions of
+// the framebuffer, so that it can be sent as a copy rather than as new
+// pixels. Applications often scroll by redrawing everything, so the
+// server never gets told about the move itself.
+//
+
+#ifndef __RFB_SCROLLDETECTOR_H__
+#define __RFB_SCROLLDETECTOR_H__
+
+#include <stdint.h>
+
+#include <vector>
+
+#include <core/Rect.h>
+
+namespace core { class Region; }
+
+namespace rfb {
+
+  class PixelBuffer;
+
+  class ScrollDetector {
+  public:
+    ScrollDetector();
+
+    // detect() compares the area rect of both buffers, looking for a
+    // vertical or horizontal shift. If one is found then the area that
+    // can be copied is stored in dest, and the shift in delta, in the
+    // same way as for UpdateTracker::add_copied().
+    bool detect(const PixelBuffer* oldFb, const PixelBuffer* newFb,
+                const core::Rect& rect,
+                core::Region* dest, core::Point* delta);
+
+  private:
+    // Lines are rows or columns, depending on the direction searched
+    bool detectShift(const PixelBuffer* oldFb, const PixelBuffer* newFb,
+                     const core::Rect& rect, bool vertical,
+                     core::Region* dest, core::Point* delta);
+
+    void hashRows(const PixelBuffer* pb, const core::Rect& rect,
+                  std::vector<uint64_t>* hashes);
+    void hashColumns(const PixelBuffer* pb, const core::Rect& rect,
+                     std::vector<uint64_t>* hashes);
+
+    bool linesEqual(const PixelBuffer* oldFb, const PixelBuffer* newFb,
+                    const core::Rect& rect, bool vertical,
+                    int oldLine, int newLine);
+
+    int findShift(int lines);
+
+  private:
+    std::vector<uint64_t> oldHashes;
+    std::vector<uint64_t> newHashes;
+  };
+
+}
+
+#endif
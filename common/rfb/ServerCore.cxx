@@ -50,10 +50,45 @@ core::IntParameter rfb::Server::compareFB
  "Perform pixel comparison on framebuffer to reduce unnecessary updates "
  "(0: never, 1: always, 2: auto)",
  2, 0, 2);
+core::BoolParameter rfb::Server::detectScroll
+("DetectScroll",
+ "Look for content that has moved on screen and send it as a copy "
+ "(requires CompareFB)",
+ false);
 core::IntParameter rfb::Server::frameRate
 ("FrameRate",
  "The maximum number of updates per second sent to each client",
  60, 0, INT_MAX);
+core::IntParameter rfb::Server::frameSyncTimeout
+("FrameSyncTimeout",
+ "How long to keep waiting for the next frame from an application "
+ "that marks its frames, before sending partial changes (in ms)",
+ 250, 0, INT_MAX);
+core::BoolParameter rfb::Server::adaptiveQuality
+("AdaptiveQuality",
+ "Lower the JPEG quality below what the client requested when the "
+ "network or the CPU cannot keep up with the frame rate",
+ false);
+core::BoolParameter rfb::Server::adaptiveEncoders
+("AdaptiveEncoders",
+ "Pick lossless encoders based on how much they compress and how much "
+ "CPU they use, rather than only what the client prefers",
+ false);
+core::IntParameter rfb::Server::refineQuality
+("RefineQuality",
+ "JPEG quality level used to sharpen low quality areas before they are "
+ "sent losslessly (-1 sends them losslessly right away)",
+ 8, -1, 9);
+core::IntParameter rfb::Server::tileCacheSize
+("TileCacheSize",
+ "The largest cache (in MiB) each client may keep of previously sent "
+ "content (zero disables the cache)",
+ 0, 0, INT_MAX);
+core::BoolParameter rfb::Server::sharedMemory
+("SharedMemory",
+ "Pass screen updates through shared memory to clients on the same "
+ "host that are connected over a UNIX socket",
+ false);
 core::BoolParameter rfb::Server::protocol3_3
 ("Protocol3.3",
  "Always use protocol version 3.3 for backwards compatibility with "
@@ -99,3 +134,18 @@ core::BoolParameter rfb::Server::queryConnect
 ("QueryConnect",
  "Prompt the local user to accept or reject incoming connections.",
  false);
+core::BoolParameter rfb::Server::latencyTrace
+("LatencyTrace",
+ "Measure the latency of each framebuffer update, from the damage until "
+ "the client has processed it, and log the results on disconnect",
+ false);
+core::StringParameter rfb::Server::recordSession
+("RecordSession",
+ "Record the framebuffer updates to files starting with this path, for "
+ "use with the performance tests (empty disables recording)",
+ "");
+core::IntParameter rfb::Server::recordRotateSize
+("RecordRotateSize",
+ "Start a new recording file once the current one is larger than this "
+ "(in MiB)",
+ 256, 1, INT_MAX);
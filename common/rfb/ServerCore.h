@@ -36,7 +36,14 @@ namespace rfb {
     static core::IntParameter maxConnectionTime;
     static core::IntParameter maxIdleTime;
     static core::IntParameter compareFB;
+    static core::BoolParameter detectScroll;
     static core::IntParameter frameRate;
+    static core::IntParameter frameSyncTimeout;
+    static core::BoolParameter adaptiveQuality;
+    static core::BoolParameter adaptiveEncoders;
+    static core::IntParameter refineQuality;
+    static core::IntParameter tileCacheSize;
+    static core::BoolParameter sharedMemory;
     static core::BoolParameter protocol3_3;
     static core::BoolParameter alwaysShared;
     static core::BoolParameter neverShared;
@@ -47,6 +54,9 @@ namespace rfb {
     static core::BoolParameter sendCutText;
     static core::BoolParameter acceptSetDesktopSize;
     static core::BoolParameter queryConnect;
+    static core::BoolParameter latencyTrace;
+    static core::StringParameter recordSession;
+    static core::IntParameter recordRotateSize;
 
   };
 
@@ -0,0 +1,425 @@
+/* Copyright (C) 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#ifndef WIN32
+#include <unistd.h>
+#endif
+
+#include <core/Exception.h>
+#include <core/LogWriter.h>
+#include <core/string.h>
+#include <core/time.h>
+
+#include <rdr/MemOutStream.h>
+
+#include <rfb/EncodeManager.h>
+#include <rfb/PixelBuffer.h>
+#include <rfb/SConnection.h>
+#include <rfb/SMsgWriter.h>
+#include <rfb/SessionRecorder.h>
+#include <rfb/encodings.h>
+
+using namespace rfb;
+
+static core::LogWriter vlog("SessionRecorder");
+
+// How much pixel data we allow to pile up before we give up on the
+// current file
+static const size_t MaxQueued = 128 * 1024 * 1024;
+
+// The encodings we pretend the recording "client" supports, which are
+// all lossless so that the recording is an exact copy
+static const int32_t recordEncodings[] = {
+  encodingTight, encodingCopyRect, encodingZRLE, encodingHextile,
+  encodingRRE, pseudoEncodingLastRect
+};
+
+// A connection that just collects the encoded data in memory. It keeps
+// its own copy of the framebuffer, which the worker updates from the
+// queued pixels before encoding.
+// Recordings contain everything that was on screen, so they should
+// only be readable by the owner
+static FILE* openPrivate(const char* path, const char* mode)
+{
+#ifdef WIN32
+  return fopen(path, mode);
+#else
+  int fd;
+  FILE* f;
+
+  fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+  if (fd < 0)
+    return nullptr;
+
+  f = fdopen(fd, mode);
+  if (f == nullptr) {
+    int err = errno;
+    close(fd);
+    errno = err;
+  }
+
+  return f;
+#endif
+}
+
+class SessionRecorder::Connection : public SConnection {
+public:
+  Connection(const PixelFormat& pf, int width, int height)
+    : SConnection(AccessNone), fb(pf, width, height), manager(this)
+  {
+    setStreams(nullptr, &out);
+    setWriter(new SMsgWriter(&client, &out));
+
+    client.setDimensions(width, height);
+    client.setPF(pf);
+    setEncodings(sizeof(recordEncodings) / sizeof(*recordEncodings),
+                 recordEncodings);
+  }
+
+  void writeUpdate(const UpdateInfo& ui)
+  {
+    manager.encodeUpdate(ui, &fb);
+  }
+
+  void takeData(std::vector<uint8_t>* data)
+  {
+    data->assign(out.data(), out.data() + out.length());
+    out.clear();
+  }
+
+  void setDesktopSize(int, int, const ScreenSet&) override {}
+  void keyEvent(uint32_t, uint32_t, bool) override {}
+  void pointerEvent(const core::Point&, uint16_t) override {}
+
+  ManagedPixelBuffer fb;
+
+private:
+  rdr::MemOutStream out;
+  EncodeManager manager;
+};
+
+SessionRecorder::SessionRecorder(const char* prefix_, size_t rotateSize_)
+  : prefix(prefix_), rotateSize(rotateSize_),
+    width(0), height(0), restart(true),
+    queued(0), stopRequested(false), failed(false),
+    current(nullptr), fileCount(0),
+    dataFile(nullptr), timesFile(nullptr), dataOffset(0),
+    thread(nullptr)
+{
+  gettimeofday(&startTime, nullptr);
+
+  thread = new std::thread(&SessionRecorder::worker, this);
+}
+
+SessionRecorder::~SessionRecorder()
+{
+  std::unique_lock<std::mutex> lock(mutex);
+  stopRequested = true;
+  consumerCond.notify_all();
+  lock.unlock();
+
+  // The worker writes out whatever is still queued before it exits
+  thread->join();
+  delete thread;
+
+  deleteRetired();
+  delete current;
+}
+
+bool SessionRecorder::writeUpdate(const UpdateInfo& ui,
+                                  const PixelBuffer* pb,
+                                  const char* name)
+{
+  bool overflow;
+
+  deleteRetired();
+
+  {
+    const std::lock_guard<std::mutex> lock(mutex);
+    if (failed)
+      return false;
+    overflow = queued > MaxQueued;
+  }
+
+  // Dropping updates would corrupt the file, so we have to start over
+  // with a fresh file once the worker has caught up
+  if (overflow) {
+    if (!restart)
+      vlog.error("Recording can't keep up, restarting once it has "
+                 "caught up");
+    restart = true;
+    return true;
+  }
+
+  if (restart || (pb->width() != width) || (pb->height() != height) ||
+      !(pb->getPF() == pf)) {
+    UpdateInfo full;
+
+    width = pb->width();
+    height = pb->height();
+    pf = pb->getPF();
+    restart = false;
+
+    // A fresh connection, so that the new file doesn't depend on any
+    // encoder state from the previous one. The worker doesn't see it
+    // until it has been queued.
+    full.changed = pb->getRect();
+    queueUpdate(full, pb, new Connection(pf, width, height), name);
+
+    return true;
+  }
+
+  if (ui.is_empty())
+    return true;
+
+  queueUpdate(ui, pb, nullptr, name);
+
+  return true;
+}
+
+void SessionRecorder::queueUpdate(const UpdateInfo& ui,
+                                  const PixelBuffer* pb,
+                                  Connection* conn, const char* name)
+{
+  Chunk chunk;
+  struct timeval now;
+  std::vector<core::Rect> rects;
+  size_t size, offset;
+  int bpp;
+
+  gettimeofday(&now, nullptr);
+
+  chunk.conn = conn;
+  if (conn != nullptr)
+    chunk.name = name;
+  chunk.ui = ui;
+  chunk.usecs = (now.tv_sec - startTime.tv_sec) * 1000000ULL;
+  chunk.usecs += now.tv_usec - startTime.tv_usec;
+
+  // The copied area also has to be updated in the worker's copy of
+  // the framebuffer, even though it is encoded as a copy
+  ui.changed.union_(ui.copied).get_rects(&rects);
+
+  bpp = pb->getPF().bpp / 8;
+
+  size = 0;
+  for (const core::Rect& r : rects)
+    size += r.area() * bpp;
+  chunk.pixels.resize(size);
+
+  offset = 0;
+  for (const core::Rect& r : rects) {
+    pb->getImage(chunk.pixels.data() + offset, r);
+    offset += r.area() * bpp;
+  }
+
+  const std::lock_guard<std::mutex> lock(mutex);
+
+  queued += chunk.pixels.size();
+  queue.push_back(std::move(chunk));
+
+  consumerCond.notify_one();
+}
+
+void SessionRecorder::deleteRetired()
+{
+  std::list<Connection*> connections;
+
+  {
+    const std::lock_guard<std::mutex> lock(mutex);
+    connections.swap(retired);
+  }
+
+  for (Connection* conn : connections)
+    delete conn;
+}
+
+void SessionRecorder::worker()
+{
+  std::unique_lock<std::mutex> lock(mutex);
+
+  while (true) {
+    Chunk chunk;
+
+    if (queue.empty()) {
+      if (stopRequested)
+        break;
+      consumerCond.wait(lock);
+      continue;
+    }
+
+    chunk = std::move(queue.front());
+    queue.pop_front();
+
+    lock.unlock();
+
+    try {
+      encodeChunk(&chunk);
+      writeChunk(chunk);
+    } catch (std::exception& e) {
+      vlog.error("Failed to write recording: %s", e.what());
+      lock.lock();
+      failed = true;
+      for (const Chunk& dropped : queue) {
+        if (dropped.conn != nullptr)
+          retired.push_back(dropped.conn);
+      }
+      queue.clear();
+      queued = 0;
+      break;
+    }
+
+    lock.lock();
+
+    queued -= chunk.pixels.size();
+  }
+
+  lock.unlock();
+
+  closeFile();
+}
+
+void SessionRecorder::encodeChunk(Chunk* chunk)
+{
+  std::vector<core::Rect> rects;
+  size_t offset;
+  int bpp;
+  bool newFile;
+
+  newFile = false;
+
+  if (chunk->conn != nullptr) {
+    retire(current);
+    current = chunk->conn;
+    desktopName = chunk->name;
+    newFile = true;
+  } else if (dataOffset >= rotateSize) {
+    Connection* conn;
+    const uint8_t* data;
+    int stride;
+
+    // Same framebuffer, but with fresh encoder state
+    conn = new Connection(current->fb.getPF(), current->fb.width(),
+                          current->fb.height());
+    data = current->fb.getBuffer(current->fb.getRect(), &stride);
+    conn->fb.imageRect(conn->fb.getRect(), data, stride);
+
+    retire(current);
+    current = conn;
+    newFile = true;
+  }
+
+  chunk->ui.changed.union_(chunk->ui.copied).get_rects(&rects);
+
+  bpp = current->fb.getPF().bpp / 8;
+
+  offset = 0;
+  for (const core::Rect& r : rects) {
+    current->fb.imageRect(r, chunk->pixels.data() + offset);
+    offset += r.area() * bpp;
+  }
+
+  // Each file has to start with everything needed to decode it
+  if (newFile) {
+    UpdateInfo full;
+
+    chunk->filename = core::format("%s-%03d.rfb", prefix.c_str(),
+                                   fileCount++);
+
+    current->writer()->writeServerInit(current->fb.width(),
+                                       current->fb.height(),
+                                       current->fb.getPF(),
+                                       desktopName.c_str());
+    current->takeData(&chunk->serverInit);
+
+    full.changed = current->fb.getRect();
+    current->writeUpdate(full);
+  } else {
+    current->writeUpdate(chunk->ui);
+  }
+
+  current->takeData(&chunk->data);
+}
+
+void SessionRecorder::retire(Connection* conn)
+{
+  const std::lock_guard<std::mutex> lock(mutex);
+
+  if (conn != nullptr)
+    retired.push_back(conn);
+}
+
+void SessionRecorder::writeChunk(const Chunk& chunk)
+{
+  if (!chunk.filename.empty()) {
+    std::string timesName;
+
+    closeFile();
+
+    timesName = chunk.filename.substr(0, chunk.filename.size() - 4);
+    timesName += ".times";
+
+    dataFile = openPrivate(chunk.filename.c_str(), "wb");
+    if (dataFile == nullptr)
+      throw core::posix_error("open", errno);
+    timesFile = openPrivate(timesName.c_str(), "w");
+    if (timesFile == nullptr)
+      throw core::posix_error("open", errno);
+
+    dataOffset = 0;
+
+    vlog.info("Recording session to %s", chunk.filename.c_str());
+
+    if (fwrite(chunk.serverInit.data(), 1, chunk.serverInit.size(),
+               dataFile) != chunk.serverInit.size())
+      throw core::posix_error("fwrite", errno);
+
+    dataOffset += chunk.serverInit.size();
+  }
+
+  if (dataFile == nullptr)
+    return;
+
+  // Byte offset of the update in the data file, and microseconds
+  // since the recording started
+  if (fprintf(timesFile, "%llu %llu\n", dataOffset, chunk.usecs) < 0)
+    throw core::posix_error("fprintf", errno);
+
+  if (fwrite(chunk.data.data(), 1, chunk.data.size(),
+             dataFile) != chunk.data.size())
+    throw core::posix_error("fwrite", errno);
+
+  dataOffset += chunk.data.size();
+}
+
+void SessionRecorder::closeFile()
+{
+  if (dataFile != nullptr) {
+    fclose(dataFile);
+    dataFile = nullptr;
+  }
+  if (timesFile != nullptr) {
+    fclose(timesFile);
+    timesFile = nullptr;
+  }
+}
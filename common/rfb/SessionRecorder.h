@@ -0,0 +1,130 @@
+/* Copyright (C) 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+//
+// SessionRecorder saves the framebuffer updates of a session to disk,
+// in the same format as encperf and decperf read. Each file starts
+// with a ServerInit and a full update so that it can be decoded on its
+// own. The time of each update is saved in a separate file.
+//
+// Only a copy of the changed pixels is taken on the calling thread.
+// Encoding and writing is done by a separate thread, so that recording
+// doesn't add to the time spent encoding updates for the clients.
+//
+
+#ifndef __RFB_SESSIONRECORDER_H__
+#define __RFB_SESSIONRECORDER_H__
+
+#include <stdio.h>
+#include <sys/time.h>
+
+#include <condition_variable>
+#include <list>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <rfb/PixelFormat.h>
+#include <rfb/UpdateTracker.h>
+
+namespace rfb {
+
+  class PixelBuffer;
+
+  class SessionRecorder {
+  public:
+    // Files are named <prefix>-<n>.rfb, with the times of the updates
+    // in <prefix>-<n>.times. A new file is started once the current
+    // one has grown beyond rotateSize bytes.
+    SessionRecorder(const char* prefix, size_t rotateSize);
+    ~SessionRecorder();
+
+    // writeUpdate() copies the changed pixels and queues them for
+    // encoding and writing. It returns false if recording has failed
+    // and has been stopped.
+    bool writeUpdate(const UpdateInfo& ui, const PixelBuffer* pb,
+                     const char* name);
+
+  private:
+    class Connection;
+
+    struct Chunk {
+      // Set if this update has to start a new file, e.g. because the
+      // framebuffer has changed, together with the connection that
+      // will encode the updates for it
+      Connection* conn;
+      std::string name;
+
+      // The contents of ui.changed and ui.copied, rect by rect
+      UpdateInfo ui;
+      std::vector<uint8_t> pixels;
+      unsigned long long usecs;
+
+      // Filled in by the worker
+      std::string filename;
+      std::vector<uint8_t> serverInit;
+      std::vector<uint8_t> data;
+    };
+
+    void queueUpdate(const UpdateInfo& ui, const PixelBuffer* pb,
+                     Connection* conn, const char* name);
+    void deleteRetired();
+
+    void worker();
+    void encodeChunk(Chunk* chunk);
+    void retire(Connection* conn);
+    void writeChunk(const Chunk& chunk);
+    void closeFile();
+
+  private:
+    std::string prefix;
+    size_t rotateSize;
+
+    int width, height;
+    PixelFormat pf;
+    bool restart;
+
+    struct timeval startTime;
+
+    std::mutex mutex;
+    std::condition_variable consumerCond;
+
+    std::list<Chunk> queue;
+    size_t queued;
+    bool stopRequested;
+    bool failed;
+
+    // Connections have timers, so they can only be destroyed on the
+    // calling thread. The worker hands them back once it is done.
+    std::list<Connection*> retired;
+
+    // Only used by the worker
+    Connection* current;
+    std::string desktopName;
+    int fileCount;
+    FILE* dataFile;
+    FILE* timesFile;
+    unsigned long long dataOffset;
+
+    std::thread* thread;
+  };
+
+}
+
+#endif
@@ -0,0 +1,223 @@
+/* Copyright (C) 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <errno.h>
+#ifndef WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include <atomic>
+#include <new>
+
+#include <core/Exception.h>
+
+#include <rfb/Exception.h>
+#include <rfb/SharedMemory.h>
+
+using namespace rfb;
+
+// The pixel data starts on its own page after the header
+static const size_t HeaderSize = 4096;
+
+struct SharedMemory::Header {
+  std::atomic<uint32_t> attached;
+  std::atomic<uint64_t> readPos;
+};
+
+SharedMemory::SharedMemory(size_t size_)
+  : fd(-1), size(size_), mapping(nullptr), header(nullptr),
+    data(nullptr), writePos(0), readPos(0)
+{
+#ifdef MFD_ALLOW_SEALING
+  int err;
+
+  fd = memfd_create("tigervnc", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+  if (fd < 0)
+    throw core::posix_error("memfd_create", errno);
+
+  if (ftruncate(fd, HeaderSize + size) != 0) {
+    err = errno;
+    close(fd);
+    throw core::posix_error("ftruncate", err);
+  }
+
+  // The client must not be able to shrink the file, or we would crash
+  // when writing to it
+  if (fcntl(fd, F_ADD_SEALS,
+            F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) != 0) {
+    err = errno;
+    close(fd);
+    throw core::posix_error("fcntl", err);
+  }
+
+  map(true);
+#else
+  throw core::posix_error("memfd_create", ENOSYS);
+#endif
+}
+
+SharedMemory::SharedMemory(int fd_, size_t size_)
+  : fd(fd_), size(size_), mapping(nullptr), header(nullptr),
+    data(nullptr), writePos(0), readPos(0)
+{
+#ifdef MFD_ALLOW_SEALING
+  struct stat st;
+  int seals, err;
+
+  if (fstat(fd, &st) != 0) {
+    err = errno;
+    close(fd);
+    throw core::posix_error("fstat", err);
+  }
+
+  if ((size_t)st.st_size < HeaderSize + size) {
+    close(fd);
+    throw protocol_error("Shared memory is smaller than announced");
+  }
+
+  // Same as the server, we must not crash if the other end shrinks it
+  seals = fcntl(fd, F_GET_SEALS);
+  if ((seals == -1) || !(seals & F_SEAL_SHRINK)) {
+    close(fd);
+    throw protocol_error("Shared memory can be shrunk");
+  }
+
+  map(false);
+#else
+  throw core::posix_error("memfd_create", ENOSYS);
+#endif
+}
+
+SharedMemory::~SharedMemory()
+{
+#ifdef MFD_ALLOW_SEALING
+  munmap(mapping, HeaderSize + size);
+  close(fd);
+#endif
+}
+
+bool SharedMemory::isSupported()
+{
+#ifdef MFD_ALLOW_SEALING
+  return true;
+#else
+  return false;
+#endif
+}
+
+bool SharedMemory::isAttached() const
+{
+  return header->attached.load(std::memory_order_acquire) != 0;
+}
+
+uint8_t* SharedMemory::alloc(size_t len, uint32_t* offset)
+{
+  uint64_t pos, done;
+
+  if (len > size)
+    return nullptr;
+
+  done = header->readPos.load(std::memory_order_acquire);
+
+  // A client that lies about this can only hurt itself, as long as we
+  // never go beyond what we have actually written
+  if (done > writePos)
+    done = writePos;
+
+  // Data is never split across the end of the buffer
+  pos = writePos;
+  if ((pos % size) + len > size)
+    pos += size - (pos % size);
+
+  if (pos + len - done > size)
+    return nullptr;
+
+  *offset = pos % size;
+  writePos = pos + len;
+
+  return data + *offset;
+}
+
+void SharedMemory::attach()
+{
+  header->attached.store(1, std::memory_order_release);
+}
+
+const uint8_t* SharedMemory::read(uint32_t offset, size_t len)
+{
+  uint64_t pos;
+
+  if (len > size)
+    return nullptr;
+
+  pos = readPos;
+  if (offset != pos % size) {
+    // The server only ever skips to the start, and only if the data
+    // wouldn't fit before the end
+    if ((offset != 0) || ((pos % size) + len <= size))
+      return nullptr;
+    pos += size - (pos % size);
+  }
+
+  // Nor does it ever split data across the end
+  if ((size_t)offset + len > size)
+    return nullptr;
+
+  readPos = pos + len;
+
+  return data + offset;
+}
+
+void SharedMemory::release()
+{
+  header->readPos.store(readPos, std::memory_order_release);
+}
+
+void SharedMemory::map(bool create)
+{
+#ifdef MFD_ALLOW_SEALING
+  int err;
+
+  mapping = mmap(nullptr, HeaderSize + size, PROT_READ | PROT_WRITE,
+                 MAP_SHARED, fd, 0);
+  if (mapping == MAP_FAILED) {
+    err = errno;
+    close(fd);
+    throw core::posix_error("mmap", err);
+  }
+
+  if (create) {
+    header = new (mapping) Header;
+    header->attached.store(0);
+    header->readPos.store(0);
+  } else {
+    header = (Header*)mapping;
+  }
+
+  data = (uint8_t*)mapping + HeaderSize;
+#else
+  (void)create;
+#endif
+}
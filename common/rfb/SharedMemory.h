@@ -0,0 +1,91 @@
+/* Copyright (C) 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+//
+// SharedMemory is a ring buffer in a memory file that the server
+// shares with a client on the same host. The server copies the pixels
+// of each rect in to it, and only tells the client where to find them.
+// The client reports back in the buffer itself how far it has read, so
+// the server never overwrites anything that is still needed.
+//
+
+#ifndef __RFB_SHAREDMEMORY_H__
+#define __RFB_SHAREDMEMORY_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace rfb {
+
+  class SharedMemory {
+  public:
+    // Creates a new buffer with room for size bytes of pixel data
+    SharedMemory(size_t size);
+    // Maps a buffer created by the other end, taking ownership of the
+    // file descriptor
+    SharedMemory(int fd, size_t size);
+    ~SharedMemory();
+
+    // isSupported() returns false on systems without anonymous memory
+    // files, where the constructors will always fail
+    static bool isSupported();
+
+    int getFd() const { return fd; }
+    size_t getSize() const { return size; }
+
+    // Server side
+
+    // isAttached() returns true once the client has mapped the buffer
+    bool isAttached() const;
+
+    // alloc() returns space for len bytes and where it is in the
+    // buffer, or nullptr if the client hasn't caught up enough
+    uint8_t* alloc(size_t len, uint32_t* offset);
+
+    // Client side
+
+    // attach() tells the server that the buffer is in use
+    void attach();
+
+    // read() returns the data that the server placed at the given
+    // offset, or nullptr if it isn't where the server would have put
+    // it. Data must be read in the order it was sent, and release()
+    // called when done with it so the space can be reused.
+    const uint8_t* read(uint32_t offset, size_t len);
+    void release();
+
+  private:
+    struct Header;
+
+    void map(bool create);
+
+    int fd;
+    size_t size;
+
+    void* mapping;
+    Header* header;
+    uint8_t* data;
+
+    // Stream positions, which only ever increase
+    uint64_t writePos;
+    uint64_t readPos;
+  };
+
+}
+
+#endif
@@ -0,0 +1,84 @@
+/* Copyright (C) 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <rdr/InStream.h>
+#include <rdr/MemInStream.h>
+#include <rdr/OutStream.h>
+
+#include <rfb/Exception.h>
+#include <rfb/PixelBuffer.h>
+#include <rfb/ServerParams.h>
+#include <rfb/SharedMemory.h>
+#include <rfb/SharedMemoryDecoder.h>
+
+using namespace rfb;
+
+SharedMemoryDecoder::SharedMemoryDecoder() : Decoder(DecoderOrdered),
+  shm(nullptr)
+{
+}
+
+SharedMemoryDecoder::~SharedMemoryDecoder()
+{
+}
+
+void SharedMemoryDecoder::setSharedMemory(SharedMemory* shm_)
+{
+  shm = shm_;
+}
+
+bool SharedMemoryDecoder::readRect(const core::Rect& /*r*/,
+                                   rdr::InStream* is,
+                                   const ServerParams& /*server*/,
+                                   rdr::OutStream* os)
+{
+  if (!is->hasData(4))
+    return false;
+
+  os->copyBytes(is, 4);
+
+  return true;
+}
+
+void SharedMemoryDecoder::decodeRect(const core::Rect& r,
+                                     const uint8_t* buffer,
+                                     size_t buflen,
+                                     const ServerParams& server,
+                                     ModifiablePixelBuffer* pb)
+{
+  rdr::MemInStream is(buffer, buflen);
+  uint32_t offset;
+  const uint8_t* data;
+
+  if (shm == nullptr)
+    throw protocol_error("Shared memory is not attached");
+
+  offset = is.readU32();
+
+  data = shm->read(offset, r.area() * (server.pf().bpp/8));
+  if (data == nullptr)
+    throw protocol_error("Invalid shared memory offset");
+
+  pb->imageRect(server.pf(), r, data);
+
+  shm->release();
+}
@@ -0,0 +1,154 @@
+/* Copyright (C) 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <assert.h>
+#include <string.h>
+
+#include <rfb/PixelBuffer.h>
+#include <rfb/TileCache.h>
+
+using namespace rfb;
+
+// A false match would show the wrong content until the area changes
+// again, so we use a better mix than for plain change detection
+static const uint64_t HashMul1 = 0x9e3779b97f4a7c15ULL;
+static const uint64_t HashMul2 = 0xbf58476d1ce4e5b9ULL;
+static const uint64_t HashMul3 = 0x94d049bb133111ebULL;
+
+static inline uint64_t mixHash(uint64_t hash, uint64_t value)
+{
+  value *= HashMul2;
+  value ^= value >> 31;
+  hash ^= value;
+  hash = (hash << 27) | (hash >> 37);
+  return hash * HashMul1 + HashMul3;
+}
+
+TileCache::TileCache()
+  : maxTiles(0), nextId(0)
+{
+}
+
+TileCache::~TileCache()
+{
+}
+
+void TileCache::setMaxTiles(size_t tiles)
+{
+  maxTiles = tiles;
+
+  while (lru.size() > maxTiles) {
+    entries.erase(lru.back().hash);
+    lru.pop_back();
+  }
+}
+
+void TileCache::clear()
+{
+  lru.clear();
+  entries.clear();
+}
+
+bool TileCache::lookup(uint64_t hash, uint32_t* id)
+{
+  std::unordered_map<uint64_t, std::list<Entry>::iterator>::iterator iter;
+
+  iter = entries.find(hash);
+  if (iter == entries.end())
+    return false;
+
+  lru.splice(lru.begin(), lru, iter->second);
+  *id = iter->second->id;
+
+  return true;
+}
+
+bool TileCache::contains(uint64_t hash) const
+{
+  return entries.count(hash) != 0;
+}
+
+uint32_t TileCache::add(uint64_t hash)
+{
+  Entry entry;
+
+  assert(maxTiles > 0);
+  assert(!contains(hash));
+
+  if (lru.size() >= maxTiles) {
+    entries.erase(lru.back().hash);
+    lru.pop_back();
+  }
+
+  entry.hash = hash;
+  entry.id = nextId++;
+
+  lru.push_front(entry);
+  entries[hash] = lru.begin();
+
+  return entry.id;
+}
+
+uint64_t TileCache::hashRect(const PixelBuffer* pb, const core::Rect& r)
+{
+  const uint8_t* buffer;
+  int stride;
+  size_t rowLen;
+  uint64_t hash;
+
+  buffer = pb->getBuffer(r, &stride);
+  stride *= pb->getPF().bpp/8;
+  rowLen = r.width() * (pb->getPF().bpp/8);
+
+  hash = mixHash(0, ((uint64_t)r.width() << 32) | r.height());
+
+  for (int y = 0; y < r.height(); y++) {
+    const uint8_t* data;
+    size_t len;
+
+    data = buffer;
+    len = rowLen;
+
+    while (len >= 8) {
+      uint64_t value;
+      memcpy(&value, data, 8);
+      hash = mixHash(hash, value);
+      data += 8;
+      len -= 8;
+    }
+
+    if (len > 0) {
+      uint64_t value;
+      value = 0;
+      memcpy(&value, data, len);
+      hash = mixHash(hash, value);
+    }
+
+    buffer += stride;
+  }
+
+  hash ^= hash >> 33;
+  hash *= HashMul2;
+  hash ^= hash >> 29;
+
+  return hash;
+}
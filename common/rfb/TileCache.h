@@ -0,0 +1,93 @@
+/* Copyright (C) 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+//
+// TileCache keeps track of which tiles the client has stored in its
+// tile cache, so that content that has been sent before can be sent
+// as a short reference instead. The client evicts tiles in the same
+// least recently used order, so the server never needs to ask what
+// is still there.
+//
+
+#ifndef __RFB_TILECACHE_H__
+#define __RFB_TILECACHE_H__
+
+#include <stdint.h>
+
+#include <list>
+#include <unordered_map>
+
+#include <core/Rect.h>
+
+namespace rfb {
+
+  class PixelBuffer;
+
+  // Operations for encodingTileCache rects
+  const int tileCacheStore = 0;
+  const int tileCacheDraw = 1;
+  const int tileCacheReset = 2;
+
+  // Cached tiles are aligned to and exactly this size
+  const int tileCacheTileSize = 64;
+
+  // The cache size is negotiated in MiB, assuming 32 bits per pixel
+  const int tileCacheTilesPerMiB = 64;
+
+  // The largest size level that can be negotiated (2^15 MiB)
+  const int tileCacheMaxLevel = 15;
+
+  class TileCache {
+  public:
+    TileCache();
+    ~TileCache();
+
+    // setMaxTiles() changes how many tiles may be cached, evicting
+    // the least recently used ones if the limit shrinks
+    void setMaxTiles(size_t tiles);
+    size_t getMaxTiles() const { return maxTiles; }
+
+    void clear();
+
+    // lookup() checks if a tile with the given hash is cached, and if
+    // so marks it as the most recently used
+    bool lookup(uint64_t hash, uint32_t* id);
+    bool contains(uint64_t hash) const;
+
+    // add() stores a new tile, evicting the least recently used tile
+    // if the cache is full, and returns the id it was given
+    uint32_t add(uint64_t hash);
+
+    static uint64_t hashRect(const PixelBuffer* pb, const core::Rect& r);
+
+  private:
+    struct Entry {
+      uint64_t hash;
+      uint32_t id;
+    };
+
+    size_t maxTiles;
+    uint32_t nextId;
+
+    std::list<Entry> lru;
+    std::unordered_map<uint64_t, std::list<Entry>::iterator> entries;
+  };
+
+}
+
+#endif
@@ -0,0 +1,166 @@
+/* Copyright (C) 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <core/LogWriter.h>
+#include <core/Region.h>
+
+#include <rdr/InStream.h>
+#include <rdr/MemInStream.h>
+#include <rdr/OutStream.h>
+
+#include <rfb/Exception.h>
+#include <rfb/PixelBuffer.h>
+#include <rfb/TileCache.h>
+#include <rfb/TileCacheDecoder.h>
+
+using namespace rfb;
+
+static core::LogWriter vlog("TileCacheDecoder");
+
+TileCacheDecoder::TileCacheDecoder() : Decoder(DecoderOrdered),
+  maxTiles(0)
+{
+}
+
+TileCacheDecoder::~TileCacheDecoder()
+{
+}
+
+void TileCacheDecoder::setMaxTiles(size_t tiles)
+{
+  if (tiles < maxTiles)
+    return;
+
+  maxTiles = tiles;
+}
+
+bool TileCacheDecoder::readRect(const core::Rect& r,
+                                rdr::InStream* is,
+                                const ServerParams& /*server*/,
+                                rdr::OutStream* os)
+{
+  uint8_t op;
+
+  if (!is->hasData(1 + 4))
+    return false;
+
+  op = is->readU8();
+
+  switch (op) {
+  case tileCacheStore:
+  case tileCacheDraw:
+    if ((r.width() > tileCacheTileSize) ||
+        (r.height() > tileCacheTileSize))
+      throw protocol_error("Tile cache rectangle too large");
+    break;
+  case tileCacheReset:
+    break;
+  default:
+    vlog.error("Unknown tile cache operation %d", (int)op);
+    throw protocol_error("Unknown tile cache operation");
+  }
+
+  os->writeU8(op);
+  os->copyBytes(is, 4);
+
+  return true;
+}
+
+void TileCacheDecoder::getAffectedRegion(const core::Rect& rect,
+                                         const uint8_t* buffer,
+                                         size_t /*buflen*/,
+                                         const ServerParams& /*server*/,
+                                         core::Region* region)
+{
+  // A reset doesn't touch the frame buffer
+  if (buffer[0] == tileCacheReset) {
+    region->clear();
+    return;
+  }
+
+  region->reset(rect);
+}
+
+void TileCacheDecoder::decodeRect(const core::Rect& r,
+                                  const uint8_t* buffer,
+                                  size_t buflen,
+                                  const ServerParams& /*server*/,
+                                  ModifiablePixelBuffer* pb)
+{
+  rdr::MemInStream is(buffer, buflen);
+  uint8_t op;
+  uint32_t id;
+
+  std::unordered_map<uint32_t, std::list<Tile>::iterator>::iterator iter;
+
+  op = is.readU8();
+  id = is.readU32();
+
+  switch (op) {
+  case tileCacheStore:
+    {
+      Tile tile;
+
+      if (maxTiles == 0)
+        throw protocol_error("Tile cache is not enabled");
+      if (cache.count(id) != 0)
+        throw protocol_error("Tile cache id already in use");
+
+      tile.id = id;
+      tile.width = r.width();
+      tile.height = r.height();
+      tile.pf = pb->getPF();
+      tile.data.resize(r.area() * (tile.pf.bpp/8));
+      pb->getImage(tile.data.data(), r);
+
+      // The server keeps the same order, so we'll evict the same tile
+      // as it did
+      if (lru.size() >= maxTiles) {
+        cache.erase(lru.back().id);
+        lru.pop_back();
+      }
+
+      lru.push_front(std::move(tile));
+      cache[id] = lru.begin();
+    }
+    break;
+  case tileCacheDraw:
+    iter = cache.find(id);
+    if (iter == cache.end()) {
+      vlog.error("Unknown tile cache id %u", (unsigned)id);
+      throw protocol_error("Unknown tile cache id");
+    }
+
+    if ((iter->second->width != r.width()) ||
+        (iter->second->height != r.height()))
+      throw protocol_error("Tile cache rectangle size mismatch");
+
+    lru.splice(lru.begin(), lru, iter->second);
+
+    pb->imageRect(iter->second->pf, r, iter->second->data.data());
+    break;
+  case tileCacheReset:
+    lru.clear();
+    cache.clear();
+    break;
+  }
+}
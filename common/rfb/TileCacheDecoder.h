@@ -0,0 +1,68 @@
+/* Copyright (C) 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+#ifndef __RFB_TILECACHEDECODER_H__
+#define __RFB_TILECACHEDECODER_H__
+
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+#include <rfb/Decoder.h>
+#include <rfb/PixelFormat.h>
+
+namespace rfb {
+
+  // TileCacheDecoder keeps the client side of the tile cache. Tiles
+  // are stored from, and drawn back on to, the frame buffer when the
+  // server asks for it. See TileCache for the server side.
+
+  class TileCacheDecoder : public Decoder {
+  public:
+    TileCacheDecoder();
+    virtual ~TileCacheDecoder();
+
+    // setMaxTiles() must not be called whilst rects are being decoded,
+    // and the limit may only grow, as the server assumes that every
+    // tile it has been told about is still there
+    void setMaxTiles(size_t tiles);
+
+    bool readRect(const core::Rect& r, rdr::InStream* is,
+                  const ServerParams& server,
+                  rdr::OutStream* os) override;
+    void getAffectedRegion(const core::Rect& rect, const uint8_t* buffer,
+                           size_t buflen, const ServerParams& server,
+                           core::Region* region) override;
+    void decodeRect(const core::Rect& r, const uint8_t* buffer,
+                    size_t buflen, const ServerParams& server,
+                    ModifiablePixelBuffer* pb) override;
+
+  private:
+    struct Tile {
+      uint32_t id;
+      int width, height;
+      PixelFormat pf;
+      std::vector<uint8_t> data;
+    };
+
+    size_t maxTiles;
+
+    std::list<Tile> lru;
+    std::unordered_map<uint32_t, std::list<Tile>::iterator> cache;
+  };
+}
+#endif
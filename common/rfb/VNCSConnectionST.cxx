@@ -32,6 +32,9 @@
 #include <rdr/FdOutStream.h>
 
 #include <network/TcpSocket.h>
+#ifndef WIN32
+#include <network/UnixSocket.h>
+#endif
 
 #include <rfb/ComparingUpdateTracker.h>
 #include <rfb/Encoder.h>
@@ -41,6 +44,7 @@
 #include <rfb/Security.h>
 #include <rfb/ServerCore.h>
 #include <rfb/SMsgWriter.h>
+#include <rfb/SharedMemory.h>
 #include <rfb/VNCServerST.h>
 #include <rfb/VNCSConnectionST.h>
 #include <rfb/encodings.h>
@@ -58,6 +62,13 @@ using namespace rfb;
 static const unsigned LOGIN_GRACE_TIME = 120;
 // Number of seconds allowed to flush a closing socket
 static const unsigned CLOSE_GRACE_TIME = 5;
+// Number of milliseconds to wait on a congested clipboard transfer
+static const unsigned CLIPBOARD_RETRY_TIME = 50;
+// Largest shared memory buffer given to a client
+static const size_t MAX_SHARED_MEMORY = 1024 * 1024 * 1024;
+// How long a client gets to attach to shared memory (in ms) before we
+// assume the descriptor never arrived and free it again
+static const unsigned SHARED_MEMORY_ATTACH_TIME = 5000;
 
 static core::LogWriter vlog("VNCSConnST");
 
@@ -70,13 +81,18 @@ VNCSConnectionST::VNCSConnectionST(VNCServerST* server_, network::Socket *s,
     inProcessMessages(false),
     pendingSyncFence(false), syncFence(false), fenceFlags(0),
     fenceDataLen(0), fenceData(nullptr), congestionTimer(this),
-    losslessTimer(this), server(server_),
+    losslessTimer(this), rateTimer(this), clipboardTimer(this),
+    server(server_),
     updateRenderedCursor(false), removeRenderedCursor(false),
-    continuousUpdates(false), encodeManager(this), idleTimer(this),
+    continuousUpdates(false), encodeManager(this),
+    sharedMemoryFailed(false), sharedMemoryTimer(this), idleTimer(this),
     pointerEventTime(0), clientHasCursor(false)
 {
   socketTimer.start(core::secsToMillis(LOGIN_GRACE_TIME));
 
+  timerclear(&pendingDamage);
+  timerclear(&lastUpdate);
+
   setStreams(&sock->inStream(), &sock->outStream());
   peerEndpoint = sock->getPeerEndpoint();
 }
@@ -89,6 +105,8 @@ VNCSConnectionST::~VNCSConnectionST()
     vlog.info("Closing %s: %s", peerEndpoint.c_str(),
               closeReason.c_str());
 
+  logLatencyStats();
+
   // Release any keys the client still had pressed
   while (!pressedKeys.empty()) {
     uint32_t keysym, keycode;
@@ -219,6 +237,7 @@ void VNCSConnectionST::processSocketWriteEvent()
   if (state() == RFBSTATE_CLOSING) return;
   try {
     sock->outStream().flush();
+    traceWritten();
     // Flushing the socket might release an update that was previously
     // delayed because of congestion.
     if (!sock->outStream().hasBufferedData())
@@ -361,6 +380,11 @@ void VNCSConnectionST::sendClipboardDataOrClose(const char* data)
   try {
     if (state() != RFBSTATE_NORMAL) return;
     sendClipboardData(data);
+    // Large transfers are compressed in the background
+    if (isClipboardPending())
+      clipboardTimer.start(0);
+    else
+      clipboardTimer.stop();
   } catch(std::exception& e) {
     close(e.what());
   }
@@ -758,6 +782,9 @@ void VNCSConnectionST::fence(uint32_t flags, unsigned len, const uint8_t data[])
   case 1:
     congestion.gotPong();
     break;
+  case 2:
+    handleLatencyMarker();
+    break;
   default:
     vlog.error("Fence response of unexpected type received");
   }
@@ -849,16 +876,51 @@ void VNCSConnectionST::handleTimeout(core::Timer* t)
 
   try {
     if ((t == &congestionTimer) ||
-        (t == &losslessTimer))
+        (t == &losslessTimer) ||
+        (t == &rateTimer))
       writeFramebufferUpdate();
+    if (t == &clipboardTimer)
+      handleClipboardTimeout();
   } catch (std::exception& e) {
     close(e.what());
   }
 
+  if (t == &sharedMemoryTimer)
+    handleSharedMemoryTimeout();
+
   if (t == &idleTimer)
     close("Idle timeout");
 }
 
+void VNCSConnectionST::handleClipboardTimeout()
+{
+  // The transfer might have been replaced or aborted
+  if (!isClipboardPending())
+    return;
+
+  // Compress a single chunk at a time so that framebuffer updates and
+  // input can be handled in between
+  if (!compressClipboard()) {
+    clipboardTimer.start(0);
+    return;
+  }
+
+  // Only add another piece once the previous ones have made it out,
+  // so that the transfer doesn't fill up the pipe
+  if (isCongested()) {
+    clipboardTimer.start(CLIPBOARD_RETRY_TIME);
+    return;
+  }
+
+  if (!writeClipboard()) {
+    clipboardTimer.start(0);
+    return;
+  }
+
+  // Updates are held back whilst the message is being written
+  writeFramebufferUpdate();
+}
+
 bool VNCSConnectionST::isShiftPressed()
 {
     std::map<uint32_t, uint32_t>::const_iterator iter;
@@ -892,6 +954,100 @@ void VNCSConnectionST::writeRTTPing()
   congestion.sentPing();
 }
 
+void VNCSConnectionST::traceDamage(const struct timeval* when)
+{
+  if (!timerisset(&pendingDamage))
+    pendingDamage = *when;
+}
+
+void VNCSConnectionST::writeLatencyMarker()
+{
+  FrameTrace trace;
+  uint8_t type;
+
+  if (!client.supportsFence())
+    return;
+
+  encodeManager.getEncodeTime(&trace.encodeStart, &trace.encodeEnd);
+
+  // Updates without any screen changes, e.g. a rendered cursor that
+  // moved, have no waiting time
+  if (timerisset(&pendingDamage))
+    trace.damage = pendingDamage;
+  else
+    trace.damage = trace.encodeStart;
+  timerclear(&pendingDamage);
+
+  timerclear(&trace.written);
+
+  // The client will not respond until it has processed the update
+  type = 2;
+  writer()->writeFence(fenceFlagRequest | fenceFlagBlockBefore,
+                       sizeof(type), &type);
+
+  frameTraces.push_back(trace);
+}
+
+void VNCSConnectionST::handleLatencyMarker()
+{
+  FrameTrace trace;
+  struct timeval now;
+
+  if (frameTraces.empty()) {
+    vlog.error("Unexpected latency marker received");
+    return;
+  }
+
+  gettimeofday(&now, nullptr);
+
+  trace = frameTraces.front();
+  frameTraces.pop_front();
+
+  if (!timerisset(&trace.written))
+    trace.written = now;
+
+  waitLatency.addInterval(&trace.damage, &trace.encodeStart);
+  encodeLatency.addInterval(&trace.encodeStart, &trace.encodeEnd);
+  sendLatency.addInterval(&trace.encodeEnd, &trace.written);
+  clientLatency.addInterval(&trace.written, &now);
+  totalLatency.addInterval(&trace.damage, &now);
+}
+
+// traceWritten() notes the moment traced updates have been handed to
+// the operating system. Time spent in the socket buffers of either end
+// is therefore included in the client part of the latency.
+
+void VNCSConnectionST::traceWritten()
+{
+  struct timeval now;
+
+  if (frameTraces.empty())
+    return;
+
+  if (sock->outStream().hasBufferedData())
+    return;
+
+  gettimeofday(&now, nullptr);
+
+  for (FrameTrace& trace : frameTraces) {
+    if (!timerisset(&trace.written))
+      trace.written = now;
+  }
+}
+
+void VNCSConnectionST::logLatencyStats()
+{
+  if (totalLatency.getCount() == 0)
+    return;
+
+  vlog.info("Update latency for %s:", peerEndpoint.c_str());
+  waitLatency.logStats(&vlog, "Waiting");
+  encodeLatency.logStats(&vlog, "Encoding");
+  sendLatency.logStats(&vlog, "Sending");
+  clientLatency.logStats(&vlog, "Client");
+  totalLatency.logStats(&vlog, "Total");
+}
+
 bool VNCSConnectionST::isCongested()
 {
   int eta;
@@ -901,6 +1057,7 @@ bool VNCSConnectionST::isCongested()
   // Stuff still waiting in the send buffer?
   sock->outStream().flush();
   congestion.debugTrace("congestion-trace.csv", sock->getFd());
+  traceWritten();
   if (sock->outStream().hasBufferedData())
     return true;
 
@@ -918,9 +1075,65 @@ bool VNCSConnectionST::isCongested()
   return true;
 }
 
+bool VNCSConnectionST::isRateLimited()
+{
+  int next;
+
+  rateTimer.stop();
+
+  next = msToNextUpdate();
+  if (next <= 0)
+    return false;
+
+  rateTimer.start(next);
+
+  return true;
+}
+
+int VNCSConnectionST::msToNextUpdate()
+{
+  struct timeval start, end;
+  int interval, encodeTime, queueTime, elapsed;
+
+  if (!timerisset(&lastUpdate))
+    return 0;
+
+  interval = 1000/Server::frameRate;
+
+  // Don't let encoding for this client take more than half the time,
+  // so there is some left for other clients and the application
+  encodeManager.getEncodeTime(&start, &end);
+  encodeTime = core::msBetween(&start, &end);
+  if (encodeTime * 2 > interval)
+    interval = encodeTime * 2;
+
+  // If updates are queueing up on the way to the client, then sending
+  // them more often than the queue drains only makes it grow
+  if ((congestion.getRTT() != 0) && (congestion.getBaseRTT() != 0)) {
+    queueTime = (int)congestion.getRTT() - (int)congestion.getBaseRTT();
+    if (queueTime > interval)
+      interval = queueTime;
+  }
+
+  elapsed = core::msSince(&lastUpdate);
+  if (elapsed >= interval)
+    return 0;
+
+  return interval - elapsed;
+}
+
+bool VNCSConnectionST::isRequestingUpdates()
+{
+  if (state() != RFBSTATE_NORMAL)
+    return false;
+
+  return !requested.is_empty() || continuousUpdates;
+}
 
 void VNCSConnectionST::writeFramebufferUpdate()
 {
+  bool rateLimited;
+
   congestion.updatePosition(sock->outStream().length());
 
   // We're in the middle of processing a command that's supposed to be
@@ -940,11 +1153,23 @@ void VNCSConnectionST::writeFramebufferUpdate()
   if (requested.is_empty() && !continuousUpdates)
     return;
 
+  // A large clipboard message is being written a piece at a time, and
+  // the encoders can't be kept from writing in the middle of it
+  if (writer()->isClipboardInProgress())
+    return;
+
   // Check that we actually have some space on the link and retry in a
   // bit if things are congested.
   if (isCongested())
     return;
 
+  // Nor should we send updates more often than the client can make
+  // use of them. Updates without pixel data, e.g. a new cursor shape
+  // or desktop size, are cheap and shouldn't be held back, though.
+  rateLimited = isRateLimited();
+  if (rateLimited && !writer()->needFakeUpdate())
+    return;
+
   // Updates often consists of many small writes, and in continuous
   // mode, we will also have small fence messages around the update. We
   // need to aggregate these in order to not clog up TCP's congestion
@@ -956,10 +1181,15 @@ void VNCSConnectionST::writeFramebufferUpdate()
   writeNoDataUpdate();
 
   // Then real data (if possible)
-  writeDataUpdate();
+  if (rateLimited)
+    writeFakeUpdate();
+  else
+    writeDataUpdate();
 
   getOutStream()->cork(false);
 
+  traceWritten();
+
   congestion.updatePosition(sock->outStream().length());
 }
 
@@ -974,6 +1204,20 @@ void VNCSConnectionST::writeNoDataUpdate()
   requested.clear();
 }
 
+void VNCSConnectionST::writeFakeUpdate()
+{
+  if (!writer()->needFakeUpdate())
+    return;
+  if (requested.is_empty() && !continuousUpdates)
+    return;
+
+  // Only the pseudo rects, as the pixels have to wait
+  writer()->writeFramebufferUpdateStart(0);
+  writer()->writeFramebufferUpdateEnd();
+
+  requested.clear();
+}
+
 void VNCSConnectionST::writeDataUpdate()
 {
   core::Region req;
@@ -1075,10 +1319,22 @@ void VNCSConnectionST::writeDataUpdate()
 
   writeRTTPing();
 
+  if (Server::adaptiveQuality)
+    encodeManager.adaptQuality(&congestion, 1000/Server::frameRate);
+  if (Server::adaptiveEncoders)
+    encodeManager.setBandwidth(congestion.getBandwidth());
+
+  prepareSharedMemory();
+
   encodeManager.writeUpdate(ui, server->getPixelBuffer(), cursor);
 
+  gettimeofday(&lastUpdate, nullptr);
+
   writeRTTPing();
 
+  if (Server::latencyTrace)
+    writeLatencyMarker();
+
   // The request might be for just part of the screen, so we cannot
   // just clear the entire update tracker.
   updates.subtract(req);
@@ -1152,7 +1408,8 @@ void VNCSConnectionST::writeLosslessRefresh()
 
   writeRTTPing();
 
-  encodeManager.writeLosslessRefresh(req, server->getPixelBuffer(),
+  encodeManager.writeLosslessRefresh(req, server->getFocusAreas(),
+                                     server->getPixelBuffer(),
                                      cursor, maxUpdateSize);
 
   writeRTTPing();
@@ -1161,6 +1418,86 @@ void VNCSConnectionST::writeLosslessRefresh()
 }
 
 
+void VNCSConnectionST::prepareSharedMemory()
+{
+  const SharedMemory* current;
+  SharedMemory* shm;
+  size_t size;
+
+  if (!Server::sharedMemory || sharedMemoryFailed)
+    return;
+
+  if (!SharedMemory::isSupported())
+    return;
+
+  if (!client.supportsEncoding(encodingSharedMemory) ||
+      !client.supportsEncoding(pseudoEncodingSharedMemory) ||
+      !client.supportsEncoding(pseudoEncodingLastRect))
+    return;
+
+  // The buffer is passed as a file descriptor, which only works for
+  // clients on the same host
+#ifndef WIN32
+  if (dynamic_cast<network::UnixSocket*>(sock) == nullptr)
+    return;
+#else
+  return;
+#endif
+
+  // Room for two full screens, so that the client doesn't hold us
+  // back whilst it is drawing the previous update
+  size = (size_t)server->getPixelBuffer()->width() *
+         server->getPixelBuffer()->height() * 4 * 2;
+  if (size > MAX_SHARED_MEMORY)
+    size = MAX_SHARED_MEMORY;
+
+  current = encodeManager.getSharedMemory();
+  if ((current != nullptr) && (current->getSize() >= size))
+    return;
+
+  try {
+    shm = new SharedMemory(size);
+  } catch (std::exception& e) {
+    vlog.error("Unable to create shared memory: %s", e.what());
+    sharedMemoryFailed = true;
+    return;
+  }
+
+  // The descriptor arrives before the update that announces it
+  try {
+    sock->outStream().sendFd(shm->getFd());
+  } catch (std::exception& e) {
+    vlog.error("Unable to pass shared memory: %s", e.what());
+    sharedMemoryFailed = true;
+    delete shm;
+    return;
+  }
+
+  vlog.debug("Passing %s of shared memory to %s",
+             core::iecPrefix(size, "B").c_str(), peerEndpoint.c_str());
+
+  encodeManager.setSharedMemory(shm);
+
+  sharedMemoryTimer.start(SHARED_MEMORY_ATTACH_TIME);
+}
+
+void VNCSConnectionST::handleSharedMemoryTimeout()
+{
+  const SharedMemory* current;
+
+  current = encodeManager.getSharedMemory();
+  if ((current == nullptr) || current->isAttached())
+    return;
+
+  // Most likely the socket is forwarded somewhere that cannot pass
+  // descriptors, so there is no point in trying again
+  vlog.info("Client %s did not attach to shared memory, using normal "
+            "encodings", peerEndpoint.c_str());
+
+  encodeManager.setSharedMemory(nullptr);
+  sharedMemoryFailed = true;
+}
+
 void VNCSConnectionST::screenLayoutChange(uint16_t reason)
 {
   if (state() != RFBSTATE_NORMAL)
@@ -27,12 +27,14 @@
 #ifndef __RFB_VNCSCONNECTIONST_H__
 #define __RFB_VNCSCONNECTIONST_H__
 
+#include <list>
 #include <map>
 
 #include <core/Timer.h>
 
 #include <rfb/Congestion.h>
 #include <rfb/EncodeManager.h>
+#include <rfb/LatencyStats.h>
 #include <rfb/SConnection.h>
 
 namespace rfb {
@@ -108,6 +110,15 @@ namespace rfb {
     // or because the current cursor position has not been set by this client.
     bool needRenderedCursor();
 
+    // msToNextUpdate() returns how long until this client is ready for
+    // another update, based on how quickly we can encode and send
+    // updates for it
+    int msToNextUpdate();
+
+    // isRequestingUpdates() returns true if the client has asked for an
+    // update that we haven't sent yet, or wants updates continuously
+    bool isRequestingUpdates();
+
     network::Socket* getSock() { return sock; }
 
     // Change tracking
@@ -117,6 +128,10 @@ namespace rfb {
       updates.add_copied(dest, delta);
     }
 
+    // traceDamage() records when the changes about to be added first
+    // appeared, if latency tracing is enabled
+    void traceDamage(const struct timeval* when);
+
     const char* getPeerEndpoint() const {return peerEndpoint.c_str();}
 
   private:
@@ -150,6 +165,9 @@ namespace rfb {
     // Timer callbacks
     void handleTimeout(core::Timer* t) override;
 
+    void handleClipboardTimeout();
+    void handleSharedMemoryTimeout();
+
     // Internal methods
 
     bool isShiftPressed();
@@ -157,15 +175,28 @@ namespace rfb {
     // Congestion control
     void writeRTTPing();
     bool isCongested();
+    bool isRateLimited();
+
+    // Latency tracing
+    void writeLatencyMarker();
+    void handleLatencyMarker();
+    void traceWritten();
+    void logLatencyStats();
 
     // writeFramebufferUpdate() attempts to write a framebuffer update to the
     // client.
 
     void writeFramebufferUpdate();
     void writeNoDataUpdate();
+    void writeFakeUpdate();
     void writeDataUpdate();
     void writeLosslessRefresh();
 
+    // prepareSharedMemory() passes a new shared memory buffer to a
+    // client on the same host, if it can use one and doesn't have a
+    // large enough one already
+    void prepareSharedMemory();
+
     void screenLayoutChange(uint16_t reason);
     void setCursor();
     void setCursorPos();
@@ -189,6 +220,22 @@ namespace rfb {
     Congestion congestion;
     core::Timer congestionTimer;
     core::Timer losslessTimer;
+    core::Timer rateTimer;
+    struct timeval lastUpdate;
+
+    core::Timer clipboardTimer;
+
+    struct FrameTrace {
+      struct timeval damage;
+      struct timeval encodeStart;
+      struct timeval encodeEnd;
+      struct timeval written;
+    };
+
+    struct timeval pendingDamage;
+    std::list<FrameTrace> frameTraces;
+    LatencyStats waitLatency, encodeLatency, sendLatency;
+    LatencyStats clientLatency, totalLatency;
 
     VNCServerST* server;
     SimpleUpdateTracker updates;
@@ -198,6 +245,8 @@ namespace rfb {
     bool continuousUpdates;
     core::Region cuRegion;
     EncodeManager encodeManager;
+    bool sharedMemoryFailed;
+    core::Timer sharedMemoryTimer;
 
     std::map<uint32_t, uint32_t> pressedKeys;
 
@@ -84,6 +84,13 @@ namespace rfb {
     virtual uint64_t getMsc() = 0;
     virtual void queueMsc(uint64_t target) = 0;
 
+    // frameComplete() tells the server that an application has just
+    // finished drawing a frame in the given region. Pending changes are
+    // then sent right away, and further changes within that region will
+    // preferably wait for the next such boundary rather than be sent
+    // half drawn.
+    virtual void frameComplete(const core::Region& region) = 0;
+
     // setPixelBuffer() tells the server to use the given pixel buffer (and
     // optionally a modified screen layout).  If this differs in size from
     // the previous pixel buffer, this may result in protocol messages being
@@ -54,6 +54,7 @@
 
 #include <assert.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <core/LogWriter.h>
 #include <core/time.h>
@@ -68,6 +69,7 @@
 #include <rfb/SDesktop.h>
 #include <rfb/Security.h>
 #include <rfb/ServerCore.h>
+#include <rfb/SessionRecorder.h>
 #include <rfb/VNCServerST.h>
 #include <rfb/VNCSConnectionST.h>
 #include <rfb/ledStates.h>
@@ -78,6 +80,23 @@ using namespace rfb;
 static core::LogWriter slog("VNCServerST");
 static core::LogWriter connectionsLog("Connections");
 
+// How long to wait for more changes before sending them to clients
+// (in ms), as applications rarely draw everything in one go
+static const int UpdateCoalesceTime = 4;
+
+// Size of the area around the pointer that we consider in focus
+static const int FocusPointerSize = 256;
+
+// How long after a key press changes are considered a result of it (in
+// ms), and how large such changes may be
+static const unsigned FocusKeyEchoTime = 500;
+static const int FocusKeyEchoMaxArea = 256 * 256;
+
+// How many areas we keep track of, and when we forget about them after
+// the user has stopped interacting (in ms)
+static const size_t FocusMaxAreas = 8;
+static const unsigned FocusTimeout = 10000;
+
 //
 // -=- VNCServerST Implementation
 //
@@ -93,10 +112,21 @@ VNCServerST::VNCServerST(const char* name_, SDesktop* desktop_)
     renderedCursorInvalid(false),
     keyRemapper(&KeyRemapper::defInstance),
     idleTimer(this), disconnectTimer(this), connectTimer(this),
-    msc(0), queuedMsc(0), frameTimer(this)
+    msc(0), queuedMsc(0), frameTimer(this), updateTimer(this),
+    recorder(nullptr)
 {
   slog.debug("Creating single-threaded server %s", name.c_str());
 
+  timerclear(&damageTime);
+  timerclear(&frameCompleteTime);
+  timerclear(&focusTime);
+  timerclear(&keyTime);
+
+  if (strlen(rfb::Server::recordSession) > 0)
+    recorder = new SessionRecorder(rfb::Server::recordSession,
+                                   (size_t)rfb::Server::recordRotateSize *
+                                   1024 * 1024);
+
   desktop_->init(this);
 
   // FIXME: Do we really want to kick off these right away?
@@ -131,6 +161,8 @@ VNCServerST::~VNCServerST()
     comparer->logStats();
   delete comparer;
 
+  delete recorder;
+
   delete cursor;
 }
 
@@ -249,6 +281,7 @@ void VNCServerST::blockUpdates()
   blockCounter++;
 
   stopFrameClock();
+  updateTimer.stop();
 }
 
 void VNCServerST::unblockUpdates()
@@ -258,8 +291,10 @@ void VNCServerST::unblockUpdates()
   blockCounter--;
 
   // Restart the frame clock in case we have updates
-  if (blockCounter == 0)
+  if (blockCounter == 0) {
     startFrameClock();
+    scheduleUpdate();
+  }
 }
 
 uint64_t VNCServerST::getMsc()
@@ -275,6 +310,27 @@ void VNCServerST::queueMsc(uint64_t target)
   startFrameClock();
 }
 
+void VNCServerST::frameComplete(const core::Region& region)
+{
+  // Several applications can be presenting at the same time
+  if (isFrameSynced())
+    frameRegion.assign_union(region);
+  else
+    frameRegion = region;
+
+  gettimeofday(&frameCompleteTime, nullptr);
+
+  if (blockCounter > 0)
+    return;
+  if (!desktopStarted)
+    return;
+  if ((comparer == nullptr) || comparer->is_empty())
+    return;
+
+  // The frame is whole now, so no point in waiting any longer
+  updateTimer.start(msToClientsReady());
+}
+
 void VNCServerST::setPixelBuffer(PixelBuffer* pb_, const ScreenSet& layout)
 {
   if (comparer)
@@ -464,7 +520,14 @@ void VNCServerST::add_changed(const core::Region& region)
     return;
 
   comparer->add_changed(region);
+
+  if (rfb::Server::latencyTrace && !timerisset(&damageTime))
+    gettimeofday(&damageTime, nullptr);
+
+  checkFrameSync(region);
+
   startFrameClock();
+  scheduleUpdate();
 }
 
 void VNCServerST::add_copied(const core::Region& dest,
@@ -474,7 +537,14 @@ void VNCServerST::add_copied(const core::Region& dest,
     return;
 
   comparer->add_copied(dest, delta);
+
+  if (rfb::Server::latencyTrace && !timerisset(&damageTime))
+    gettimeofday(&damageTime, nullptr);
+
+  checkFrameSync(dest);
+
   startFrameClock();
+  scheduleUpdate();
 }
 
 void VNCServerST::setCursor(int width, int height,
@@ -542,6 +612,9 @@ void VNCServerST::keyEvent(uint32_t keysym, uint32_t keycode, bool down)
     }
   }
 
+  if (down)
+    gettimeofday(&keyTime, nullptr);
+
   desktop->keyEvent(keysym, keycode, down);
 }
 
@@ -570,6 +643,9 @@ void VNCServerST::pointerEvent(VNCSConnectionST* client,
   else
     pointerClient = nullptr;
 
+  addFocusArea({pos.x - FocusPointerSize / 2, pos.y - FocusPointerSize / 2,
+                pos.x + FocusPointerSize / 2, pos.y + FocusPointerSize / 2});
+
   desktop->pointerEvent(pos, buttonMask);
 }
 
@@ -717,12 +793,12 @@ void VNCServerST::handleTimeout(core::Timer* t)
 
     frameTimer.repeat(timeout);
 
+    msc++;
+    desktop->frameTick(msc);
+  } else if (t == &updateTimer) {
     if (desktopStarted &&
         ((comparer != nullptr) && !comparer->is_empty()))
       writeUpdate();
-
-    msc++;
-    desktop->frameTick(msc);
   } else if (t == &idleTimer) {
     slog.info("MaxIdleTime reached, exiting");
     desktop->terminate();
@@ -868,23 +944,107 @@ void VNCServerST::stopFrameClock()
   frameTimer.stop();
 }
 
+// scheduleUpdate() arranges for pending changes to be sent as soon as
+// any client is ready to receive them. Clients that aren't ready yet
+// will get the changes once their own rate limit allows it.
+
+void VNCServerST::scheduleUpdate()
+{
+  int timeout;
+
+  if (updateTimer.isStarted())
+    return;
+  if (blockCounter > 0)
+    return;
+  if (!desktopStarted)
+    return;
+  if ((comparer == nullptr) || comparer->is_empty())
+    return;
+
+  timeout = msToClientsReady();
+
+  // If an application is marking its frames for us, then give it a
+  // full frame to finish rather than sending something half drawn
+  if (isFrameSynced()) {
+    if (timeout < 1000/rfb::Server::frameRate)
+      timeout = 1000/rfb::Server::frameRate;
+  } else {
+    if (timeout < UpdateCoalesceTime)
+      timeout = UpdateCoalesceTime;
+  }
+
+  updateTimer.start(timeout);
+}
+
+// isFrameSynced() is true if an application has recently marked the
+// end of a frame, and is likely to do so again soon
+
+bool VNCServerST::isFrameSynced()
+{
+  if (!timerisset(&frameCompleteTime))
+    return false;
+
+  return core::msSince(&frameCompleteTime) <
+         (unsigned)rfb::Server::frameSyncTimeout;
+}
+
+// checkFrameSync() stops waiting for whole frames as soon as something
+// outside of the presented area changes, as those changes have no
+// frame boundary that we know of
+
+void VNCServerST::checkFrameSync(const core::Region& region)
+{
+  if (!timerisset(&frameCompleteTime))
+    return;
+  if (region.subtract(frameRegion).is_empty())
+    return;
+
+  timerclear(&frameCompleteTime);
+  frameRegion.clear();
+
+  // Might be holding back changes for a whole frame
+  updateTimer.stop();
+}
+
+int VNCServerST::msToClientsReady()
+{
+  int timeout;
+
+  timeout = 1000/rfb::Server::frameRate;
+  for (VNCSConnectionST* client : clients) {
+    int next;
+
+    // A client that isn't asking for anything will get the changes
+    // once it does, so it shouldn't make everyone else wait less
+    if (!client->isRequestingUpdates())
+      continue;
+
+    next = client->msToNextUpdate();
+    if (next < timeout)
+      timeout = next;
+  }
+
+  return timeout;
+}
+
 int VNCServerST::msToNextUpdate()
 {
   // FIXME: If the application is updating slower than frameRate then
   //        we could allow the clients more time here
 
-  if (!frameTimer.isStarted())
+  if (!updateTimer.isStarted())
     return 1000/rfb::Server::frameRate/2;
   else
-    return frameTimer.getRemainingMs();
+    return updateTimer.getRemainingMs();
 }
 
-// writeUpdate() is called on a regular interval in order to see what
-// updates are pending and propagates them to the update tracker for
-// each client. It uses the ComparingUpdateTracker's compare() method
-// to filter out areas of the screen which haven't actually changed. It
-// also checks the state of the (server-side) rendered cursor, if
-// necessary rendering it again with the correct background.
+// writeUpdate() is called once changes have been scheduled to be sent
+// in order to see what updates are pending and propagates them to the
+// update tracker for each client. It uses the ComparingUpdateTracker's
+// compare() method to filter out areas of the screen which haven't
+// actually changed. It also checks the state of the (server-side)
+// rendered cursor, if necessary rendering it again with the correct
+// background.
 
 void VNCServerST::writeUpdate()
 {
@@ -916,16 +1076,69 @@ void VNCServerST::writeUpdate()
   else
     comparer->disable();
 
+  comparer->setDetectScroll(rfb::Server::detectScroll);
+
   if (comparer->compare())
     comparer->getUpdateInfo(&ui, pb->getRect());
 
   comparer->clear();
 
+  // Small changes right after a key press are most likely the result
+  // of typing, so that is probably where the user is looking
+  if (timerisset(&keyTime) && (core::msSince(&keyTime) < FocusKeyEchoTime)) {
+    core::Rect bounds;
+
+    bounds = ui.changed.get_bounding_rect();
+    if (!bounds.is_empty() && (bounds.area() <= FocusKeyEchoMaxArea))
+      addFocusArea(bounds);
+  }
+
+  if (recorder != nullptr) {
+    if (!recorder->writeUpdate(ui, pb, name.c_str())) {
+      slog.error("Session recording stopped");
+      delete recorder;
+      recorder = nullptr;
+    }
+  }
+
   for (ci = clients.begin(); ci != clients.end(); ++ci) {
+    if (timerisset(&damageTime) && !ui.is_empty())
+      (*ci)->traceDamage(&damageTime);
     (*ci)->add_copied(ui.copied, ui.copy_delta);
     (*ci)->add_changed(ui.changed);
     (*ci)->writeFramebufferUpdateOrClose();
   }
+
+  timerclear(&damageTime);
+}
+
+const std::vector<core::Rect>& VNCServerST::getFocusAreas()
+{
+  if (!focusAreas.empty() && (core::msSince(&focusTime) > FocusTimeout))
+    focusAreas.clear();
+
+  return focusAreas;
+}
+
+void VNCServerST::addFocusArea(const core::Rect& rect)
+{
+  std::vector<core::Rect>::iterator iter;
+
+  gettimeofday(&focusTime, nullptr);
+
+  // Anything overlapping is replaced by the new area, so that e.g. a
+  // moving pointer doesn't push out everything else
+  iter = focusAreas.begin();
+  while (iter != focusAreas.end()) {
+    if (iter->overlaps(rect))
+      iter = focusAreas.erase(iter);
+    else
+      ++iter;
+  }
+
+  focusAreas.insert(focusAreas.begin(), rect);
+  if (focusAreas.size() > FocusMaxAreas)
+    focusAreas.pop_back();
 }
 
 // checkUpdate() is called by clients to see if it is safe to read from
@@ -24,6 +24,8 @@
 #ifndef __RFB_VNCSERVERST_H__
 #define __RFB_VNCSERVERST_H__
 
+#include <vector>
+
 #include <sys/time.h>
 
 #include <core/Timer.h>
@@ -41,6 +43,7 @@ namespace rfb {
   class PixelBuffer;
   class KeyRemapper;
   class SDesktop;
+  class SessionRecorder;
 
   class VNCServerST : public VNCServer,
                       public core::Timer::Callback {
@@ -82,6 +85,7 @@ namespace rfb {
     void unblockUpdates() override;
     uint64_t getMsc() override;
     void queueMsc(uint64_t target) override;
+    void frameComplete(const core::Region& region) override;
     void setPixelBuffer(PixelBuffer* pb, const ScreenSet& layout) override;
     void setPixelBuffer(PixelBuffer* pb) override;
     void setScreenLayout(const ScreenSet& layout) override;
@@ -156,6 +160,10 @@ namespace rfb {
     // side rendered cursor buffer
     const RenderedCursor* getRenderedCursor();
 
+    // getFocusAreas() returns the areas the user has recently
+    // interacted with, most recent first
+    const std::vector<core::Rect>& getFocusAreas();
+
   protected:
 
     // Timer callbacks
@@ -174,10 +182,16 @@ namespace rfb {
     bool needRenderedCursor();
     void startFrameClock();
     void stopFrameClock();
+    void scheduleUpdate();
+    int msToClientsReady();
+    bool isFrameSynced();
+    void checkFrameSync(const core::Region& region);
     void writeUpdate();
 
     bool getComparerState();
 
+    void addFocusArea(const core::Rect& rect);
+
   protected:
     Blacklist blacklist;
 
@@ -213,6 +227,19 @@ namespace rfb {
 
     uint64_t msc, queuedMsc;
     core::Timer frameTimer;
+    core::Timer updateTimer;
+    struct timeval frameCompleteTime;
+    core::Region frameRegion;
+
+    // When the oldest change not yet sent to clients arrived, if
+    // latency tracing is enabled
+    struct timeval damageTime;
+
+    SessionRecorder* recorder;
+
+    std::vector<core::Rect> focusAreas;
+    struct timeval focusTime;
+    struct timeval keyTime;
   };
 
 };
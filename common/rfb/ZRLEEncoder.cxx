@@ -21,6 +21,8 @@
 #include <config.h>
 #endif
 
+#include <string.h>
+
 #include <core/Configuration.h>
 #include <core/LogWriter.h>
 
@@ -240,6 +242,7 @@ void ZRLEEncoder::writePixels(const uint8_t* buffer, const PixelFormat& pf,
 {
   Pixel maxPixel;
   uint8_t pixBuf[4];
+  uint8_t* out;
 
   maxPixel = pf.pixelFromRGB((uint16_t)-1, (uint16_t)-1, (uint16_t)-1);
   pf.bufferFromPixel(pixBuf, maxPixel);
@@ -252,10 +255,32 @@ void ZRLEEncoder::writePixels(const uint8_t* buffer, const PixelFormat& pf,
   if (pixBuf[0] == 0)
     buffer++;
 
-  while (count--) {
-    zos.writeBytes(buffer, 3);
+  out = zos.getptr(count * 3);
+  for (unsigned int i = 0; i < count; i++) {
+    memcpy(out, buffer, 3);
+    out += 3;
     buffer += 4;
   }
+  zos.setptr(count * 3);
+}
+
+static inline uint8_t* writeRun(uint8_t* out, uint8_t index,
+                                int runLength)
+{
+  if (runLength == 1) {
+    *out++ = index;
+    return out;
+  }
+
+  *out++ = index | 0x80;
+
+  while (runLength > 255) {
+    *out++ = 255;
+    runLength -= 255;
+  }
+  *out++ = runLength - 1;
+
+  return out;
 }
 
 template<class T>
@@ -270,6 +295,11 @@ void ZRLEEncoder::writePaletteTile(int width, int height,
 
   int bppp;
   int pad;
+  int rowBytes;
+  uint8_t* out;
+
+  T prevPix;
+  uint8_t prevIndex;
 
   assert(palette.size() > 1);
   assert(palette.size() <= 16);
@@ -280,6 +310,15 @@ void ZRLEEncoder::writePaletteTile(int width, int height,
   bppp = bitsPerPackedPixel[palette.size()-1];
   pad = stride - width;
 
+  // The packed pixels are written directly in to the stream's buffer
+  rowBytes = (width * bppp + 7) / 8;
+  out = zos.getptr(rowBytes * height);
+
+  // Neighbouring pixels are usually the same, so avoid looking up
+  // every pixel in the palette
+  prevPix = *buffer;
+  prevIndex = palette.lookup(prevPix);
+
   for (int i = 0; i < height; i++) {
     int w;
 
@@ -289,21 +328,26 @@ void ZRLEEncoder::writePaletteTile(int width, int height,
     w = width;
     while (w--) {
       T pix = *buffer++;
-      uint8_t index = palette.lookup(pix);
-      byte = (byte << bppp) | index;
+      if (pix != prevPix) {
+        prevPix = pix;
+        prevIndex = palette.lookup(pix);
+      }
+      byte = (byte << bppp) | prevIndex;
       nbits += bppp;
       if (nbits >= 8) {
-        zos.writeU8(byte);
+        *out++ = byte;
         nbits = 0;
       }
     }
     if (nbits > 0) {
       byte <<= 8 - nbits;
-      zos.writeU8(byte);
+      *out++ = byte;
     }
 
     buffer += pad;
   }
+
+  zos.setptr(rowBytes * height);
 }
 
 template<class T>
@@ -313,6 +357,8 @@ void ZRLEEncoder::writePaletteRLETile(int width, int height,
                                       const Palette& palette)
 {
   int pad;
+  uint8_t* out;
+  uint8_t* start;
 
   T prevColour;
   int runLength;
@@ -325,6 +371,11 @@ void ZRLEEncoder::writePaletteRLETile(int width, int height,
 
   pad = stride - width;
 
+  // Every run is at least as long as its encoding, so this is enough
+  // space for the whole tile
+  out = zos.getptr(width * height);
+  start = out;
+
   prevColour = *buffer;
   runLength = 0;
 
@@ -332,18 +383,7 @@ void ZRLEEncoder::writePaletteRLETile(int width, int height,
     int w = width;
     while (w--) {
       if (prevColour != *buffer) {
-        if (runLength == 1)
-          zos.writeU8(palette.lookup(prevColour));
-        else {
-          zos.writeU8(palette.lookup(prevColour) | 0x80);
-
-          while (runLength > 255) {
-            zos.writeU8(255);
-            runLength -= 255;
-          }
-          zos.writeU8(runLength - 1);
-        }
-
+        out = writeRun(out, palette.lookup(prevColour), runLength);
         prevColour = *buffer;
         runLength = 0;
       }
@@ -353,15 +393,8 @@ void ZRLEEncoder::writePaletteRLETile(int width, int height,
     }
     buffer += pad;
   }
-  if (runLength == 1)
-    zos.writeU8(palette.lookup(prevColour));
-  else {
-    zos.writeU8(palette.lookup(prevColour) | 0x80);
-
-    while (runLength > 255) {
-      zos.writeU8(255);
-      runLength -= 255;
-    }
-    zos.writeU8(runLength - 1);
-  }
+
+  out = writeRun(out, palette.lookup(prevColour), runLength);
+
+  zos.setptr(out - start);
 }
@@ -49,6 +49,8 @@ const char* rfb::encodingName(int num)
   case encodingTight:    return "Tight";
   case encodingJPEG:     return "JPEG";
   case encodingH264:     return "H.264";
+  case encodingTileCache: return "TileCache";
+  case encodingSharedMemory: return "SharedMemory";
   default:               return "[unknown encoding]";
   }
 }
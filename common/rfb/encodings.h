@@ -30,6 +30,8 @@ namespace rfb {
   const int encodingZRLE = 16;
   const int encodingJPEG = 21;
   const int encodingH264 = 50;
+  const int encodingTileCache = 96;
+  const int encodingSharedMemory = 97;
 
   const int encodingMax = 255;
 
@@ -45,6 +47,17 @@ namespace rfb {
   const int pseudoEncodingCursorWithAlpha = -314;
   const int pseudoEncodingQEMUKeyEvent = -258;
 
+  // Not registered numbers, like encodingTileCache and
+  // encodingSharedMemory, so these are only used when enabled on both
+  // sides:
+  //   TileCacheSize0-15: log2 of the client's tile cache size in MiB
+  //   CursorCache: compressed cursor shapes kept in a CursorCache
+  //   SharedMemory: pixel data in a buffer shared with a local client
+  const int pseudoEncodingTileCacheSize0 = -1280;
+  const int pseudoEncodingTileCacheSize15 = -1265;
+  const int pseudoEncodingCursorCache = -1264;
+  const int pseudoEncodingSharedMemory = -1263;
+
   // TightVNC-specific
   const int pseudoEncodingLastRect = -224;
   const int pseudoEncodingQualityLevel0 = -32;
@@ -0,0 +1,332 @@
+/* Copyright (C) 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+/*
+ * This program measures how long it takes to set up a connection
+ * using the RSA-AES (RA2) security type. The client and server run in
+ * the same process and talk over memory buffers, so only the CPU cost
+ * of the handshake is measured.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#include <stdexcept>
+#include <vector>
+
+#include <nettle/rsa.h>
+
+#include <core/Configuration.h>
+#include <core/string.h>
+
+#include <rdr/BufferedInStream.h>
+#include <rdr/MemOutStream.h>
+#include <rdr/RandomStream.h>
+
+#include <rfb/CConnection.h>
+#include <rfb/CSecurityRSAAES.h>
+#include <rfb/SConnection.h>
+#include <rfb/SSecurityRSAAES.h>
+#include <rfb/SecurityClient.h>
+#include <rfb/SecurityServer.h>
+#include <rfb/obfuscate.h>
+
+#include "util.h"
+
+static const char* password = "authperf";
+
+// Reads whatever the other side has written to its MemOutStream
+class PipeInStream : public rdr::BufferedInStream {
+public:
+  PipeInStream(rdr::MemOutStream* source_) : source(source_), offset(0) {}
+
+private:
+  bool fillBuffer() override
+  {
+    size_t len;
+
+    len = source->length() - offset;
+    if (len == 0)
+      return false;
+    if (len > availSpace())
+      len = availSpace();
+
+    memcpy((uint8_t*)end, (const uint8_t*)source->data() + offset, len);
+    end += len;
+    offset += len;
+
+    return true;
+  }
+
+private:
+  rdr::MemOutStream* source;
+  size_t offset;
+};
+
+class CConn : public rfb::CConnection {
+public:
+  CConn(rdr::InStream* in, rdr::OutStream* out)
+  {
+    setStreams(in, out);
+  }
+
+  void initDone() override {}
+  void setColourMapEntries(int, int, uint16_t*) override {}
+  void bell() override {}
+  void serverCutText(const char*) override {}
+  void getUserPasswd(bool, std::string*, std::string* passwd) override
+  {
+    *passwd = password;
+  }
+  bool showMsgBox(rfb::MsgBoxFlags, const char*, const char*) override
+  {
+    return true;
+  }
+};
+
+class SConn : public rfb::SConnection {
+public:
+  SConn(rdr::InStream* in, rdr::OutStream* out)
+    : SConnection(rfb::AccessDefault)
+  {
+    setStreams(in, out);
+  }
+
+  void setDesktopSize(int, int, const rfb::ScreenSet&) override {}
+  void keyEvent(uint32_t, uint32_t, bool) override {}
+  void pointerEvent(const core::Point&, uint16_t) override {}
+};
+
+static double runHandshake()
+{
+  rdr::MemOutStream clientOut, serverOut;
+  PipeInStream clientIn(&serverOut), serverIn(&clientOut);
+  struct timeval start, stop;
+
+  gettimeofday(&start, nullptr);
+
+  CConn cc(&clientIn, &clientOut);
+  SConn sc(&serverIn, &serverOut);
+
+  cc.initialiseProtocol();
+  sc.initialiseProtocol();
+
+  // Both sides are done once the server is waiting for ClientInit
+  while (sc.state() != rfb::SConnection::RFBSTATE_INITIALISATION) {
+    size_t written;
+
+    written = clientOut.length() + serverOut.length();
+
+    while (cc.processMsg())
+      ;
+    while ((sc.state() != rfb::SConnection::RFBSTATE_INITIALISATION) &&
+           sc.processMsg())
+      ;
+
+    if (clientOut.length() + serverOut.length() == written) {
+      fprintf(stderr, "Handshake got stuck\n");
+      exit(1);
+    }
+  }
+
+  gettimeofday(&stop, nullptr);
+
+  return (stop.tv_sec - start.tv_sec) +
+         (stop.tv_usec - start.tv_usec) / 1000000.0;
+}
+
+static void random_func(void*, size_t length, uint8_t* dst)
+{
+  rdr::RandomStream rs;
+  if (!rs.hasData(length))
+    throw std::runtime_error("Failed to generate random");
+  rs.readBytes(dst, length);
+}
+
+// What the viewer used to do for every connection
+static double runKeyGeneration(unsigned length)
+{
+  struct rsa_public_key pub;
+  struct rsa_private_key priv;
+  struct timeval start, stop;
+
+  rsa_public_key_init(&pub);
+  rsa_private_key_init(&priv);
+  mpz_set_ui(pub.e, 65537);
+
+  gettimeofday(&start, nullptr);
+
+  if (!rsa_generate_keypair(&pub, &priv, nullptr, random_func,
+                            nullptr, nullptr, length, 0)) {
+    fprintf(stderr, "Failed to generate key\n");
+    exit(1);
+  }
+
+  gettimeofday(&stop, nullptr);
+
+  rsa_public_key_clear(&pub);
+  rsa_private_key_clear(&priv);
+
+  return (stop.tv_sec - start.tv_sec) +
+         (stop.tv_usec - start.tv_usec) / 1000000.0;
+}
+
+static void sort(double *array, int count)
+{
+  bool sorted;
+  int i;
+  do {
+    sorted = true;
+    for (i = 1;i < count;i++) {
+      if (array[i-1] > array[i]) {
+        double d;
+        d = array[i];
+        array[i] = array[i-1];
+        array[i-1] = d;
+        sorted = false;
+      }
+    }
+  } while (!sorted);
+}
+
+static void usage(const char* argv0)
+{
+  fprintf(stderr, "Syntax: %s [options] <RSA key file>\n", argv0);
+  fprintf(stderr, "Options:\n");
+  fprintf(stderr, "  -json       Print results as JSON\n");
+  fprintf(stderr, "  -count <n>  Number of connections (default 9)\n");
+  fprintf(stderr, "  -length <n> Key length for the key generation test "
+                  "(default 2048)\n");
+  fprintf(stderr, "  -pause <ms> Time between connections (default 1000)\n");
+  exit(1);
+}
+
+int main(int argc, char** argv)
+{
+  const char* keyFile;
+  bool json;
+  int count, pause;
+  unsigned length;
+  double first;
+  double* handshake;
+  double* keygen;
+  std::vector<uint8_t> obfuscated;
+  int i;
+
+  keyFile = nullptr;
+  json = false;
+  count = 9;
+  length = 2048;
+  pause = 1000;
+
+  for (i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-json") == 0) {
+      json = true;
+      continue;
+    }
+
+    if (strcmp(argv[i], "-count") == 0) {
+      if (i + 1 >= argc)
+        usage(argv[0]);
+      count = atoi(argv[++i]);
+      if (count <= 0)
+        usage(argv[0]);
+      continue;
+    }
+
+    if (strcmp(argv[i], "-length") == 0) {
+      if (i + 1 >= argc)
+        usage(argv[0]);
+      length = atoi(argv[++i]);
+      if (length < 1024)
+        usage(argv[0]);
+      continue;
+    }
+
+    if (strcmp(argv[i], "-pause") == 0) {
+      if (i + 1 >= argc)
+        usage(argv[0]);
+      pause = atoi(argv[++i]);
+      if (pause < 0)
+        usage(argv[0]);
+      continue;
+    }
+
+    if ((argv[i][0] == '-') || (keyFile != nullptr))
+      usage(argv[0]);
+
+    keyFile = argv[i];
+  }
+
+  if (keyFile == nullptr)
+    usage(argv[0]);
+
+  rfb::SecurityServer::secTypes.setParam("RA2");
+  rfb::SecurityClient::secTypes.setParam("RA2");
+  rfb::SSecurityRSAAES::keyFile.setParam(keyFile);
+
+  obfuscated = rfb::obfuscate(password);
+  core::Configuration::setParam("Password",
+                                core::binToHex(obfuscated.data(),
+                                               obfuscated.size()).c_str());
+
+  handshake = new double[count];
+  keygen = new double[count];
+
+  // The first connection has to read the server key and generate a
+  // client key on the spot
+  first = runHandshake();
+
+  // Later ones should have both ready
+  for (i = 0; i < count; i++) {
+    usleep(pause * 1000);
+    handshake[i] = runHandshake();
+  }
+
+  for (i = 0; i < count; i++)
+    keygen[i] = runKeyGeneration(length);
+
+  if (json) {
+    jsonBegin("authperf", keyFile);
+    jsonMetric("handshake_first", "s", false, &first, 1);
+    jsonMetric("handshake", "s", false, handshake, count);
+    jsonMetric("keygen", "s", false, keygen, count);
+    jsonEnd();
+  } else {
+    sort(handshake, count);
+    sort(keygen, count);
+
+    printf("First connection: %g ms\n", first * 1000);
+    printf("Later connections: %g ms (median)\n",
+           handshake[count/2] * 1000);
+    printf("Key generation (%u bits): %g ms (median)\n",
+           length, keygen[count/2] * 1000);
+  }
+
+  delete [] handshake;
+  delete [] keygen;
+
+  return 0;
+}
@@ -32,8 +32,13 @@
 static const int tile = 64;
 static const int fbsize = 4096;
 
+// How many times each test is run for JSON output
+static const int jsonRuns = 9;
+
 static uint8_t *fb1, *fb2;
 
+static bool json;
+
 typedef void (*testfn) (rfb::PixelFormat&, rfb::PixelFormat&, uint8_t*, uint8_t*);
 
 struct TestEntry {
@@ -75,7 +80,7 @@ static void testFromRGB(rfb::PixelFormat &dstpf,
   dstpf.bufferFromRGB(dst, src, tile, fbsize, tile);
 }
 
-static void doTest(testfn fn, rfb::PixelFormat &dstpf, rfb::PixelFormat &srcpf)
+static double doTest(testfn fn, rfb::PixelFormat &dstpf, rfb::PixelFormat &srcpf)
 {
   startCpuCounter();
 
@@ -96,7 +101,7 @@ static void doTest(testfn fn, rfb::PixelFormat &dstpf, rfb::PixelFormat &srcpf)
   data = (double)tile * tile * 10000;
   time = getCpuCounter();
 
-  printf("%g", data / (1000.0*1000.0) / time);
+  return data / (1000.0*1000.0) / time;
 }
 
 struct TestEntry tests[] = {
@@ -114,56 +119,44 @@ static void doTests(rfb::PixelFormat &dstpf, rfb::PixelFormat &srcpf)
   dstpf.print(dstb, sizeof(dstb));
   srcpf.print(srcb, sizeof(srcb));
 
+  if (json) {
+    for (i = 0;i < sizeof(tests)/sizeof(tests[0]);i++) {
+      double values[jsonRuns];
+      char name[1024];
+
+      for (int j = 0;j < jsonRuns;j++)
+        values[j] = doTest(tests[i].fn, dstpf, srcpf);
+
+      snprintf(name, sizeof(name), "%s/%s/%s",
+               tests[i].label, srcb, dstb);
+      jsonMetric(name, "Mpixels/s", true, values, jsonRuns);
+    }
+
+    return;
+  }
+
   printf("%s,%s", srcb, dstb);
 
   for (i = 0;i < sizeof(tests)/sizeof(tests[0]);i++) {
-    printf(",");
-    doTest(tests[i].fn, dstpf, srcpf);
+    printf(",%g", doTest(tests[i].fn, dstpf, srcpf));
   }
 
   printf("\n");
 }
 
-int main(int /*argc*/, char** /*argv*/)
+static void newSection()
 {
-  size_t bufsize;
-
-  time_t t;
-  char datebuffer[256];
-
-  size_t i;
-
-  bufsize = fbsize * fbsize * 4;
-
-  fb1 = new uint8_t[bufsize];
-  fb2 = new uint8_t[bufsize];
-
-  for (i = 0;i < bufsize;i++) {
-    fb1[i] = rand();
-    fb2[i] = rand();
-  }
-
-  time(&t);
-  strftime(datebuffer, sizeof(datebuffer), "%Y-%m-%d %H:%M UTC", gmtime(&t));
-
-  printf("# Pixel Conversion Performance Test %s\n", datebuffer);
-  printf("#\n");
-  printf("# Frame buffer: %dx%d pixels\n", fbsize, fbsize);
-  printf("# Tile size: %dx%d pixels\n", tile, tile);
-  printf("#\n");
-  printf("# Note: Results are Mpixels/sec\n");
-  printf("#\n");
-
-  printf("Source format,Destination Format");
-  for (i = 0;i < sizeof(tests)/sizeof(tests[0]);i++)
-    printf(",%s", tests[i].label);
-  printf("\n");
+  if (!json)
+    printf("\n");
+}
 
+static void doAllTests()
+{
   rfb::PixelFormat dstpf, srcpf;
 
   /* rgb888 targets */
 
-  printf("\n");
+  newSection();
 
   dstpf.parse("rgb888");
 
@@ -181,7 +174,7 @@ int main(int /*argc*/, char** /*argv*/)
 
   /* rgb565 targets */
 
-  printf("\n");
+  newSection();
 
   dstpf.parse("rgb565");
 
@@ -196,7 +189,7 @@ int main(int /*argc*/, char** /*argv*/)
 
   /* rgb232 targets */
 
-  printf("\n");
+  newSection();
 
   dstpf.parse("rgb232");
 
@@ -211,7 +204,7 @@ int main(int /*argc*/, char** /*argv*/)
 
   /* rgb565 with endian conversion (both ways) */
 
-  printf("\n");
+  newSection();
 
   dstpf = rfb::PixelFormat(32, 24, false, true, 255, 255, 255, 0, 8, 16);
   srcpf = rfb::PixelFormat(32, 24, true, true, 255, 255, 255, 0, 8, 16);
@@ -226,6 +219,58 @@ int main(int /*argc*/, char** /*argv*/)
   doTests(srcpf, dstpf);
 
   doTests(dstpf, srcpf);
+}
+
+int main(int argc, char** argv)
+{
+  size_t bufsize;
+
+  time_t t;
+  char datebuffer[256];
+
+  size_t i;
+
+  bufsize = fbsize * fbsize * 4;
+
+  fb1 = new uint8_t[bufsize];
+  fb2 = new uint8_t[bufsize];
+
+  for (i = 0;i < bufsize;i++) {
+    fb1[i] = rand();
+    fb2[i] = rand();
+  }
+
+  if ((argc == 2) && (strcmp(argv[1], "-json") == 0))
+    json = true;
+  else if (argc != 1) {
+    printf("Syntax: %s [-json]\n", argv[0]);
+    return 1;
+  }
+
+  if (json) {
+    jsonBegin("convperf", nullptr);
+    doAllTests();
+    jsonEnd();
+    return 0;
+  }
+
+  time(&t);
+  strftime(datebuffer, sizeof(datebuffer), "%Y-%m-%d %H:%M UTC", gmtime(&t));
+
+  printf("# Pixel Conversion Performance Test %s\n", datebuffer);
+  printf("#\n");
+  printf("# Frame buffer: %dx%d pixels\n", fbsize, fbsize);
+  printf("# Tile size: %dx%d pixels\n", tile, tile);
+  printf("#\n");
+  printf("# Note: Results are Mpixels/sec\n");
+  printf("#\n");
+
+  printf("Source format,Destination Format");
+  for (i = 0;i < sizeof(tests)/sizeof(tests[0]);i++)
+    printf(",%s", tests[i].label);
+  printf("\n");
+
+  doAllTests();
 
   return 0;
 }
@@ -30,6 +30,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 #include <sys/time.h>
 
@@ -41,6 +42,7 @@
 #include <rfb/CMsgWriter.h>
 #include <rfb/PixelBuffer.h>
 #include <rfb/PixelFormat.h>
+#include <rfb/TileCache.h>
 
 #include "util.h"
 
@@ -123,6 +125,10 @@ CConn::CConn(const char *filename)
   // That also means that the reader and writer weren't setup
   setReader(new rfb::CMsgReader(this, in));
   setWriter(new rfb::CMsgWriter(&server, out));
+
+  // We don't know how big a tile cache the server was told about, so
+  // allow the largest possible
+  setTileCacheSize(1 << rfb::tileCacheMaxLevel);
 }
 
 CConn::~CConn()
@@ -242,18 +248,37 @@ int main(int argc, char **argv)
   struct stats runs[runCount];
   double values[runCount], dev[runCount];
   double median, meddev;
-
-  if (argc != 2) {
-    printf("Syntax: %s <rfb file>\n", argv[0]);
+  bool json;
+  const char *fn;
+
+  json = false;
+  if ((argc == 3) && (strcmp(argv[1], "-json") == 0)) {
+    json = true;
+    fn = argv[2];
+  } else if (argc == 2) {
+    fn = argv[1];
+  } else {
+    printf("Syntax: %s [-json] <rfb file>\n", argv[0]);
     return 1;
   }
 
   // Warmup
-  runTest(argv[1]);
+  runTest(fn);
 
   // Multiple runs to get a good average
   for (i = 0;i < runCount;i++)
-    runs[i] = runTest(argv[1]);
+    runs[i] = runTest(fn);
+
+  if (json) {
+    for (i = 0;i < runCount;i++)
+      values[i] = runs[i].decodeTime;
+
+    jsonBegin("decperf", fn);
+    jsonMetric("decode_cpu", "s", false, values, runCount);
+    jsonEnd();
+
+    return 0;
+  }
 
   // Calculate median and median deviation for CPU usage
   for (i = 0;i < runCount;i++)
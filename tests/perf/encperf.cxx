@@ -34,11 +34,17 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <limits.h>
 #include <math.h>
 #include <sys/time.h>
 
+#include <map>
+#include <string>
+#include <vector>
+
 #include <core/Configuration.h>
 
+#include <rdr/BufferPool.h>
 #include <rdr/OutStream.h>
 #include <rdr/FileInStream.h>
 
@@ -47,10 +53,13 @@
 #include <rfb/CConnection.h>
 #include <rfb/CMsgReader.h>
 #include <rfb/CMsgWriter.h>
+#include <rfb/ComparingUpdateTracker.h>
 #include <rfb/UpdateTracker.h>
 #include <rfb/EncodeManager.h>
 #include <rfb/SConnection.h>
 #include <rfb/SMsgWriter.h>
+#include <rfb/ServerCore.h>
+#include <rfb/TileCache.h>
 
 #include "util.h"
 
@@ -64,10 +73,37 @@ static core::BoolParameter translate("translate",
                                      "Translate 8-bit and 16-bit datasets into 24-bit",
                                      true);
 
+static core::BoolParameter compare("compare",
+                                   "Compare each update with the previous "
+                                   "frame buffer, like the server does",
+                                   false);
+static core::BoolParameter detectScroll("detectScroll",
+                                        "Send moved content as copies "
+                                        "(implies compare)",
+                                        false);
+
+static core::IntParameter bandwidth("bandwidth",
+                                    "Link speed in bytes per second "
+                                    "assumed by AdaptiveEncoders "
+                                    "(0 = default)",
+                                    0, 0, INT_MAX);
+
+static core::BoolParameter json("json",
+                                "Print the results as JSON, for perfrun.py",
+                                false);
+
+static core::IntParameter tileCache("tileCache",
+                                    "Size of the client's tile cache in "
+                                    "MiB (0 = disabled)",
+                                    0, 0, 32768);
+
 // The frame buffer (and output) is always this format
 static const rfb::PixelFormat fbPF(32, 24, false, true, 255, 255, 255, 0, 8, 16);
 
 // Encodings to use
+// Time spent in each encoder, per content type (in seconds)
+typedef std::map<std::string, double> EncoderTimes;
+
 static const int32_t encodings[] = {
   rfb::encodingTight, rfb::encodingCopyRect, rfb::encodingRRE,
   rfb::encodingHextile, rfb::encodingZRLE, rfb::pseudoEncodingLastRect,
@@ -95,8 +131,9 @@ public:
 
   void getStats(double& ratio, unsigned long long& bytes,
                 unsigned long long& rawEquivalent);
+  void getEncoderTimes(EncoderTimes* times);
 
-  void initDone() override {};
+  void initDone() override;
   void resizeFramebuffer() override;
   void framebufferUpdateStart() override;
   void framebufferUpdateEnd() override;
@@ -110,11 +147,14 @@ public:
 public:
   double decodeTime;
   double encodeTime;
+  unsigned long long bufferAllocs;
+  unsigned bufferAllocUpdates;
 
 protected:
   rdr::FileInStream *in;
   DummyOutStream *out;
   rfb::SimpleUpdateTracker updates;
+  rfb::ComparingUpdateTracker *comparer;
   class SConn *sc;
 };
 
@@ -123,6 +163,7 @@ public:
   Manager(class rfb::SConnection *conn);
 
   void getStats(double&, unsigned long long&, unsigned long long&);
+  void getEncoderTimes(EncoderTimes* times);
 };
 
 class SConn : public rfb::SConnection {
@@ -133,6 +174,7 @@ public:
   void writeUpdate(const rfb::UpdateInfo& ui, const rfb::PixelBuffer* pb);
 
   void getStats(double&, unsigned long long&, unsigned long long&);
+  void getEncoderTimes(EncoderTimes* times);
 
   void setAccessRights(rfb::AccessRights ar) override;
 
@@ -178,29 +220,59 @@ CConn::CConn(const char *filename)
 {
   decodeTime = 0.0;
   encodeTime = 0.0;
+  bufferAllocs = 0;
+  bufferAllocUpdates = 0;
+
+  comparer = nullptr;
 
   in = new rdr::FileInStream(filename);
   out = new DummyOutStream;
   setStreams(in, out);
 
-  // Need to skip the initial handshake and ServerInit
-  setState(RFBSTATE_NORMAL);
-  // That also means that the reader and writer weren't setup
-  setReader(new rfb::CMsgReader(this, in));
-  setWriter(new rfb::CMsgWriter(&server, out));
-  // Nor the frame buffer size and format
-  rfb::PixelFormat pf;
-  pf.parse(format);
-  server.setPF(pf);
-  setDesktopSize(width, height);
-
   sc = new SConn();
-  sc->client.setPF((bool)translate ? fbPF : pf);
-  ((rfb::SMsgHandler*)sc)->setEncodings(sizeof(encodings) / sizeof(*encodings), encodings);
+
+  // Recordings from the server start with a ServerInit, otherwise we
+  // need to be told the frame buffer size and format
+  if (width == 0) {
+    setState(RFBSTATE_INITIALISATION);
+    setReader(new rfb::CMsgReader(this, in));
+    setWriter(new rfb::CMsgWriter(&server, out));
+  } else {
+    // Need to skip the initial handshake and ServerInit
+    setState(RFBSTATE_NORMAL);
+    // That also means that the reader and writer weren't setup
+    setReader(new rfb::CMsgReader(this, in));
+    setWriter(new rfb::CMsgWriter(&server, out));
+    // Nor the frame buffer size and format
+    rfb::PixelFormat pf;
+    pf.parse(format);
+    server.setPF(pf);
+    setDesktopSize(width, height);
+
+    sc->client.setPF((bool)translate ? fbPF : pf);
+  }
+
+  std::vector<int32_t> encs(encodings, encodings +
+                            sizeof(encodings) / sizeof(*encodings));
+  if (tileCache > 0) {
+    int level;
+
+    level = 0;
+    while ((level < rfb::tileCacheMaxLevel) && ((2 << level) <= tileCache))
+      level++;
+
+    encs.push_back(rfb::encodingTileCache);
+    encs.push_back(rfb::pseudoEncodingTileCacheSize0 + level);
+
+    // The server's own limit is off by default
+    rfb::Server::tileCacheSize.setParam(tileCache);
+  }
+  ((rfb::SMsgHandler*)sc)->setEncodings(encs.size(), encs.data());
 }
 
 CConn::~CConn()
 {
+  delete comparer;
   delete sc;
   delete in;
   delete out;
@@ -212,6 +284,17 @@ void CConn::getStats(double& ratio, unsigned long long& bytes,
   sc->getStats(ratio, bytes, rawEquivalent);
 }
 
+void CConn::getEncoderTimes(EncoderTimes* times)
+{
+  sc->getEncoderTimes(times);
+}
+
+void CConn::initDone()
+{
+  sc->client.setPF((bool)translate ? fbPF : server.pf());
+  resizeFramebuffer();
+}
+
 void CConn::resizeFramebuffer()
 {
   rfb::ModifiablePixelBuffer *pb;
@@ -219,6 +302,14 @@ void CConn::resizeFramebuffer()
   pb = new rfb::ManagedPixelBuffer((bool)translate ? fbPF : server.pf(),
                                    server.width(), server.height());
   setFramebuffer(pb);
+
+  delete comparer;
+  comparer = nullptr;
+
+  if (compare || detectScroll) {
+    comparer = new rfb::ComparingUpdateTracker(pb);
+    comparer->setDetectScroll(detectScroll);
+  }
 }
 
 void CConn::framebufferUpdateStart()
@@ -234,6 +325,7 @@ void CConn::framebufferUpdateEnd()
   rfb::UpdateInfo ui;
   rfb::PixelBuffer* pb = getFramebuffer();
   core::Region clip(pb->getRect());
+  unsigned long long allocs;
 
   CConnection::framebufferUpdateEnd();
 
@@ -243,11 +335,25 @@ void CConn::framebufferUpdateEnd()
 
   updates.getUpdateInfo(&ui, clip);
 
+  allocs = rdr::BufferPool::heapAllocations();
+
   startCpuCounter();
+  if (comparer != nullptr) {
+    comparer->add_changed(ui.changed);
+    comparer->compare();
+    comparer->getUpdateInfo(&ui, clip);
+    comparer->clear();
+  }
   sc->writeUpdate(ui, pb);
   endCpuCounter();
 
   encodeTime += getCpuCounter();
+
+  allocs = rdr::BufferPool::heapAllocations() - allocs;
+  if (allocs != 0) {
+    bufferAllocs += allocs;
+    bufferAllocUpdates++;
+  }
 }
 
 bool CConn::dataRect(const core::Rect& r, int encoding)
@@ -293,7 +399,10 @@ void Manager::getStats(double& ratio, unsigned long long& encodedBytes,
   StatsVector::iterator iter;
   unsigned long long bytes, equivalent;
 
-  bytes = equivalent = 0;
+  bytes = copyStats.bytes;
+  equivalent = copyStats.equivalent;
+  bytes += cacheHitStats.bytes + cacheStoreStats.bytes;
+  equivalent += cacheHitStats.equivalent;
   for (iter = stats.begin(); iter != stats.end(); ++iter) {
     StatsVector::value_type::iterator iter2;
     for (iter2 = iter->begin(); iter2 != iter->end(); ++iter2) {
@@ -307,6 +416,26 @@ void Manager::getStats(double& ratio, unsigned long long& encodedBytes,
   rawEquivalent = equivalent;
 }
 
+void Manager::getEncoderTimes(EncoderTimes* times)
+{
+  size_t i, j;
+
+  for (i = 0; i < stats.size(); i++) {
+    for (j = 0; j < stats[i].size(); j++) {
+      std::string name;
+
+      if (stats[i][j].rects == 0)
+        continue;
+
+      name = className(i);
+      name += "/";
+      name += typeName(j);
+
+      (*times)[name] = stats[i][j].usecs / 1000000.0;
+    }
+  }
+}
+
 SConn::SConn()
 : SConnection(rfb::AccessDefault)
 {
@@ -316,6 +445,7 @@ SConn::SConn()
   setWriter(new rfb::SMsgWriter(&client, out));
 
   manager = new Manager(this);
+  manager->setBandwidth(bandwidth);
 }
 
 SConn::~SConn()
@@ -335,6 +465,11 @@ void SConn::getStats(double& ratio, unsigned long long& bytes,
   manager->getStats(ratio, bytes, rawEquivalent);
 }
 
+void SConn::getEncoderTimes(EncoderTimes* times)
+{
+  manager->getEncoderTimes(times);
+}
+
 void SConn::setAccessRights(rfb::AccessRights)
 {
 }
@@ -360,6 +495,11 @@ struct stats
   double ratio;
   unsigned long long bytes;
   unsigned long long rawEquivalent;
+
+  unsigned long long bufferAllocs;
+  unsigned bufferAllocUpdates;
+
+  EncoderTimes encoderTimes;
 };
 
 static struct stats runTest(const char *fn)
@@ -390,9 +530,12 @@ static struct stats runTest(const char *fn)
 
   s.decodeTime = cc->decodeTime;
   s.encodeTime = cc->encodeTime;
+  s.bufferAllocs = cc->bufferAllocs;
+  s.bufferAllocUpdates = cc->bufferAllocUpdates;
   s.realTime = (double)stop.tv_sec - start.tv_sec;
   s.realTime += ((double)stop.tv_usec - start.tv_usec)/1000000.0;
   cc->getStats(s.ratio, s.bytes, s.rawEquivalent);
+  cc->getEncoderTimes(&s.encoderTimes);
 
   delete cc;
 
@@ -417,6 +560,48 @@ static void sort(double *array, int len)
   } while (!sorted);
 }
 
+static void printJson(const char *fn, const struct stats *runs,
+                      int runCount)
+{
+  std::vector<double> values(runCount);
+  double bytes;
+  int i;
+
+  jsonBegin("encperf", fn);
+
+  for (i = 0; i < runCount; i++)
+    values[i] = runs[i].decodeTime;
+  jsonMetric("decode_cpu", "s", false, values.data(), runCount);
+
+  for (i = 0; i < runCount; i++)
+    values[i] = runs[i].encodeTime;
+  jsonMetric("encode_cpu", "s", false, values.data(), runCount);
+
+  // The output is the same for every run
+  bytes = runs[0].bytes;
+  jsonMetric("encoded_bytes", "B", false, &bytes, 1);
+
+  for (i = 0; i < runCount; i++)
+    values[i] = runs[i].bufferAllocs;
+  jsonMetric("buffer_allocs", "count", false, values.data(), runCount);
+
+  for (const auto& encoder : runs[0].encoderTimes) {
+    std::string name;
+
+    for (i = 0; i < runCount; i++) {
+      EncoderTimes::const_iterator iter;
+
+      iter = runs[i].encoderTimes.find(encoder.first);
+      values[i] = iter == runs[i].encoderTimes.end() ? 0 : iter->second;
+    }
+
+    name = "encoder_time/" + encoder.first;
+    jsonMetric(name.c_str(), "s", false, values.data(), runCount);
+  }
+
+  jsonEnd();
+}
+
 static void usage(const char *argv0)
 {
   fprintf(stderr, "Syntax: %s [options] <rfb file>\n", argv0);
@@ -482,14 +667,17 @@ int main(int argc, char **argv)
     usage(argv[0]);
   }
 
-  if (strcmp(format, "") == 0) {
-    fprintf(stderr, "Pixel format not specified!\n\n");
-    usage(argv[0]);
-  }
+  // Without these the file must start with a ServerInit
+  if ((width != 0) || (height != 0) || (strcmp(format, "") != 0)) {
+    if (strcmp(format, "") == 0) {
+      fprintf(stderr, "Pixel format not specified!\n\n");
+      usage(argv[0]);
+    }
 
-  if (width == 0 || height == 0) {
-    fprintf(stderr, "Frame buffer size not specified!\n\n");
-    usage(argv[0]);
+    if (width == 0 || height == 0) {
+      fprintf(stderr, "Frame buffer size not specified!\n\n");
+      usage(argv[0]);
+    }
   }
 
   // Warmup
@@ -499,6 +687,11 @@ int main(int argc, char **argv)
   for (i = 0; i < runCount; i++)
     runs[i] = runTest(fn);
 
+  if (json) {
+    printJson(fn, runs, runCount);
+    return 0;
+  }
+
   // Calculate median and median deviation for CPU usage decoding
   for (i = 0;i < runCount;i++)
     values[i] = runs[i].decodeTime;
@@ -548,5 +741,11 @@ int main(int argc, char **argv)
   printf("Raw equivalent bytes: %llu\n", runs[0].rawEquivalent);
   printf("Ratio: %g\n", runs[0].ratio);
 
+  // Later runs show the steady state, as the buffers are kept between
+  // runs
+  printf("Buffer allocations: %llu, in %u updates (first run: %llu)\n",
+         runs[runCount-1].bufferAllocs, runs[runCount-1].bufferAllocUpdates,
+         runs[0].bufferAllocs);
+
   return 0;
 }
@@ -23,6 +23,8 @@
 #include <math.h>
 #include <sys/time.h>
 
+#include <vector>
+
 #include <FL/Fl.H>
 #include <FL/Fl_Window.H>
 #include <FL/fl_draw.H>
@@ -55,6 +57,7 @@ protected:
 
 public:
   unsigned long long pixels, frames;
+  unsigned long long uploaded;
   double time;
 
 protected:
@@ -66,6 +69,11 @@ protected:
   void changefb() override;
 };
 
+class ScatteredTestWindow: public TestWindow {
+protected:
+  void changefb() override;
+};
+
 class OverlayTestWindow: public PartialTestWindow {
 public:
   OverlayTestWindow();
@@ -101,6 +109,7 @@ void TestWindow::start(int width, int height)
 
   pixels = 0;
   frames = 0;
+  uploaded = 0;
   time = 0;
 
   fb = new PlatformPixelBuffer(w(), h());
@@ -155,14 +164,16 @@ void TestWindow::flush()
 
 void TestWindow::update()
 {
-  core::Rect r;
+  std::vector<core::Rect> rects;
 
   startTimeCounter();
 
   changefb();
 
-  r = fb->getDamage();
-  damage(FL_DAMAGE_USER1, r.tl.x, r.tl.y, r.width(), r.height());
+  fb->getDamage().get_rects(&rects);
+  for (const core::Rect& r : rects)
+    damage(FL_DAMAGE_USER1, r.tl.x, r.tl.y, r.width(), r.height());
+  uploaded += fb->getLastUpload();
 
 #if !defined(WIN32) && !defined(__APPLE__)
   // Make sure we measure any work we queue up
@@ -207,6 +218,23 @@ void PartialTestWindow::changefb()
   fb->fillRect(r, &pixel);
 }
 
+void ScatteredTestWindow::changefb()
+{
+  core::Rect r;
+  uint32_t pixel;
+
+  // Small changes in each corner of the window
+  pixel = rand();
+  r.setXYWH(0, 0, 64, 64);
+  fb->fillRect(r, &pixel);
+  r.setXYWH(w() - 64, 0, 64, 64);
+  fb->fillRect(r, &pixel);
+  r.setXYWH(0, h() - 64, 64, 64);
+  fb->fillRect(r, &pixel);
+  r.setXYWH(w() - 64, h() - 64, 64, 64);
+  fb->fillRect(r, &pixel);
+}
+
 OverlayTestWindow::OverlayTestWindow() :
   overlay(nullptr), offscreen(nullptr)
 {
@@ -375,6 +403,21 @@ static void dotest(TestWindow* win)
           1.0 / (delay + rate * 1920 * 1080));
 }
 
+static void doscatteredtest(TestWindow* win)
+{
+  unsigned long long pixels, frames;
+  double time;
+
+  // A high resolution makes it obvious if we upload more than needed
+  dosubtest(win, 1920, 1080, &pixels, &frames, &time);
+
+  fprintf(stderr, "Update rate: %g updates/s\n", frames / time);
+  fprintf(stderr, "Uploaded: %g pixels/update\n",
+          (double)win->uploaded / frames);
+  fprintf(stderr, "Upload rate: %s\n",
+          core::siPrefix(win->uploaded / time, "pixels/s").c_str());
+}
+
 int main(int /*argc*/, char** /*argv*/)
 {
   TestWindow* win;
@@ -391,6 +434,12 @@ int main(int /*argc*/, char** /*argv*/)
   delete win;
   fprintf(stderr, "\n");
 
+  fprintf(stderr, "Scattered small updates:\n\n");
+  win = new ScatteredTestWindow();
+  doscatteredtest(win);
+  delete win;
+  fprintf(stderr, "\n");
+
   fprintf(stderr, "Partial window update with overlay:\n\n");
   win = new OverlayTestWindow();
   dotest(win);
@@ -0,0 +1,230 @@
+#!/usr/bin/python3
+#
+# Copyright (C) 2026 TigerVNC Team
+#
+# This is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 2 of the License, or
+# (at your option) any later version.
+#
+# This software is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this software; if not, write to the Free Software
+# Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+# USA.
+#
+
+#
+# Runs the performance tools over a corpus of recorded sessions,
+# collects their JSON output and optionally compares the result with
+# an earlier run. Exits with status 1 if any metric has regressed.
+#
+
+import argparse
+import json
+import math
+import os
+import subprocess
+import sys
+
+def find_tool(build, name):
+    for d in (os.path.join(build, 'tests', 'perf'), build):
+        path = os.path.join(d, name)
+        if os.access(path, os.X_OK):
+            return path
+    sys.exit("Cannot find %s in %s" % (name, build))
+
+def run_tool(cmd):
+    print("Running %s" % ' '.join(cmd), file=sys.stderr)
+    out = subprocess.run(cmd, check=True, stdout=subprocess.PIPE,
+                         universal_newlines=True).stdout
+    # The tools may print other things before the JSON document
+    return json.loads(out[out.index('{'):])
+
+def add_results(results, doc):
+    label = doc['tool']
+    if doc['input']:
+        label += ':' + os.path.basename(doc['input'])
+    for metric in doc['metrics']:
+        key = label + ':' + metric['name']
+        entry = results.setdefault(key, { 'unit': metric['unit'],
+                                          'better': metric['better'],
+                                          'samples': [] })
+        entry['samples'].extend(metric['samples'])
+
+def median(values):
+    values = sorted(values)
+    n = len(values)
+    if n % 2:
+        return values[n // 2]
+    return (values[n // 2 - 1] + values[n // 2]) / 2
+
+def percentile(values, p):
+    values = sorted(values)
+    pos = (len(values) - 1) * p
+    lo = math.floor(pos)
+    hi = math.ceil(pos)
+    return values[lo] + (values[hi] - values[lo]) * (pos - lo)
+
+def summarise(results):
+    for entry in results.values():
+        samples = entry['samples']
+        entry['median'] = median(samples)
+        entry['p95'] = percentile(samples, 0.95)
+        entry['mad'] = median([abs(v - entry['median']) for v in samples])
+
+def mann_whitney(a, b):
+    # Two-sided Mann-Whitney U test using the normal approximation,
+    # with a correction for ties. Returns the p-value.
+    n1 = len(a)
+    n2 = len(b)
+    values = sorted([(v, 0) for v in a] + [(v, 1) for v in b])
+
+    ranks = [0.0] * len(values)
+    ties = 0.0
+    i = 0
+    while i < len(values):
+        j = i
+        while j + 1 < len(values) and values[j + 1][0] == values[i][0]:
+            j += 1
+        for k in range(i, j + 1):
+            ranks[k] = (i + j) / 2 + 1
+        t = j - i + 1
+        ties += t ** 3 - t
+        i = j + 1
+
+    r1 = sum(r for r, (v, g) in zip(ranks, values) if g == 0)
+    u = r1 - n1 * (n1 + 1) / 2
+
+    n = n1 + n2
+    mean = n1 * n2 / 2
+    var = n1 * n2 / 12 * ((n + 1) - ties / (n * (n - 1)))
+    if var <= 0:
+        return 1.0
+
+    z = (abs(u - mean) - 0.5) / math.sqrt(var)
+    if z < 0:
+        z = 0
+    return math.erfc(z / math.sqrt(2))
+
+def compare(results, baseline, alpha, threshold):
+    regressions = 0
+
+    print()
+    print("%-60s %12s %12s %8s %8s" %
+          ("Metric", "Baseline", "Current", "Change", "p"))
+
+    for key in sorted(results):
+        if key not in baseline:
+            continue
+
+        cur = results[key]
+        old = baseline[key]
+
+        if old['median'] == 0:
+            continue
+
+        change = (cur['median'] - old['median']) / old['median']
+        if cur['better'] == 'higher':
+            worse = change < -threshold
+            better = change > threshold
+        else:
+            worse = change > threshold
+            better = change < -threshold
+
+        # Single samples (e.g. byte counts) are deterministic so the
+        # threshold alone decides
+        if len(cur['samples']) >= 3 and len(old['samples']) >= 3:
+            p = mann_whitney(cur['samples'], old['samples'])
+            pstr = "%.4f" % p
+            significant = p < alpha
+        else:
+            pstr = "-"
+            significant = True
+
+        if worse and significant:
+            verdict = "REGRESSION"
+            regressions += 1
+        elif better and significant:
+            verdict = "improved"
+        else:
+            verdict = ""
+
+        print("%-60s %12.6g %12.6g %+7.1f%% %8s %s" %
+              (key[-60:], old['median'], cur['median'], change * 100,
+               pstr, verdict))
+
+    print()
+    if regressions:
+        print("%d metric(s) regressed" % regressions)
+    else:
+        print("No regressions")
+
+    return regressions
+
+def main():
+    parser = argparse.ArgumentParser(
+        description="Run the performance tests and compare with a baseline")
+    parser.add_argument('--build', default='.',
+                        help="build directory containing the tools")
+    parser.add_argument('--runs', type=int, default=9,
+                        help="number of runs for each trace")
+    parser.add_argument('--replay', action='store_true',
+                        help="also run replayperf (runs in real time)")
+    parser.add_argument('--output', help="write results to this file")
+    parser.add_argument('--baseline', help="compare against this file")
+    parser.add_argument('--alpha', type=float, default=0.01,
+                        help="significance level (default 0.01)")
+    parser.add_argument('--threshold', type=float, default=0.05,
+                        help="smallest relative change that counts "
+                             "(default 0.05)")
+    parser.add_argument('traces', nargs='*',
+                        help="session recordings to use as corpus")
+    args = parser.parse_args()
+
+    results = {}
+
+    add_results(results, run_tool([find_tool(args.build, 'convperf'),
+                                   '-json']))
+
+    for trace in args.traces:
+        add_results(results, run_tool([find_tool(args.build, 'decperf'),
+                                       '-json', trace]))
+        add_results(results, run_tool([find_tool(args.build, 'encperf'),
+                                       '-json', '-count', str(args.runs),
+                                       trace]))
+        if args.replay:
+            add_results(results,
+                        run_tool([find_tool(args.build, 'replayperf'),
+                                  '-json', trace]))
+
+    summarise(results)
+
+    if args.output:
+        with open(args.output, 'w') as f:
+            json.dump(results, f, indent=1, sort_keys=True)
+
+    if not args.baseline:
+        print("%-60s %12s %12s %12s %s" %
+              ("Metric", "Median", "p95", "MAD", "Unit"))
+        for key in sorted(results):
+            entry = results[key]
+            print("%-60s %12.6g %12.6g %12.6g %s" %
+                  (key[-60:], entry['median'], entry['p95'],
+                   entry['mad'], entry['unit']))
+        return 0
+
+    with open(args.baseline) as f:
+        baseline = json.load(f)
+
+    if compare(results, baseline, args.alpha, args.threshold):
+        return 1
+
+    return 0
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,876 @@
+/* Copyright (C) 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+/*
+ * This program replays a recorded session through a complete server,
+ * at the pace the updates were originally recorded. A number of
+ * simulated clients are connected over links with limited bandwidth
+ * and added latency, and the update rate and latency each of them
+ * sees is reported.
+ *
+ * The trace should be in the format written by the server's
+ * RecordSession option, i.e. starting with a ServerInit. If there is
+ * a .times file next to it then that decides when each update is
+ * replayed, otherwise they are spaced out evenly.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+#include <algorithm>
+#include <list>
+#include <vector>
+
+#include <core/Configuration.h>
+#include <core/Exception.h>
+#include <core/Region.h>
+#include <core/string.h>
+#include <core/Timer.h>
+
+#include <rdr/FdInStream.h>
+#include <rdr/FdOutStream.h>
+#include <rdr/FileInStream.h>
+#include <rdr/MemOutStream.h>
+
+#include <network/UnixSocket.h>
+
+#include <rfb/CConnection.h>
+#include <rfb/CMsgReader.h>
+#include <rfb/CMsgWriter.h>
+#include <rfb/PixelBuffer.h>
+#include <rfb/SDesktop.h>
+#include <rfb/SecurityClient.h>
+#include <rfb/SecurityServer.h>
+#include <rfb/VNCServerST.h>
+#include <rfb/encodings.h>
+
+#include "util.h"
+
+static core::IntParameter clientCount("clients",
+                                      "Number of simulated clients",
+                                      1, 1, 64);
+static core::IntParameter bandwidth("bandwidth",
+                                    "Bandwidth of each client link in "
+                                    "kbit/s (0 = unlimited)",
+                                    0, 0, INT_MAX);
+static core::IntParameter rtt("rtt",
+                              "Round trip time of each client link in ms",
+                              0, 0, 10000);
+static core::IntParameter interval("interval",
+                                   "Time between updates in ms, if the "
+                                   "trace has no timing information",
+                                   40, 1, 10000);
+static core::StringParameter encoding("encoding",
+                                      "Preferred encoding of the clients",
+                                      "Tight");
+static core::IntParameter quality("quality",
+                                  "JPEG quality level of the clients "
+                                  "(-1 = lossless)",
+                                  8, -1, 9);
+
+static core::BoolParameter json("json",
+                                "Print the results as JSON, for perfrun.py",
+                                false);
+
+static const rfb::PixelFormat fbPF(32, 24, false, true,
+                                   255, 255, 255, 0, 8, 16);
+
+// How long we wait for the clients to catch up after the trace has
+// ended (in seconds)
+static const double drainTimeout = 10.0;
+
+static double now()
+{
+  struct timeval tv;
+
+  gettimeofday(&tv, nullptr);
+
+  return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+// CPU time of the calling thread, which is the one running the server
+static double threadCpu()
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+
+  return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+
+static void setNonBlocking(int fd)
+{
+  if (fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) < 0)
+    throw core::posix_error("fcntl", errno);
+}
+
+class DummyOutStream : public rdr::OutStream {
+public:
+  DummyOutStream()
+  {
+    ptr = buf;
+    end = buf + sizeof(buf);
+  }
+
+  size_t length() override { return 0; }
+  void flush() override { ptr = buf; }
+
+private:
+  void overrun(size_t) override { flush(); }
+
+  uint8_t buf[16384];
+};
+
+// Decodes the trace in to the frame buffer the server exports
+class TracePlayer : public rfb::CConnection {
+public:
+  TracePlayer(const char* filename);
+  ~TracePlayer();
+
+  // nextUpdate() decodes the next update in the trace and returns
+  // the region it changed, or false if the trace has ended
+  bool nextUpdate(core::Region* changed);
+
+  void initDone() override;
+  void resizeFramebuffer() override;
+  void framebufferUpdateEnd() override;
+  bool dataRect(const core::Rect& r, int encoding) override;
+  void setColourMapEntries(int, int, uint16_t*) override {}
+  void bell() override {}
+  void serverCutText(const char*) override {}
+  void getUserPasswd(bool, std::string*, std::string*) override {}
+  bool showMsgBox(rfb::MsgBoxFlags, const char*, const char*) override
+  {
+    return true;
+  }
+
+  rfb::ModifiablePixelBuffer* fb() { return getFramebuffer(); }
+
+private:
+  rdr::FileInStream in;
+  DummyOutStream out;
+
+  core::Region damage;
+  bool updateDone;
+};
+
+class TraceDesktop : public rfb::SDesktop {
+public:
+  TraceDesktop() : server(nullptr) {}
+
+  void init(rfb::VNCServer* vs) override { server = vs; }
+  void queryConnection(network::Socket* sock, const char*) override
+  {
+    server->approveConnection(sock, true, nullptr);
+  }
+  void terminate() override {}
+
+private:
+  rfb::VNCServer* server;
+};
+
+// One direction of a simulated network link. Data is read from one
+// socket and written to another once the link would have delivered
+// it.
+class Pipe {
+public:
+  Pipe(int in, int out, size_t bandwidth, double delay);
+
+  // Which sockets we need to wait for and for how long
+  void prepare(fd_set* rfds, fd_set* wfds, double* timeout);
+  void process(const fd_set* rfds, const fd_set* wfds);
+
+  size_t getDelivered() const { return delivered; }
+
+private:
+  struct Chunk {
+    std::vector<uint8_t> data;
+    size_t offset;
+    double ready;
+  };
+
+  int in, out;
+  size_t bandwidth;
+  double delay;
+  size_t maxQueued;
+
+  std::list<Chunk> chunks;
+  size_t queued;
+  double nextFree;
+
+  size_t delivered;
+};
+
+struct ClientStats {
+  unsigned updates;
+  double first, last;
+  std::vector<double> latencies;
+};
+
+class SimClient : public rfb::CConnection {
+public:
+  SimClient(int fd, const std::vector<double>* injected, double delay);
+  ~SimClient();
+
+  network::Socket* getSocket() { return sock; }
+
+  void process();
+
+  void initDone() override;
+  void framebufferUpdateStart() override;
+  void framebufferUpdateEnd() override;
+  void setColourMapEntries(int, int, uint16_t*) override {}
+  void bell() override {}
+  void serverCutText(const char*) override {}
+  void getUserPasswd(bool, std::string*, std::string*) override {}
+  bool showMsgBox(rfb::MsgBoxFlags, const char*, const char*) override
+  {
+    return true;
+  }
+
+  // Has the client seen all updates injected so far?
+  bool caughtUp() const { return seen == injected->size(); }
+
+  ClientStats stats;
+
+private:
+  network::Socket* sock;
+
+  const std::vector<double>* injected;
+  double delay;
+  size_t seen;
+  double updateStart;
+};
+
+TracePlayer::TracePlayer(const char* filename)
+  : in(filename), updateDone(false)
+{
+  setStreams(&in, &out);
+
+  // Need to skip the initial handshake
+  setState(RFBSTATE_INITIALISATION);
+  // That also means that the reader and writer weren't setup
+  setReader(new rfb::CMsgReader(this, &in));
+  setWriter(new rfb::CMsgWriter(&server, &out));
+
+  // Get the ServerInit, so that the frame buffer is ready
+  while (getFramebuffer() == nullptr)
+    processMsg();
+}
+
+TracePlayer::~TracePlayer()
+{
+}
+
+bool TracePlayer::nextUpdate(core::Region* changed)
+{
+  updateDone = false;
+  damage.clear();
+
+  try {
+    while (!updateDone)
+      processMsg();
+  } catch (rdr::end_of_stream&) {
+    return false;
+  }
+
+  *changed = damage;
+
+  return true;
+}
+
+void TracePlayer::initDone()
+{
+  setFramebuffer(new rfb::ManagedPixelBuffer(fbPF, server.width(),
+                                             server.height()));
+}
+
+void TracePlayer::resizeFramebuffer()
+{
+  // The server holds on to our frame buffer
+  throw std::runtime_error("Frame buffer resizes are not supported");
+}
+
+void TracePlayer::framebufferUpdateEnd()
+{
+  CConnection::framebufferUpdateEnd();
+
+  updateDone = true;
+}
+
+bool TracePlayer::dataRect(const core::Rect& r, int encoding_)
+{
+  if (!CConnection::dataRect(r, encoding_))
+    return false;
+
+  damage.assign_union(r);
+
+  return true;
+}
+
+Pipe::Pipe(int in_, int out_, size_t bandwidth_, double delay_)
+  : in(in_), out(out_), bandwidth(bandwidth_), delay(delay_),
+    queued(0), nextFree(0), delivered(0)
+{
+  // Like a router, only buffer about one round trip's worth of data
+  // so that the sender notices when the link is full
+  if (bandwidth == 0)
+    maxQueued = 4 * 1024 * 1024;
+  else
+    maxQueued = bandwidth * delay * 2 + 65536;
+}
+
+void Pipe::prepare(fd_set* rfds, fd_set* wfds, double* timeout)
+{
+  if (queued < maxQueued)
+    FD_SET(in, rfds);
+
+  if (!chunks.empty()) {
+    double wait;
+
+    wait = chunks.front().ready - now();
+    if (wait <= 0)
+      FD_SET(out, wfds);
+    else if (wait < *timeout)
+      *timeout = wait;
+  }
+}
+
+void Pipe::process(const fd_set* rfds, const fd_set*)
+{
+  double time;
+
+  time = now();
+
+  if (FD_ISSET(in, rfds)) {
+    Chunk chunk;
+    ssize_t len;
+
+    chunk.data.resize(65536);
+    len = recv(in, chunk.data.data(), chunk.data.size(), 0);
+    if (len == 0)
+      throw rdr::end_of_stream();
+    if ((len < 0) && (errno != EAGAIN) && (errno != EINTR))
+      throw core::socket_error("recv", errno);
+
+    if (len > 0) {
+      chunk.data.resize(len);
+      chunk.offset = 0;
+
+      // The link can only send one thing at a time
+      if (bandwidth != 0) {
+        nextFree = std::max(nextFree, time) + (double)len / bandwidth;
+        chunk.ready = nextFree + delay;
+      } else {
+        chunk.ready = time + delay;
+      }
+
+      queued += len;
+      chunks.push_back(std::move(chunk));
+    }
+  }
+
+  while (!chunks.empty() && (chunks.front().ready <= time)) {
+    Chunk& chunk = chunks.front();
+    ssize_t len;
+
+    len = send(out, chunk.data.data() + chunk.offset,
+               chunk.data.size() - chunk.offset, MSG_DONTWAIT);
+    if (len < 0) {
+      if ((errno == EAGAIN) || (errno == EINTR))
+        break;
+      throw core::socket_error("send", errno);
+    }
+
+    chunk.offset += len;
+    queued -= len;
+    delivered += len;
+
+    if (chunk.offset == chunk.data.size())
+      chunks.pop_front();
+  }
+}
+
+SimClient::SimClient(int fd, const std::vector<double>* injected_,
+                     double delay_)
+  : injected(injected_), delay(delay_), seen(0), updateStart(0)
+{
+  stats.updates = 0;
+  stats.first = stats.last = 0;
+
+  sock = new network::UnixSocket(fd);
+  setStreams(&sock->inStream(), &sock->outStream());
+
+  // Or we would kick each other out
+  setShared(true);
+
+  setPreferredEncoding(rfb::encodingNum(encoding));
+  setQualityLevel(quality);
+
+  initialiseProtocol();
+}
+
+SimClient::~SimClient()
+{
+  delete sock;
+}
+
+void SimClient::process()
+{
+  while (processMsg())
+    ;
+  sock->outStream().flush();
+}
+
+void SimClient::initDone()
+{
+  setFramebuffer(new rfb::ManagedPixelBuffer(fbPF, server.width(),
+                                             server.height()));
+}
+
+void SimClient::framebufferUpdateStart()
+{
+  CConnection::framebufferUpdateStart();
+
+  updateStart = now();
+}
+
+void SimClient::framebufferUpdateEnd()
+{
+  double time, sent;
+
+  CConnection::framebufferUpdateEnd();
+
+  time = now();
+
+  stats.updates++;
+  if (stats.first == 0)
+    stats.first = time;
+  stats.last = time;
+
+  // Anything injected before the server started sending this update
+  // should be included in it
+  sent = updateStart - delay;
+  while ((seen < injected->size()) && ((*injected)[seen] <= sent)) {
+    stats.latencies.push_back(time - (*injected)[seen]);
+    seen++;
+  }
+}
+
+static std::vector<double> readTimes(const char* filename)
+{
+  std::vector<double> times;
+  std::string timesName;
+  unsigned long long offset, usecs;
+  FILE* f;
+
+  timesName = filename;
+  if ((timesName.size() > 4) &&
+      (timesName.compare(timesName.size() - 4, 4, ".rfb") == 0))
+    timesName.resize(timesName.size() - 4);
+  timesName += ".times";
+
+  f = fopen(timesName.c_str(), "r");
+  if (f == nullptr)
+    return times;
+
+  while (fscanf(f, "%llu %llu", &offset, &usecs) == 2)
+    times.push_back(usecs / 1000000.0);
+
+  fclose(f);
+
+  // Make them relative to the first update
+  for (size_t i = 1; i < times.size(); i++)
+    times[i] -= times[0];
+  if (!times.empty())
+    times[0] = 0;
+
+  return times;
+}
+
+// When the next update from the trace should be replayed
+static double nextDue(const std::vector<double>& times, size_t updates,
+                      double start)
+{
+  if (times.empty())
+    return start + updates * interval / 1000.0;
+
+  // Past the end we are just checking for the end of the trace
+  if (updates >= times.size())
+    return start + times.back();
+
+  return start + times[updates];
+}
+
+static double percentile(std::vector<double> values, double p)
+{
+  size_t index;
+
+  if (values.empty())
+    return 0;
+
+  std::sort(values.begin(), values.end());
+
+  index = (size_t)(p * (values.size() - 1) + 0.5);
+
+  return values[index];
+}
+
+static void printStats(const std::vector<SimClient*>& clients,
+                       const std::vector<Pipe*>& pipes,
+                       size_t traceUpdates, double start, double end,
+                       double traceEnd, double serverCpu, double totalCpu)
+{
+  size_t i;
+
+  printf("Trace updates: %u in %g s\n", (unsigned)traceUpdates,
+         traceEnd - start);
+  printf("CPU time (server): %g s (%g %% of a core)\n",
+         serverCpu, serverCpu / (end - start) * 100);
+  printf("CPU time (clients): %g s\n", totalCpu - serverCpu);
+
+  for (i = 0; i < clients.size(); i++) {
+    const ClientStats& stats = clients[i]->stats;
+    double duration;
+
+    duration = stats.last - stats.first;
+
+    printf("Client %d:\n", (int)i + 1);
+    printf("  Updates: %u (%g fps)\n", stats.updates,
+           duration > 0 ? (stats.updates - 1) / duration : 0);
+    printf("  Latency: median %.1f ms, 95th percentile %.1f ms, "
+           "maximum %.1f ms\n",
+           percentile(stats.latencies, 0.5) * 1000,
+           percentile(stats.latencies, 0.95) * 1000,
+           percentile(stats.latencies, 1.0) * 1000);
+    printf("  Received: %g KiB/s\n",
+           pipes[i * 2]->getDelivered() / 1024.0 / (end - start));
+  }
+}
+
+static void usage(const char *argv0)
+{
+  fprintf(stderr, "Syntax: %s [options] <rfb file>\n", argv0);
+  fprintf(stderr, "Options:\n");
+  core::Configuration::listParams(79, 14);
+  exit(1);
+}
+
+int main(int argc, char **argv)
+{
+  int i;
+
+  const char *fn;
+
+  std::vector<double> times, injected;
+  TracePlayer* player;
+  TraceDesktop desktop;
+  rfb::VNCServerST* server;
+  std::vector<SimClient*> clients;
+  std::vector<Pipe*> pipes;
+  size_t traceUpdates;
+  bool started, traceDone;
+  double start, end, traceEnd;
+  double serverCpu, totalCpu;
+  cpucounter_t processCounter;
+
+  fn = nullptr;
+  for (i = 1; i < argc;) {
+    int ret;
+
+    ret = core::Configuration::handleParamArg(argc, argv, i);
+    if (ret > 0) {
+      i += ret;
+      continue;
+    }
+
+    if (strcmp(argv[i], "-h") == 0 ||
+        strcmp(argv[i], "--help") == 0) {
+      usage(argv[0]);
+    }
+
+    if (argv[i][0] == '-') {
+      fprintf(stderr, "%s: Unrecognized option '%s'\n",
+              argv[0], argv[i]);
+      fprintf(stderr, "See '%s --help' for more information.\n",
+              argv[0]);
+      exit(1);
+    }
+
+    if (fn != nullptr) {
+      fprintf(stderr, "%s: Extra argument '%s'\n", argv[0], argv[i]);
+      fprintf(stderr, "See '%s --help' for more information.\n",
+              argv[0]);
+      exit(1);
+    }
+
+    fn = argv[i];
+    i++;
+  }
+
+  if (fn == nullptr) {
+    fprintf(stderr, "No file specified!\n\n");
+    usage(argv[0]);
+  }
+
+  if (rfb::encodingNum(encoding) == -1) {
+    fprintf(stderr, "Unknown encoding '%s'\n", (const char*)encoding);
+    exit(1);
+  }
+
+  rfb::SecurityServer::secTypes.setParam("None");
+  rfb::SecurityClient::secTypes.setParam("None");
+
+  try {
+    player = new TracePlayer(fn);
+  } catch (std::exception& e) {
+    fprintf(stderr, "Failed to open rfb file: %s\n", e.what());
+    exit(1);
+  }
+
+  times = readTimes(fn);
+
+  server = new rfb::VNCServerST("replayperf", &desktop);
+  server->setPixelBuffer(player->fb());
+
+  // Each client gets a link made out of two socket pairs, with us
+  // relaying the data in between
+  for (i = 0; i < clientCount; i++) {
+    int serverPair[2], clientPair[2];
+    network::Socket* sock;
+    size_t bytesPerSec;
+    double delay;
+
+    if ((socketpair(AF_UNIX, SOCK_STREAM, 0, serverPair) < 0) ||
+        (socketpair(AF_UNIX, SOCK_STREAM, 0, clientPair) < 0)) {
+      perror("socketpair");
+      exit(1);
+    }
+
+    for (int fd : {serverPair[0], serverPair[1],
+                   clientPair[0], clientPair[1]})
+      setNonBlocking(fd);
+
+    bytesPerSec = (size_t)bandwidth * 1000 / 8;
+    delay = rtt / 2000.0;
+
+    pipes.push_back(new Pipe(serverPair[1], clientPair[1],
+                             bytesPerSec, delay));
+    pipes.push_back(new Pipe(clientPair[1], serverPair[1], 0, delay));
+
+    sock = new network::UnixSocket(serverPair[0]);
+    server->addSocket(sock);
+
+    clients.push_back(new SimClient(clientPair[0], &injected, delay));
+  }
+
+  processCounter = newCpuCounter();
+
+  serverCpu = 0;
+  traceUpdates = 0;
+  started = false;
+  traceDone = false;
+  start = traceEnd = 0;
+
+  try {
+    while (true) {
+      fd_set rfds, wfds;
+      std::list<network::Socket*> sockets;
+      double timeout, cpuStart;
+      int nextTimer;
+      struct timeval tv;
+
+      // Don't start the clock until every client is connected and has
+      // gotten its first update
+      if (!started) {
+        started = true;
+        for (SimClient* client : clients) {
+          if (client->stats.updates == 0)
+            started = false;
+        }
+
+        if (started) {
+          start = now();
+          startCpuCounter(processCounter);
+          serverCpu = 0;
+        }
+      }
+
+      // Feed the server any updates that are due
+      while (started && !traceDone) {
+        core::Region changed;
+
+        if (nextDue(times, traceUpdates, start) > now())
+          break;
+
+        cpuStart = threadCpu();
+        if (player->nextUpdate(&changed)) {
+          server->add_changed(changed);
+          injected.push_back(now());
+          traceUpdates++;
+        } else {
+          traceDone = true;
+          traceEnd = now();
+        }
+        serverCpu += threadCpu() - cpuStart;
+      }
+
+      if (traceDone) {
+        bool caughtUp;
+
+        caughtUp = true;
+        for (SimClient* client : clients) {
+          if (!client->caughtUp())
+            caughtUp = false;
+        }
+
+        if (caughtUp)
+          break;
+
+        if (now() - traceEnd > drainTimeout) {
+          fprintf(stderr, "Clients did not catch up with the trace\n");
+          break;
+        }
+      }
+
+      FD_ZERO(&rfds);
+      FD_ZERO(&wfds);
+
+      timeout = 0.1;
+      if (started && !traceDone)
+        timeout = std::min(timeout,
+                           nextDue(times, traceUpdates, start) - now());
+
+      server->getSockets(&sockets);
+      for (network::Socket* sock : sockets) {
+        if (sock->isShutdownRead())
+          throw std::runtime_error("Server closed a client connection");
+
+        FD_SET(sock->getFd(), &rfds);
+        if (sock->outStream().hasBufferedData())
+          FD_SET(sock->getFd(), &wfds);
+      }
+
+      for (SimClient* client : clients) {
+        network::Socket* sock = client->getSocket();
+
+        FD_SET(sock->getFd(), &rfds);
+        if (sock->outStream().hasBufferedData())
+          FD_SET(sock->getFd(), &wfds);
+      }
+
+      for (Pipe* pipe : pipes)
+        pipe->prepare(&rfds, &wfds, &timeout);
+
+      cpuStart = threadCpu();
+      nextTimer = core::Timer::checkTimeouts();
+      serverCpu += threadCpu() - cpuStart;
+      if ((nextTimer >= 0) && (nextTimer / 1000.0 < timeout))
+        timeout = nextTimer / 1000.0;
+
+      if (timeout < 0)
+        timeout = 0;
+
+      tv.tv_sec = (long)timeout;
+      tv.tv_usec = (long)((timeout - tv.tv_sec) * 1000000);
+
+      if (select(FD_SETSIZE, &rfds, &wfds, nullptr, &tv) < 0) {
+        if (errno == EINTR)
+          continue;
+        throw core::socket_error("select", errno);
+      }
+
+      cpuStart = threadCpu();
+      core::Timer::checkTimeouts();
+      for (network::Socket* sock : sockets) {
+        if (FD_ISSET(sock->getFd(), &rfds))
+          server->processSocketReadEvent(sock);
+        if (FD_ISSET(sock->getFd(), &wfds))
+          server->processSocketWriteEvent(sock);
+      }
+      serverCpu += threadCpu() - cpuStart;
+
+      for (Pipe* pipe : pipes)
+        pipe->process(&rfds, &wfds);
+
+      for (SimClient* client : clients)
+        client->process();
+    }
+  } catch (std::exception& e) {
+    fprintf(stderr, "Failed to replay rfb file: %s\n", e.what());
+    exit(1);
+  }
+
+  end = now();
+
+  endCpuCounter(processCounter);
+  totalCpu = getCpuCounter(processCounter);
+  freeCpuCounter(processCounter);
+
+  if (json) {
+    double value;
+
+    jsonBegin("replayperf", fn);
+
+    value = serverCpu;
+    jsonMetric("server_cpu", "s", false, &value, 1);
+    value = totalCpu - serverCpu;
+    jsonMetric("client_cpu", "s", false, &value, 1);
+
+    for (i = 0; i < clientCount; i++) {
+      const ClientStats& stats = clients[i]->stats;
+      std::string name;
+
+      value = 0;
+      if (stats.last > stats.first)
+        value = (stats.updates - 1) / (stats.last - stats.first);
+      name = core::format("client%d/fps", i + 1);
+      jsonMetric(name.c_str(), "fps", true, &value, 1);
+
+      name = core::format("client%d/latency", i + 1);
+      jsonMetric(name.c_str(), "s", false, stats.latencies.data(),
+                 stats.latencies.size());
+    }
+
+    jsonEnd();
+  } else {
+    printStats(clients, pipes, traceUpdates, start, end, traceEnd,
+               serverCpu, totalCpu);
+  }
+
+  for (SimClient* client : clients)
+    delete client;
+  delete server;
+  for (Pipe* pipe : pipes)
+    delete pipe;
+  delete player;
+
+  return 0;
+}
@@ -21,6 +21,7 @@
 #endif
 
 #include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -180,3 +181,55 @@ double getTimeCounter(void)
 
   return time;
 }
+
+static bool firstMetric;
+
+static void jsonString(const char* str)
+{
+  putchar('"');
+  for (; *str != '\0'; str++) {
+    if ((*str == '"') || (*str == '\\'))
+      printf("\\%c", *str);
+    else if ((unsigned char)*str < 0x20)
+      printf("\\u%04x", (unsigned char)*str);
+    else
+      putchar(*str);
+  }
+  putchar('"');
+}
+
+void jsonBegin(const char* tool, const char* input)
+{
+  printf("{\"tool\": ");
+  jsonString(tool);
+  printf(", \"input\": ");
+  jsonString(input != nullptr ? input : "");
+  printf(", \"metrics\": [");
+
+  firstMetric = true;
+}
+
+void jsonMetric(const char* name, const char* unit, bool higherIsBetter,
+                const double* samples, int count)
+{
+  int i;
+
+  if (!firstMetric)
+    printf(",");
+  firstMetric = false;
+
+  printf("\n  {\"name\": ");
+  jsonString(name);
+  printf(", \"unit\": ");
+  jsonString(unit);
+  printf(", \"better\": \"%s\", \"samples\": [",
+         higherIsBetter ? "higher" : "lower");
+  for (i = 0; i < count; i++)
+    printf("%s%.9g", i == 0 ? "" : ", ", samples[i]);
+  printf("]}");
+}
+
+void jsonEnd(void)
+{
+  printf("\n]}\n");
+}
@@ -39,4 +39,12 @@ void endTimeCounter(void);
 
 double getTimeCounter(void);
 
+// Machine readable results, as read by perfrun.py. A report has a
+// number of metrics, each with all the samples that were measured.
+
+void jsonBegin(const char* tool, const char* input);
+void jsonMetric(const char* name, const char* unit, bool higherIsBetter,
+                const double* samples, int count);
+void jsonEnd(void);
+
 #endif
@@ -0,0 +1,95 @@
+/* Copyright (C) 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <gtest/gtest.h>
+
+#include <rdr/BufferPool.h>
+#include <rdr/MemOutStream.h>
+
+TEST(BufferPool, roundUp)
+{
+  uint8_t* buffer;
+  size_t size;
+
+  size = 1;
+  buffer = rdr::BufferPool::get(&size);
+  EXPECT_EQ(size, 1024u);
+  rdr::BufferPool::put(buffer, size);
+
+  size = 5000;
+  buffer = rdr::BufferPool::get(&size);
+  EXPECT_EQ(size, 8192u);
+  rdr::BufferPool::put(buffer, size);
+}
+
+TEST(BufferPool, reuse)
+{
+  uint8_t *buffer, *buffer2;
+  size_t size;
+  unsigned long long allocs;
+
+  size = 100000;
+  buffer = rdr::BufferPool::get(&size);
+  rdr::BufferPool::put(buffer, size);
+
+  allocs = rdr::BufferPool::heapAllocations();
+
+  buffer2 = rdr::BufferPool::get(&size);
+  EXPECT_EQ(buffer, buffer2);
+  EXPECT_EQ(rdr::BufferPool::heapAllocations(), allocs);
+  rdr::BufferPool::put(buffer2, size);
+}
+
+TEST(BufferPool, tooLarge)
+{
+  uint8_t* buffer;
+  size_t size;
+  unsigned long long allocs;
+
+  allocs = rdr::BufferPool::heapAllocations();
+
+  size = 32 * 1024 * 1024 + 1;
+  buffer = rdr::BufferPool::get(&size);
+  EXPECT_EQ(size, 32u * 1024 * 1024 + 1);
+  EXPECT_EQ(rdr::BufferPool::heapAllocations(), allocs + 1);
+  rdr::BufferPool::put(buffer, size);
+}
+
+TEST(BufferPool, streams)
+{
+  unsigned long long allocs;
+
+  // Warm up the pool with every size the stream will pass through
+  {
+    rdr::MemOutStream mos;
+    mos.pad(200000);
+  }
+
+  allocs = rdr::BufferPool::heapAllocations();
+
+  for (int i = 0; i < 10; i++) {
+    rdr::MemOutStream mos;
+    mos.pad(i % 2 ? 200000 : 10);
+  }
+
+  EXPECT_EQ(rdr::BufferPool::heapAllocations(), allocs);
+}
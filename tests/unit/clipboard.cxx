@@ -0,0 +1,370 @@
+/* Copyright (C) 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <gtest/gtest.h>
+
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <rdr/BufferedInStream.h>
+#include <rdr/MemOutStream.h>
+#include <rdr/ZlibOutStream.h>
+
+#include <core/Configuration.h>
+
+#include <rfb/CConnection.h>
+#include <rfb/CMsgReader.h>
+#include <rfb/CMsgWriter.h>
+#include <rfb/ClientParams.h>
+#include <rfb/SMsgWriter.h>
+#include <rfb/clipboardTypes.h>
+#include <rfb/encodings.h>
+
+// Hands out the given data a limited number of bytes at a time, to
+// check that messages split across reads are handled
+class TrickleInStream : public rdr::BufferedInStream {
+public:
+  TrickleInStream(const uint8_t* data_, size_t length_, size_t chunk_)
+    : data(data_), length(length_), chunk(chunk_) {}
+
+  bool exhausted() { return length == 0; }
+
+private:
+  bool fillBuffer() override
+  {
+    size_t n;
+
+    n = std::min(std::min(chunk, length), availSpace());
+    if (n == 0)
+      return false;
+
+    memcpy((uint8_t*)end, data, n);
+    end += n;
+    data += n;
+    length -= n;
+
+    return true;
+  }
+
+  const uint8_t* data;
+  size_t length;
+  size_t chunk;
+};
+
+class ClipboardReceiver : public rfb::CConnection {
+public:
+  ClipboardReceiver(const uint8_t* data, size_t length, size_t chunk)
+    : in(data, length, chunk)
+  {
+    setStreams(&in, &out);
+    setState(RFBSTATE_NORMAL);
+    setReader(new rfb::CMsgReader(this, &in));
+    setWriter(new rfb::CMsgWriter(&server, &out));
+  }
+
+  void receive()
+  {
+    while (processMsg() || !in.exhausted())
+      ;
+  }
+
+  void handleClipboardProvide(uint32_t flags, const size_t* lengths,
+                              const uint8_t* const* data) override
+  {
+    providedFlags.push_back(flags);
+    rfb::CConnection::handleClipboardProvide(flags, lengths, data);
+  }
+
+  void handleClipboardData(const char* data) override
+  {
+    events.push_back(data);
+  }
+
+  void bell() override { events.push_back("bell"); }
+
+  void initDone() override {}
+  void setColourMapEntries(int, int, uint16_t*) override {}
+  void serverCutText(const char*) override {}
+  void getUserPasswd(bool, std::string*, std::string*) override {}
+  bool showMsgBox(rfb::MsgBoxFlags, const char*, const char*) override
+  {
+    return true;
+  }
+
+  std::vector<std::string> events;
+  std::vector<uint32_t> providedFlags;
+
+private:
+  TrickleInStream in;
+  rdr::MemOutStream out;
+};
+
+static std::string makeText(size_t length)
+{
+  std::string text;
+
+  while (text.size() < length)
+    text += "Line " + std::to_string(text.size() * 7919 % 65521) + "\n";
+  text.resize(length);
+
+  return text;
+}
+
+static std::vector<uint8_t> compress(uint32_t flags,
+                                     const std::vector<std::string>& formats)
+{
+  rdr::MemOutStream mos;
+  rdr::ZlibOutStream zos;
+  size_t count;
+
+  zos.setUnderlying(&mos);
+
+  count = 0;
+  for (int i = 0; i < 16; i++) {
+    if (!(flags & (1 << i)))
+      continue;
+    // Include the terminating null, like SConnection does
+    zos.writeU32(formats[count].size() + 1);
+    zos.writeBytes((const uint8_t*)formats[count].c_str(),
+                   formats[count].size() + 1);
+    count++;
+  }
+
+  zos.flush();
+  zos.setUnderlying(nullptr);
+
+  return std::vector<uint8_t>((const uint8_t*)mos.data(),
+                              (const uint8_t*)mos.data() + mos.length());
+}
+
+static void setupClient(rfb::ClientParams* client)
+{
+  const int32_t encodings[] = { rfb::pseudoEncodingExtendedClipboard };
+  const uint32_t lengths[] = { 1024 * 1024 };
+
+  client->setEncodings(1, encodings);
+  client->setClipboardCaps(rfb::clipboardUTF8 | rfb::clipboardProvide,
+                           lengths);
+}
+
+// A provide message with the given data, followed by a bell
+static std::vector<uint8_t> provideStream(uint32_t flags,
+                                          const std::vector<uint8_t>& data)
+{
+  rfb::ClientParams client;
+  rdr::MemOutStream out;
+  rfb::SMsgWriter writer(&client, &out);
+
+  setupClient(&client);
+
+  writer.writeClipboardProvideStart(flags, data.size());
+  writer.writeClipboardProvideData(data.data(), data.size());
+  writer.writeBell();
+
+  return std::vector<uint8_t>((const uint8_t*)out.data(),
+                              (const uint8_t*)out.data() + out.length());
+}
+
+// Garbage after the start of the zlib data means that anything that
+// tries to decompress it will fail
+static void corrupt(std::vector<uint8_t>* data, size_t offset)
+{
+  for (size_t i = offset; i < data->size(); i++)
+    (*data)[i] = 0xff;
+}
+
+TEST(Clipboard, heldBack)
+{
+  rfb::ClientParams client;
+  rdr::MemOutStream out;
+  rfb::SMsgWriter writer(&client, &out);
+  std::vector<uint8_t> data;
+  size_t before;
+
+  setupClient(&client);
+
+  data = compress(rfb::clipboardUTF8, { makeText(1000) });
+
+  writer.writeClipboardProvideStart(rfb::clipboardUTF8, data.size());
+  EXPECT_TRUE(writer.isClipboardInProgress());
+
+  writer.writeClipboardProvideData(data.data(), 10);
+
+  // Can't go in the middle of the clipboard data
+  before = out.length();
+  writer.writeBell();
+  EXPECT_EQ(out.length(), before);
+
+  writer.writeClipboardProvideData(data.data() + 10, data.size() - 10);
+  EXPECT_FALSE(writer.isClipboardInProgress());
+  EXPECT_EQ(out.length(), before + data.size() - 10 + 1);
+
+  EXPECT_THROW(writer.writeClipboardProvideData(data.data(), 1),
+               std::logic_error);
+}
+
+TEST(Clipboard, roundTrip)
+{
+  rfb::ClientParams client;
+  rdr::MemOutStream out;
+  rfb::SMsgWriter writer(&client, &out);
+  std::string text;
+  std::vector<uint8_t> data, stream;
+
+  setupClient(&client);
+
+  text = makeText(200 * 1024);
+  data = compress(rfb::clipboardUTF8, { text });
+
+  writer.writeBell();
+
+  writer.writeClipboardProvideStart(rfb::clipboardUTF8, data.size());
+  for (size_t offset = 0; offset < data.size(); offset += 4096) {
+    writer.writeClipboardProvideData(data.data() + offset,
+                                     std::min((size_t)4096,
+                                              data.size() - offset));
+    if (offset == 0)
+      writer.writeBell();
+  }
+
+  writer.writeBell();
+
+  stream.assign((const uint8_t*)out.data(),
+                (const uint8_t*)out.data() + out.length());
+
+  for (size_t chunk : { stream.size(), (size_t)1 }) {
+    ClipboardReceiver receiver(stream.data(), stream.size(), chunk);
+
+    receiver.receive();
+
+    ASSERT_EQ(receiver.events.size(), 4u);
+    EXPECT_EQ(receiver.events[0], "bell");
+    EXPECT_EQ(receiver.events[1], text);
+    EXPECT_EQ(receiver.events[2], "bell");
+    EXPECT_EQ(receiver.events[3], "bell");
+  }
+}
+
+TEST(Clipboard, tooLong)
+{
+  rfb::ClientParams client;
+  rdr::MemOutStream out;
+  rfb::SMsgWriter writer(&client, &out);
+  std::string text, rtf;
+  std::vector<uint8_t> data, stream;
+
+  setupClient(&client);
+
+  // Larger than the default MaxCutText, so it is skipped whilst the
+  // other format is kept
+  text = makeText(1000);
+  rtf = makeText(300 * 1024);
+  data = compress(rfb::clipboardUTF8 | rfb::clipboardRTF, { text, rtf });
+
+  writer.writeClipboardProvideStart(rfb::clipboardUTF8 | rfb::clipboardRTF,
+                                    data.size());
+  writer.writeClipboardProvideData(data.data(), data.size());
+  writer.writeBell();
+
+  stream.assign((const uint8_t*)out.data(),
+                (const uint8_t*)out.data() + out.length());
+
+  for (size_t chunk : { stream.size(), (size_t)3 }) {
+    ClipboardReceiver receiver(stream.data(), stream.size(), chunk);
+
+    receiver.receive();
+
+    ASSERT_EQ(receiver.providedFlags.size(), 1u);
+    EXPECT_EQ(receiver.providedFlags[0],
+              rfb::clipboardUTF8 | rfb::clipboardProvide);
+
+    ASSERT_EQ(receiver.events.size(), 2u);
+    EXPECT_EQ(receiver.events[0], text);
+    EXPECT_EQ(receiver.events[1], "bell");
+  }
+}
+
+TEST(Clipboard, messageTooLong)
+{
+  std::vector<uint8_t> data, stream;
+
+  // Would inflate to several times MaxCutText, and the compressed
+  // data is also larger than it
+  data = compress(rfb::clipboardUTF8, { makeText(4 * 1024 * 1024) });
+  ASSERT_GT(data.size(), 256u * 1024u);
+  corrupt(&data, 64 * 1024);
+
+  stream = provideStream(rfb::clipboardUTF8, data);
+
+  core::Configuration::setParam("MaxCutText", "16777216");
+  {
+    ClipboardReceiver receiver(stream.data(), stream.size(),
+                               stream.size());
+    EXPECT_THROW(receiver.receive(), std::exception);
+  }
+  core::Configuration::setParam("MaxCutText", "262144");
+
+  for (size_t chunk : { stream.size(), (size_t)1000 }) {
+    ClipboardReceiver receiver(stream.data(), stream.size(), chunk);
+
+    receiver.receive();
+
+    EXPECT_TRUE(receiver.providedFlags.empty());
+    ASSERT_EQ(receiver.events.size(), 1u);
+    EXPECT_EQ(receiver.events[0], "bell");
+  }
+}
+
+TEST(Clipboard, dataTooLong)
+{
+  std::vector<uint8_t> data, stream;
+
+  // Compresses to almost nothing, but would inflate far past
+  // MaxCutText, and takes the format after it along with it
+  data = compress(rfb::clipboardUTF8 | rfb::clipboardRTF,
+                  { std::string(16 * 1024 * 1024, 'a'), "rtf" });
+  ASSERT_LT(data.size(), 256u * 1024u);
+  corrupt(&data, 1024);
+
+  stream = provideStream(rfb::clipboardUTF8 | rfb::clipboardRTF, data);
+
+  core::Configuration::setParam("MaxCutText", "33554432");
+  {
+    ClipboardReceiver receiver(stream.data(), stream.size(),
+                               stream.size());
+    EXPECT_THROW(receiver.receive(), std::exception);
+  }
+  core::Configuration::setParam("MaxCutText", "262144");
+
+  for (size_t chunk : { stream.size(), (size_t)100 }) {
+    ClipboardReceiver receiver(stream.data(), stream.size(), chunk);
+
+    receiver.receive();
+
+    EXPECT_TRUE(receiver.providedFlags.empty());
+    ASSERT_EQ(receiver.events.size(), 1u);
+    EXPECT_EQ(receiver.events[0], "bell");
+  }
+}
@@ -0,0 +1,280 @@
+/* Copyright (C) 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <gtest/gtest.h>
+
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+#include <rdr/BufferedInStream.h>
+#include <rdr/MemOutStream.h>
+
+#include <rfb/CConnection.h>
+#include <rfb/CMsgReader.h>
+#include <rfb/CMsgWriter.h>
+#include <rfb/ClientParams.h>
+#include <rfb/Cursor.h>
+#include <rfb/CursorCache.h>
+#include <rfb/PixelBuffer.h>
+#include <rfb/SMsgWriter.h>
+#include <rfb/encodings.h>
+
+static const rfb::PixelFormat fbPF(32, 24, false, true,
+                                   255, 255, 255, 0, 8, 16);
+
+// Hands out the given data a limited number of bytes at a time, to
+// check that messages split across reads are handled
+class TrickleInStream : public rdr::BufferedInStream {
+public:
+  TrickleInStream(const uint8_t* data_, size_t length_, size_t chunk_)
+    : data(data_), length(length_), chunk(chunk_) {}
+
+  bool exhausted() { return length == 0; }
+
+private:
+  bool fillBuffer() override
+  {
+    size_t n;
+
+    n = std::min(std::min(chunk, length), availSpace());
+    if (n == 0)
+      return false;
+
+    memcpy((uint8_t*)end, data, n);
+    end += n;
+    data += n;
+    length -= n;
+
+    return true;
+  }
+
+  const uint8_t* data;
+  size_t length;
+  size_t chunk;
+};
+
+class CursorReceiver : public rfb::CConnection {
+public:
+  CursorReceiver(const uint8_t* data, size_t length, size_t chunk)
+    : in(data, length, chunk)
+  {
+    supportsLocalCursor = true;
+    supportsCursorCache = true;
+
+    setStreams(&in, &out);
+    setState(RFBSTATE_NORMAL);
+    setReader(new rfb::CMsgReader(this, &in));
+    setWriter(new rfb::CMsgWriter(&server, &out));
+
+    server.setDimensions(16, 16);
+    server.setPF(fbPF);
+    setFramebuffer(new rfb::ManagedPixelBuffer(fbPF, 16, 16));
+  }
+
+  void receive()
+  {
+    while (processMsg() || !in.exhausted())
+      ;
+  }
+
+  void setCursor(int width, int height, const core::Point& hotspot,
+                 const uint8_t* data) override
+  {
+    cursors.emplace_back(width, height, hotspot, data);
+    rfb::CConnection::setCursor(width, height, hotspot, data);
+  }
+
+  void initDone() override {}
+  void setColourMapEntries(int, int, uint16_t*) override {}
+  void bell() override {}
+  void serverCutText(const char*) override {}
+  void getUserPasswd(bool, std::string*, std::string*) override {}
+  bool showMsgBox(rfb::MsgBoxFlags, const char*, const char*) override
+  {
+    return true;
+  }
+
+  std::vector<rfb::Cursor> cursors;
+
+private:
+  TrickleInStream in;
+  rdr::MemOutStream out;
+};
+
+static std::vector<uint8_t> makeCursor(int width, int height,
+                                       uint8_t seed)
+{
+  std::vector<uint8_t> data(width * height * 4);
+
+  for (size_t i = 0; i < data.size(); i++)
+    data[i] = seed + i * 13;
+
+  return data;
+}
+
+TEST(CursorCache, lookup)
+{
+  rfb::CursorCache cache;
+  std::vector<uint8_t> a, b;
+  uint32_t id, id2;
+
+  a = makeCursor(16, 16, 1);
+  b = makeCursor(16, 16, 2);
+
+  EXPECT_FALSE(cache.lookup(16, 16, a.data(), &id));
+
+  id = cache.add(16, 16, a.data());
+  EXPECT_TRUE(cache.lookup(16, 16, a.data(), &id2));
+  EXPECT_EQ(id, id2);
+
+  EXPECT_FALSE(cache.lookup(16, 16, b.data(), &id2));
+  // Same pixels, different shape
+  EXPECT_FALSE(cache.lookup(8, 32, a.data(), &id2));
+}
+
+TEST(CursorCache, get)
+{
+  rfb::CursorCache cache;
+  std::vector<uint8_t> a;
+  const uint8_t* data;
+
+  a = makeCursor(16, 8, 1);
+
+  EXPECT_FALSE(cache.get(5, 16, 8, &data));
+
+  cache.add(5, 16, 8, a.data());
+
+  ASSERT_TRUE(cache.get(5, 16, 8, &data));
+  EXPECT_EQ(memcmp(data, a.data(), a.size()), 0);
+
+  EXPECT_FALSE(cache.get(5, 8, 16, &data));
+  EXPECT_FALSE(cache.get(6, 16, 8, &data));
+}
+
+TEST(CursorCache, empty)
+{
+  rfb::CursorCache server, client;
+  const uint8_t* data;
+  uint32_t id;
+
+  id = server.add(0, 0, nullptr);
+  client.add(id, 0, 0, nullptr);
+
+  EXPECT_TRUE(server.lookup(0, 0, nullptr, &id));
+  EXPECT_TRUE(client.get(id, 0, 0, &data));
+}
+
+TEST(CursorCache, sameOrderAsServer)
+{
+  rfb::CursorCache server, client;
+  std::vector<std::vector<uint8_t>> cursors;
+  uint32_t id;
+
+  for (int i = 0; i < (int)rfb::cursorCacheSize * 2; i++)
+    cursors.push_back(makeCursor(8, 8, i));
+
+  for (size_t i = 0; i < cursors.size(); i++) {
+    id = server.add(8, 8, cursors[i].data());
+    client.add(id, 8, 8, cursors[i].data());
+
+    // Keep using the first one so the order differs from insertion
+    if (server.lookup(8, 8, cursors[0].data(), &id)) {
+      const uint8_t* data;
+      EXPECT_TRUE(client.get(id, 8, 8, &data));
+    }
+  }
+
+  EXPECT_TRUE(server.lookup(8, 8, cursors[0].data(), &id));
+  EXPECT_FALSE(server.lookup(8, 8, cursors[1].data(), &id));
+
+  for (size_t i = 0; i < cursors.size(); i++) {
+    const uint8_t* data;
+
+    if (!server.lookup(8, 8, cursors[i].data(), &id))
+      continue;
+
+    ASSERT_TRUE(client.get(id, 8, 8, &data));
+    EXPECT_EQ(memcmp(data, cursors[i].data(), cursors[i].size()), 0);
+  }
+}
+
+static std::vector<uint8_t> writeCursors(const std::vector<rfb::Cursor>& cursors)
+{
+  const int32_t encodings[] = { rfb::pseudoEncodingCursorCache };
+  rfb::ClientParams client;
+  rdr::MemOutStream out;
+  rfb::SMsgWriter writer(&client, &out);
+
+  client.setEncodings(1, encodings);
+
+  for (const rfb::Cursor& cursor : cursors) {
+    client.setCursor(cursor);
+    writer.writeCursor();
+    writer.writeFramebufferUpdateStart(0);
+    writer.writeFramebufferUpdateEnd();
+  }
+
+  return std::vector<uint8_t>((const uint8_t*)out.data(),
+                              (const uint8_t*)out.data() + out.length());
+}
+
+TEST(CursorCache, roundTrip)
+{
+  std::vector<uint8_t> a, b;
+  std::vector<rfb::Cursor> cursors;
+  std::vector<uint8_t> stream;
+
+  a = makeCursor(16, 16, 1);
+  b = makeCursor(8, 4, 2);
+
+  // Empty cursors are sent whenever the server draws the cursor
+  // itself, so they will be references after the first time
+  cursors.emplace_back(16, 16, core::Point(1, 2), a.data());
+  cursors.emplace_back(0, 0, core::Point(0, 0), nullptr);
+  cursors.emplace_back(8, 4, core::Point(3, 3), b.data());
+  cursors.emplace_back(0, 0, core::Point(0, 0), nullptr);
+  cursors.emplace_back(16, 16, core::Point(1, 2), a.data());
+  cursors.emplace_back(0, 0, core::Point(0, 0), nullptr);
+  cursors.emplace_back(8, 4, core::Point(3, 3), b.data());
+
+  stream = writeCursors(cursors);
+
+  for (size_t chunk : { stream.size(), (size_t)1 }) {
+    CursorReceiver receiver(stream.data(), stream.size(), chunk);
+
+    receiver.receive();
+
+    ASSERT_EQ(receiver.cursors.size(), cursors.size());
+    for (size_t i = 0; i < cursors.size(); i++) {
+      const rfb::Cursor& sent = cursors[i];
+      const rfb::Cursor& received = receiver.cursors[i];
+
+      EXPECT_EQ(received.width(), sent.width());
+      EXPECT_EQ(received.height(), sent.height());
+      EXPECT_EQ(received.hotspot(), sent.hotspot());
+      EXPECT_EQ(memcmp(received.getBuffer(), sent.getBuffer(),
+                       sent.width() * sent.height() * 4), 0);
+    }
+  }
+}
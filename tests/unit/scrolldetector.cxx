@@ -0,0 +1,130 @@
+/* Copyright (C) 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <gtest/gtest.h>
+
+#include <core/Region.h>
+
+#include <rfb/PixelBuffer.h>
+#include <rfb/ScrollDetector.h>
+
+static const rfb::PixelFormat fbPF(32, 24, false, true,
+                                   255, 255, 255, 0, 8, 16);
+
+// Fills the buffer with content where every row and column is unique,
+// offset by the given amount
+static void fillPattern(rfb::ManagedPixelBuffer* pb, int dx, int dy)
+{
+  uint32_t* data;
+  int stride;
+
+  data = (uint32_t*)pb->getBufferRW(pb->getRect(), &stride);
+  for (int y = 0; y < pb->height(); y++) {
+    for (int x = 0; x < pb->width(); x++)
+      data[y * stride + x] = ((y - dy) * 7919) ^ ((x - dx) * 104729);
+  }
+  pb->commitBufferRW(pb->getRect());
+}
+
+TEST(ScrollDetector, vertical)
+{
+  rfb::ManagedPixelBuffer oldFb(fbPF, 200, 200);
+  rfb::ManagedPixelBuffer newFb(fbPF, 200, 200);
+  rfb::ScrollDetector detector;
+  core::Region dest;
+  core::Point delta;
+
+  fillPattern(&oldFb, 0, 0);
+  fillPattern(&newFb, 0, -30);
+
+  ASSERT_TRUE(detector.detect(&oldFb, &newFb, oldFb.getRect(),
+                              &dest, &delta));
+  EXPECT_EQ(delta, core::Point(0, -30));
+  EXPECT_EQ(dest, core::Region({0, 0, 200, 170}));
+}
+
+TEST(ScrollDetector, horizontal)
+{
+  rfb::ManagedPixelBuffer oldFb(fbPF, 200, 200);
+  rfb::ManagedPixelBuffer newFb(fbPF, 200, 200);
+  rfb::ScrollDetector detector;
+  core::Region dest;
+  core::Point delta;
+
+  fillPattern(&oldFb, 0, 0);
+  fillPattern(&newFb, 25, 0);
+
+  ASSERT_TRUE(detector.detect(&oldFb, &newFb, oldFb.getRect(),
+                              &dest, &delta));
+  EXPECT_EQ(delta, core::Point(25, 0));
+  EXPECT_EQ(dest, core::Region({25, 0, 200, 200}));
+}
+
+TEST(ScrollDetector, partial)
+{
+  rfb::ManagedPixelBuffer oldFb(fbPF, 200, 200);
+  rfb::ManagedPixelBuffer newFb(fbPF, 200, 200);
+  rfb::ScrollDetector detector;
+  core::Region dest;
+  core::Point delta;
+
+  fillPattern(&oldFb, 0, 0);
+  fillPattern(&newFb, 0, 0);
+
+  // Only a part of the screen scrolls
+  newFb.copyRect({50, 70, 150, 150}, {0, 20});
+
+  ASSERT_TRUE(detector.detect(&oldFb, &newFb, {50, 50, 150, 150},
+                              &dest, &delta));
+  EXPECT_EQ(delta, core::Point(0, 20));
+  EXPECT_EQ(dest, core::Region({50, 70, 150, 150}));
+}
+
+TEST(ScrollDetector, unrelated)
+{
+  rfb::ManagedPixelBuffer oldFb(fbPF, 200, 200);
+  rfb::ManagedPixelBuffer newFb(fbPF, 200, 200);
+  rfb::ScrollDetector detector;
+  core::Region dest;
+  core::Point delta;
+
+  fillPattern(&oldFb, 0, 0);
+  newFb.fillRect(newFb.getRect(), "\x12\x34\x56\x78");
+
+  EXPECT_FALSE(detector.detect(&oldFb, &newFb, oldFb.getRect(),
+                               &dest, &delta));
+}
+
+TEST(ScrollDetector, unchanged)
+{
+  rfb::ManagedPixelBuffer oldFb(fbPF, 200, 200);
+  rfb::ManagedPixelBuffer newFb(fbPF, 200, 200);
+  rfb::ScrollDetector detector;
+  core::Region dest;
+  core::Point delta;
+
+  fillPattern(&oldFb, 0, 0);
+  fillPattern(&newFb, 0, 0);
+
+  EXPECT_FALSE(detector.detect(&oldFb, &newFb, oldFb.getRect(),
+                               &dest, &delta));
+}
@@ -0,0 +1,266 @@
+/* Copyright (C) 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/stat.h>
+
+#include <gtest/gtest.h>
+
+#include <core/string.h>
+
+#include <rdr/FileInStream.h>
+#include <rdr/MemOutStream.h>
+
+#include <rfb/CConnection.h>
+#include <rfb/CMsgReader.h>
+#include <rfb/CMsgWriter.h>
+#include <rfb/PixelBuffer.h>
+#include <rfb/SessionRecorder.h>
+#include <rfb/UpdateTracker.h>
+
+static const rfb::PixelFormat fbPF(32, 24, false, true,
+                                   255, 255, 255, 0, 8, 16);
+
+class Player : public rfb::CConnection {
+public:
+  Player(const char* filename) : in(filename)
+  {
+    setStreams(&in, &out);
+    setState(RFBSTATE_INITIALISATION);
+    setReader(new rfb::CMsgReader(this, &in));
+    setWriter(new rfb::CMsgWriter(&server, &out));
+  }
+
+  void play()
+  {
+    try {
+      while (true)
+        processMsg();
+    } catch (rdr::end_of_stream&) {
+    }
+  }
+
+  void initDone() override
+  {
+    setFramebuffer(new rfb::ManagedPixelBuffer(fbPF, server.width(),
+                                               server.height()));
+  }
+
+  void setColourMapEntries(int, int, uint16_t*) override {}
+  void bell() override {}
+  void serverCutText(const char*) override {}
+  void getUserPasswd(bool, std::string*, std::string*) override {}
+  bool showMsgBox(rfb::MsgBoxFlags, const char*, const char*) override
+  {
+    return true;
+  }
+
+  const rfb::PixelBuffer* fb() { return getFramebuffer(); }
+
+private:
+  rdr::FileInStream in;
+  rdr::MemOutStream out;
+};
+
+class SessionRecorderTest : public ::testing::Test {
+protected:
+  void SetUp() override
+  {
+    char tmpl[] = "/tmp/sessionrecorderXXXXXX";
+
+    ASSERT_NE(mkdtemp(tmpl), nullptr);
+    dir = tmpl;
+    prefix = dir + "/rec";
+  }
+
+  void TearDown() override
+  {
+    for (int i = 0; i < 16; i++) {
+      unlink(fileName(i, "rfb").c_str());
+      unlink(fileName(i, "times").c_str());
+    }
+    rmdir(dir.c_str());
+  }
+
+  std::string fileName(int n, const char* suffix)
+  {
+    return core::format("%s-%03d.%s", prefix.c_str(), n, suffix);
+  }
+
+  std::vector<unsigned long long> readTimes(int n)
+  {
+    std::vector<unsigned long long> offsets;
+    unsigned long long offset, usecs;
+    FILE* f;
+
+    f = fopen(fileName(n, "times").c_str(), "r");
+    if (f == nullptr)
+      return offsets;
+    while (fscanf(f, "%llu %llu", &offset, &usecs) == 2)
+      offsets.push_back(offset);
+    fclose(f);
+
+    return offsets;
+  }
+
+  std::string dir;
+  std::string prefix;
+};
+
+static void fillRect(rfb::ManagedPixelBuffer* pb, const core::Rect& r,
+                     uint32_t seed)
+{
+  uint32_t* data;
+  int stride;
+
+  data = (uint32_t*)pb->getBufferRW(r, &stride);
+  for (int y = 0; y < r.height(); y++) {
+    for (int x = 0; x < r.width(); x++)
+      data[y * stride + x] = (seed + y * 7919 + (x / 4) * 104729) & 0xffffff;
+  }
+  pb->commitBufferRW(r);
+}
+
+static bool sameContents(const rfb::PixelBuffer* a,
+                         const rfb::PixelBuffer* b)
+{
+  const uint8_t *bufA, *bufB;
+  int strideA, strideB;
+
+  if ((a->width() != b->width()) || (a->height() != b->height()))
+    return false;
+
+  bufA = a->getBuffer(a->getRect(), &strideA);
+  bufB = b->getBuffer(b->getRect(), &strideB);
+  for (int y = 0; y < a->height(); y++) {
+    if (memcmp(bufA + y * strideA * 4, bufB + y * strideB * 4,
+               a->width() * 4) != 0)
+      return false;
+  }
+
+  return true;
+}
+
+static void update(rfb::SessionRecorder* recorder,
+                   rfb::ManagedPixelBuffer* pb, const core::Rect& r,
+                   uint32_t seed)
+{
+  rfb::UpdateInfo ui;
+
+  fillRect(pb, r, seed);
+  ui.changed = r;
+  EXPECT_TRUE(recorder->writeUpdate(ui, pb, "test"));
+}
+
+TEST_F(SessionRecorderTest, records)
+{
+  rfb::SessionRecorder* recorder;
+  rfb::ManagedPixelBuffer pb(fbPF, 200, 100);
+  std::vector<unsigned long long> offsets;
+
+  recorder = new rfb::SessionRecorder(prefix.c_str(), 1024 * 1024);
+  update(recorder, &pb, pb.getRect(), 1);
+  update(recorder, &pb, {10, 10, 50, 30}, 2);
+  update(recorder, &pb, {100, 50, 180, 90}, 3);
+  delete recorder;
+
+  Player player(fileName(0, "rfb").c_str());
+  player.play();
+  EXPECT_TRUE(sameContents(&pb, player.fb()));
+  EXPECT_EQ(player.server.name(), std::string("test"));
+
+  offsets = readTimes(0);
+  ASSERT_EQ(offsets.size(), 3U);
+  // ServerInit, with the name, comes first
+  EXPECT_EQ(offsets[0], 24U + 4U);
+  EXPECT_LT(offsets[0], offsets[1]);
+  EXPECT_LT(offsets[1], offsets[2]);
+
+  EXPECT_EQ(access(fileName(1, "rfb").c_str(), F_OK), -1);
+}
+
+TEST_F(SessionRecorderTest, private)
+{
+  rfb::SessionRecorder* recorder;
+  rfb::ManagedPixelBuffer pb(fbPF, 200, 100);
+  mode_t oldMask;
+  struct stat st;
+
+  oldMask = umask(022);
+  recorder = new rfb::SessionRecorder(prefix.c_str(), 1024 * 1024);
+  update(recorder, &pb, pb.getRect(), 1);
+  delete recorder;
+  umask(oldMask);
+
+  ASSERT_EQ(stat(fileName(0, "rfb").c_str(), &st), 0);
+  EXPECT_EQ(st.st_mode & 0777, 0600U);
+  ASSERT_EQ(stat(fileName(0, "times").c_str(), &st), 0);
+  EXPECT_EQ(st.st_mode & 0777, 0600U);
+}
+
+TEST_F(SessionRecorderTest, rotates)
+{
+  rfb::SessionRecorder* recorder;
+  rfb::ManagedPixelBuffer pb(fbPF, 200, 100);
+
+  recorder = new rfb::SessionRecorder(prefix.c_str(), 1);
+  update(recorder, &pb, pb.getRect(), 1);
+  update(recorder, &pb, {10, 10, 50, 30}, 2);
+  update(recorder, &pb, {100, 50, 180, 90}, 3);
+  delete recorder;
+
+  // Every file should be complete on its own
+  for (int i = 0; i < 3; i++) {
+    Player player(fileName(i, "rfb").c_str());
+    player.play();
+    EXPECT_EQ(readTimes(i).size(), 1U);
+    if (i == 2) {
+      EXPECT_TRUE(sameContents(&pb, player.fb()));
+    }
+  }
+}
+
+TEST_F(SessionRecorderTest, resize)
+{
+  rfb::SessionRecorder* recorder;
+  rfb::ManagedPixelBuffer pb(fbPF, 200, 100);
+
+  recorder = new rfb::SessionRecorder(prefix.c_str(), 1024 * 1024);
+  update(recorder, &pb, pb.getRect(), 1);
+  pb.setSize(300, 150);
+  update(recorder, &pb, pb.getRect(), 2);
+  update(recorder, &pb, {10, 10, 50, 30}, 3);
+  delete recorder;
+
+  Player first(fileName(0, "rfb").c_str());
+  first.play();
+  EXPECT_EQ(first.server.width(), 200);
+
+  Player second(fileName(1, "rfb").c_str());
+  second.play();
+  EXPECT_TRUE(sameContents(&pb, second.fb()));
+  EXPECT_EQ(readTimes(1).size(), 2U);
+}
@@ -0,0 +1,244 @@
+/* Copyright (C) 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include <gtest/gtest.h>
+
+#include <rdr/FdInStream.h>
+#include <rdr/FdOutStream.h>
+
+#include <rfb/SharedMemory.h>
+
+// Maps the same buffer as the server, like a client would
+static rfb::SharedMemory* attachClient(const rfb::SharedMemory* server)
+{
+  rfb::SharedMemory* client;
+
+  client = new rfb::SharedMemory(dup(server->getFd()), server->getSize());
+  client->attach();
+
+  return client;
+}
+
+TEST(SharedMemory, attach)
+{
+  rfb::SharedMemory* client;
+
+  if (!rfb::SharedMemory::isSupported())
+    GTEST_SKIP();
+
+  rfb::SharedMemory server(4096);
+  EXPECT_FALSE(server.isAttached());
+
+  client = attachClient(&server);
+  EXPECT_TRUE(server.isAttached());
+
+  delete client;
+}
+
+TEST(SharedMemory, data)
+{
+  rfb::SharedMemory* client;
+  uint8_t* dst;
+  const uint8_t* src;
+  uint32_t offset;
+
+  if (!rfb::SharedMemory::isSupported())
+    GTEST_SKIP();
+
+  rfb::SharedMemory server(4096);
+  client = attachClient(&server);
+
+  dst = server.alloc(100, &offset);
+  ASSERT_NE(dst, nullptr);
+  EXPECT_EQ(offset, 0u);
+  memset(dst, 0x42, 100);
+
+  dst = server.alloc(200, &offset);
+  ASSERT_NE(dst, nullptr);
+  EXPECT_EQ(offset, 100u);
+  memset(dst, 0x17, 200);
+
+  src = client->read(0, 100);
+  ASSERT_NE(src, nullptr);
+  EXPECT_EQ(src[0], 0x42);
+  EXPECT_EQ(src[99], 0x42);
+  client->release();
+
+  src = client->read(100, 200);
+  ASSERT_NE(src, nullptr);
+  EXPECT_EQ(src[0], 0x17);
+  EXPECT_EQ(src[199], 0x17);
+  client->release();
+
+  delete client;
+}
+
+TEST(SharedMemory, full)
+{
+  rfb::SharedMemory* client;
+  uint32_t offset;
+
+  if (!rfb::SharedMemory::isSupported())
+    GTEST_SKIP();
+
+  rfb::SharedMemory server(4096);
+  client = attachClient(&server);
+
+  EXPECT_EQ(server.alloc(5000, &offset), nullptr);
+
+  EXPECT_NE(server.alloc(3000, &offset), nullptr);
+  EXPECT_EQ(server.alloc(2000, &offset), nullptr);
+
+  // Nothing is reused until the client is done with it
+  EXPECT_NE(client->read(0, 3000), nullptr);
+  EXPECT_EQ(server.alloc(2000, &offset), nullptr);
+  client->release();
+
+  EXPECT_NE(server.alloc(2000, &offset), nullptr);
+
+  delete client;
+}
+
+TEST(SharedMemory, wrap)
+{
+  rfb::SharedMemory* client;
+  uint32_t offset;
+
+  if (!rfb::SharedMemory::isSupported())
+    GTEST_SKIP();
+
+  rfb::SharedMemory server(4096);
+  client = attachClient(&server);
+
+  ASSERT_NE(server.alloc(3000, &offset), nullptr);
+  ASSERT_NE(client->read(offset, 3000), nullptr);
+  client->release();
+
+  // Doesn't fit before the end, so goes to the start
+  ASSERT_NE(server.alloc(2000, &offset), nullptr);
+  EXPECT_EQ(offset, 0u);
+
+  // Which still has to be free
+  EXPECT_EQ(server.alloc(1500, &offset), nullptr);
+
+  EXPECT_NE(client->read(0, 2000), nullptr);
+  client->release();
+
+  ASSERT_NE(server.alloc(1500, &offset), nullptr);
+  EXPECT_EQ(offset, 2000u);
+
+  delete client;
+}
+
+TEST(SharedMemory, badOffset)
+{
+  rfb::SharedMemory* client;
+  uint32_t offset;
+
+  if (!rfb::SharedMemory::isSupported())
+    GTEST_SKIP();
+
+  rfb::SharedMemory server(4096);
+  client = attachClient(&server);
+
+  ASSERT_NE(server.alloc(100, &offset), nullptr);
+
+  EXPECT_EQ(client->read(50, 100), nullptr);
+  EXPECT_EQ(client->read(0, 5000), nullptr);
+  EXPECT_NE(client->read(0, 100), nullptr);
+
+  // Skipping to the start is only valid if the data didn't fit
+  EXPECT_EQ(client->read(0, 100), nullptr);
+
+  delete client;
+}
+
+TEST(SharedMemory, pastEnd)
+{
+  rfb::SharedMemory* client;
+  uint32_t offset;
+
+  if (!rfb::SharedMemory::isSupported())
+    GTEST_SKIP();
+
+  rfb::SharedMemory server(4096);
+  client = attachClient(&server);
+
+  ASSERT_NE(server.alloc(100, &offset), nullptr);
+  ASSERT_NE(client->read(offset, 100), nullptr);
+
+  // Right position, but would run past the end of the buffer
+  EXPECT_EQ(client->read(100, 4000), nullptr);
+  EXPECT_EQ(client->read(100, 4096), nullptr);
+
+  // Still in the right place for valid data
+  ASSERT_NE(server.alloc(200, &offset), nullptr);
+  EXPECT_NE(client->read(offset, 200), nullptr);
+
+  delete client;
+}
+
+TEST(SharedMemory, passFd)
+{
+  int sockets[2], pipeFds[2], received;
+  uint8_t data[3];
+  char c;
+
+  ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, sockets), 0);
+  ASSERT_EQ(pipe(pipeFds), 0);
+
+  rdr::FdOutStream out(sockets[0]);
+  rdr::FdInStream in(sockets[1]);
+
+  in.acceptFds(true);
+
+  out.writeU8(1);
+  out.sendFd(pipeFds[0]);
+  out.writeU8(2);
+  out.writeU8(3);
+  out.flush();
+
+  ASSERT_TRUE(in.hasData(3));
+  in.readBytes(data, 3);
+  EXPECT_EQ(data[0], 1);
+  EXPECT_EQ(data[1], 2);
+  EXPECT_EQ(data[2], 3);
+
+  received = in.takeFd();
+  ASSERT_NE(received, -1);
+  EXPECT_EQ(in.takeFd(), -1);
+
+  // Check that it is the same pipe
+  ASSERT_EQ(write(pipeFds[1], "x", 1), 1);
+  ASSERT_EQ(read(received, &c, 1), 1);
+  EXPECT_EQ(c, 'x');
+
+  close(received);
+  close(pipeFds[0]);
+  close(pipeFds[1]);
+  close(sockets[0]);
+  close(sockets[1]);
+}
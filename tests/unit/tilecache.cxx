@@ -0,0 +1,189 @@
+/* Copyright (C) 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <gtest/gtest.h>
+
+#include <rdr/MemInStream.h>
+#include <rdr/MemOutStream.h>
+
+#include <rfb/Exception.h>
+#include <rfb/PixelBuffer.h>
+#include <rfb/ServerParams.h>
+#include <rfb/TileCache.h>
+#include <rfb/TileCacheDecoder.h>
+
+static const rfb::PixelFormat fbPF(32, 24, false, true,
+                                   255, 255, 255, 0, 8, 16);
+
+static void fillTile(rfb::ManagedPixelBuffer* pb, const core::Rect& r,
+                     uint32_t seed)
+{
+  uint32_t* data;
+  int stride;
+
+  data = (uint32_t*)pb->getBufferRW(r, &stride);
+  for (int y = 0; y < r.height(); y++) {
+    for (int x = 0; x < r.width(); x++)
+      data[y * stride + x] = (seed + y * 7919 + x * 104729) & 0xffffff;
+  }
+  pb->commitBufferRW(r);
+}
+
+static void decodeOp(rfb::TileCacheDecoder* decoder,
+                     rfb::ModifiablePixelBuffer* pb,
+                     const core::Rect& r, int op, uint32_t id)
+{
+  rdr::MemOutStream wire, buffer;
+  rfb::ServerParams server;
+
+  wire.writeU8(op);
+  wire.writeU32(id);
+
+  rdr::MemInStream is(wire.data(), wire.length());
+  ASSERT_TRUE(decoder->readRect(r, &is, server, &buffer));
+  decoder->decodeRect(r, (const uint8_t*)buffer.data(), buffer.length(),
+                      server, pb);
+}
+
+TEST(TileCache, lookup)
+{
+  rfb::TileCache cache;
+  uint32_t id, id2;
+
+  cache.setMaxTiles(2);
+
+  EXPECT_FALSE(cache.lookup(1, &id));
+
+  id = cache.add(1);
+  EXPECT_TRUE(cache.lookup(1, &id2));
+  EXPECT_EQ(id, id2);
+  EXPECT_TRUE(cache.contains(1));
+  EXPECT_FALSE(cache.contains(2));
+}
+
+TEST(TileCache, evictLeastRecent)
+{
+  rfb::TileCache cache;
+  uint32_t id;
+
+  cache.setMaxTiles(2);
+
+  cache.add(1);
+  cache.add(2);
+  EXPECT_TRUE(cache.lookup(1, &id));
+  cache.add(3);
+
+  EXPECT_TRUE(cache.contains(1));
+  EXPECT_FALSE(cache.contains(2));
+  EXPECT_TRUE(cache.contains(3));
+
+  cache.setMaxTiles(1);
+  EXPECT_FALSE(cache.contains(1));
+  EXPECT_TRUE(cache.contains(3));
+}
+
+TEST(TileCache, hash)
+{
+  rfb::ManagedPixelBuffer pb(fbPF, 256, 128);
+  core::Rect a(0, 0, 64, 64), b(128, 64, 192, 128);
+
+  fillTile(&pb, a, 1);
+  fillTile(&pb, b, 1);
+  EXPECT_EQ(rfb::TileCache::hashRect(&pb, a),
+            rfb::TileCache::hashRect(&pb, b));
+
+  fillTile(&pb, b, 2);
+  EXPECT_NE(rfb::TileCache::hashRect(&pb, a),
+            rfb::TileCache::hashRect(&pb, b));
+}
+
+TEST(TileCacheDecoder, storeAndDraw)
+{
+  rfb::ManagedPixelBuffer pb(fbPF, 128, 64);
+  rfb::TileCacheDecoder decoder;
+  core::Rect a(0, 0, 64, 64), b(64, 0, 128, 64);
+  const uint8_t *dataA, *dataB;
+  int strideA, strideB;
+
+  decoder.setMaxTiles(4);
+
+  fillTile(&pb, a, 1);
+  fillTile(&pb, b, 2);
+  decodeOp(&decoder, &pb, a, rfb::tileCacheStore, 7);
+
+  decodeOp(&decoder, &pb, b, rfb::tileCacheDraw, 7);
+
+  dataA = pb.getBuffer(a, &strideA);
+  dataB = pb.getBuffer(b, &strideB);
+  for (int y = 0; y < a.height(); y++) {
+    EXPECT_EQ(memcmp(dataA + y * strideA * 4, dataB + y * strideB * 4,
+                     a.width() * 4), 0);
+  }
+}
+
+TEST(TileCacheDecoder, sameOrderAsServer)
+{
+  rfb::ManagedPixelBuffer pb(fbPF, 64, 64);
+  rfb::TileCacheDecoder decoder;
+  rfb::TileCache cache;
+  uint32_t id;
+
+  // The client may have a larger cache than the server uses
+  decoder.setMaxTiles(3);
+  cache.setMaxTiles(2);
+
+  fillTile(&pb, pb.getRect(), 1);
+
+  for (uint64_t hash = 0; hash < 10; hash++) {
+    id = cache.add(hash);
+    decodeOp(&decoder, &pb, pb.getRect(), rfb::tileCacheStore, id);
+
+    // Touch the oldest tile so the order differs from insertion
+    if ((hash > 0) && cache.lookup(hash - 1, &id))
+      decodeOp(&decoder, &pb, pb.getRect(), rfb::tileCacheDraw, id);
+  }
+
+  for (uint64_t hash = 0; hash < 10; hash++) {
+    if (!cache.lookup(hash, &id))
+      continue;
+    decodeOp(&decoder, &pb, pb.getRect(), rfb::tileCacheDraw, id);
+  }
+}
+
+TEST(TileCacheDecoder, unknownTile)
+{
+  rfb::ManagedPixelBuffer pb(fbPF, 64, 64);
+  rfb::TileCacheDecoder decoder;
+
+  decoder.setMaxTiles(4);
+
+  EXPECT_THROW(decodeOp(&decoder, &pb, pb.getRect(),
+                        rfb::tileCacheDraw, 1),
+               rfb::protocol_error);
+
+  decodeOp(&decoder, &pb, pb.getRect(), rfb::tileCacheStore, 1);
+  decodeOp(&decoder, &pb, pb.getRect(), rfb::tileCacheReset, 0);
+
+  EXPECT_THROW(decodeOp(&decoder, &pb, pb.getRect(),
+                        rfb::tileCacheDraw, 1),
+               rfb::protocol_error);
+}
@@ -53,6 +53,10 @@ core::BoolParameter
   sendPrimary("SendPrimary",
               "Send the primary as well as the selection clipboard",
               true);
+core::BoolParameter
+  zeroCopy("ZeroCopy",
+           "Encode directly from the PipeWire buffers instead of copying "
+           "each frame", false);
 
 
 static const char* defaultDesktopName()
@@ -22,6 +22,9 @@
 
 #include <assert.h>
 #include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
 
 #include <glib.h>
 #include <glib-object.h>
@@ -38,6 +41,7 @@
 #include <rfb/VNCServer.h>
 #include <rfb/PixelFormat.h>
 
+#include "../parameters.h"
 #include "PipeWireStream.h"
 #include "PipeWirePixelBuffer.h"
 
@@ -52,21 +56,26 @@ struct PipeWireCursor {
 
 static core::LogWriter vlog("PipewirePixelBuffer");
 
+// Size of the blocks that are compared when a dropped frame forces us
+// to look for changes ourselves
+static const int CompareBlockSize = 64;
+
 PipeWirePixelBuffer::PipeWirePixelBuffer(int32_t pipewireFd,
                                          uint32_t pipewireId,
                                          rfb::VNCServer* server_)
   : PipeWireStream(pipewireFd, pipewireId), server(server_),
-    lastSequence(0)
+    lastSequence(0), haveFrame(false), heldBuffer(nullptr)
 {
   cursor = new PipeWireCursor();
 }
 
 PipeWirePixelBuffer::~PipeWirePixelBuffer()
 {
+  releaseBuffer();
   delete cursor;
 }
 
-void PipeWirePixelBuffer::processBuffer(pw_buffer* buffer)
+bool PipeWirePixelBuffer::processBuffer(pw_buffer* buffer)
 {
   spa_buffer* spaBuffer;
 
@@ -74,12 +83,16 @@ void PipeWirePixelBuffer::processBuffer(pw_buffer* buffer)
 
   processDamage(spaBuffer);
   processCursor(spaBuffer);
-  processFrame(spaBuffer);
+  return processFrame(buffer);
 }
 
 void PipeWirePixelBuffer::setParameters(int width, int height,
                                         rfb::PixelFormat pf)
 {
+  // The layout of the old buffers no longer applies
+  releaseBuffer();
+  haveFrame = false;
+
   setSize(width, height);
   setPF(pf);
   pipewirePixelFormat = pf;
@@ -93,48 +106,98 @@ void PipeWirePixelBuffer::stopped()
   PipeWireStream::stopped();
 }
 
-void PipeWirePixelBuffer::processFrame(spa_buffer* buffer)
+void PipeWirePixelBuffer::bufferRemoved(pw_buffer* buffer)
+{
+  const uint8_t* data;
+  int stride;
+
+  if (buffer != heldBuffer)
+    return;
+
+  // The clients still need the current frame, so keep a copy of it
+  data = getBuffer(getRect(), &stride);
+  heldBuffer = nullptr;
+  setSize(width(), height());
+  imageRect(getRect(), data, stride);
+}
+
+bool PipeWirePixelBuffer::processFrame(pw_buffer* buffer)
 {
+  int bytesPerPixel;
   int srcStride;
   int dstStride;
   uint8_t* srcBuffer;
+  spa_buffer* spaBuffer;
   spa_chunk* chunk;
   pixman_bool_t ret;
   core::Region region;
+  core::Region copied;
   std::vector<core::Rect> rects;
   spa_meta_header* header;
   bool frameDropped;
 
-  chunk = buffer->datas[0].chunk;
+  spaBuffer = buffer->buffer;
+  chunk = spaBuffer->datas[0].chunk;
 
   if (chunk->size == 0 || chunk->flags  & SPA_CHUNK_FLAG_CORRUPTED)
-    return;
+    return false;
+
+  bytesPerPixel = pipewirePixelFormat.bpp / 8;
 
   // Check size
-  if (chunk->size != (uint32_t) (width() * height() * (pipewirePixelFormat.bpp / 8))) {
+  if (chunk->size != (uint32_t) (width() * height() * bytesPerPixel)) {
     vlog.error("Invalid chunk size: %d", chunk->size);
-    return;
+    return false;
   }
 
-  header = (spa_meta_header*)spa_buffer_find_meta_data(buffer,
+  header = (spa_meta_header*)spa_buffer_find_meta_data(spaBuffer,
                                                        SPA_META_Header,
                                                        sizeof(*header));
 
+  srcBuffer = (uint8_t*)spaBuffer->datas[0].data;
+  srcStride = chunk->stride / bytesPerPixel;
+
   // Detect dropped frames. We can't rely on the damage events we've
-  // gotten and have to mark the entire frame as damaged
+  // gotten, so we have to compare with the last frame we saw
   // https://bugs.kde.org/show_bug.cgi?id=510561
   frameDropped = (header->seq != lastSequence + 1);
   lastSequence = header->seq;
 
-  region = frameDropped ? getRect() : accumulatedDamage;
+  if (!haveFrame)
+    region = getRect();
+  else if (frameDropped)
+    region = detectChanges(srcBuffer, srcStride);
+  else
+    region = accumulatedDamage;
 
   // Clamp damage outside of framebuffer
   region = region.intersect(getRect());
 
-  srcBuffer = (uint8_t*)buffer->datas[0].data;
-  srcStride = chunk->stride / (pipewirePixelFormat.bpp / 8);
+  accumulatedDamage.clear();
+  haveFrame = true;
+
+  if (zeroCopy && (chunk->stride % bytesPerPixel == 0)) {
+    // Encode straight from this buffer and keep it until the next
+    // frame arrives, at which point the previous one can go back
+    setBuffer(width(), height(), srcBuffer, srcStride);
+    if (heldBuffer)
+      queueBuffer(heldBuffer);
+    heldBuffer = buffer;
 
-  region.get_rects(&rects);
+    server->add_changed(region);
+
+    return true;
+  }
+
+  // Our own copy is out of date if we were using PipeWire's buffer
+  if (heldBuffer) {
+    releaseBuffer();
+    copied = getRect();
+  } else {
+    copied = region;
+  }
+
+  copied.get_rects(&rects);
   for (core::Rect &rect : rects) {
     uint8_t* dstBuffer;
 
@@ -148,14 +211,82 @@ void PipeWirePixelBuffer::processFrame(spa_buffer* buffer)
     if (!ret) {
       uint8_t* damagedBuffer;
 
-      damagedBuffer = &srcBuffer[(pipewirePixelFormat.bpp / 8) *
+      damagedBuffer = &srcBuffer[bytesPerPixel *
                                 (rect.tl.y * srcStride + rect.tl.x)];
       imageRect(pipewirePixelFormat, rect, damagedBuffer, srcStride);
     }
   }
 
   server->add_changed(region);
-  accumulatedDamage.clear();
+
+  return false;
+}
+
+core::Region PipeWirePixelBuffer::detectChanges(const uint8_t* data,
+                                                int stride)
+{
+  core::Region changed;
+  const uint8_t* oldData;
+  int oldStride;
+  int bytesPerPixel;
+
+  oldData = getBuffer(getRect(), &oldStride);
+  bytesPerPixel = getPF().bpp / 8;
+
+  for (int y = 0; y < height(); y += CompareBlockSize) {
+    int h;
+    int runStart;
+
+    h = std::min(CompareBlockSize, height() - y);
+    runStart = -1;
+
+    for (int x = 0; x < width(); x += CompareBlockSize) {
+      int w;
+      const uint8_t* oldPtr;
+      const uint8_t* newPtr;
+      bool differs;
+
+      w = std::min(CompareBlockSize, width() - x);
+
+      oldPtr = oldData + (y * oldStride + x) * bytesPerPixel;
+      newPtr = data + (y * stride + x) * bytesPerPixel;
+
+      differs = false;
+      for (int i = 0; i < h; i++) {
+        if (memcmp(oldPtr, newPtr, w * bytesPerPixel) != 0) {
+          differs = true;
+          break;
+        }
+        oldPtr += oldStride * bytesPerPixel;
+        newPtr += stride * bytesPerPixel;
+      }
+
+      // Neighbouring blocks are merged to keep the region simple
+      if (differs && (runStart == -1))
+        runStart = x;
+      if (!differs && (runStart != -1)) {
+        changed.assign_union(core::Rect(runStart, y, x, y + h));
+        runStart = -1;
+      }
+    }
+
+    if (runStart != -1)
+      changed.assign_union(core::Rect(runStart, y, width(), y + h));
+  }
+
+  return changed;
+}
+
+void PipeWirePixelBuffer::releaseBuffer()
+{
+  if (!heldBuffer)
+    return;
+
+  // Our own buffer is stale at this point, so the caller needs to
+  // refresh it
+  setSize(width(), height());
+  queueBuffer(heldBuffer);
+  heldBuffer = nullptr;
 }
 
 void PipeWirePixelBuffer::processCursor(spa_buffer* buffer)
@@ -37,12 +37,13 @@ public:
   ~PipeWirePixelBuffer();
 
 private:
-  virtual void processBuffer(pw_buffer* buffer) override;
+  virtual bool processBuffer(pw_buffer* buffer) override;
   virtual void setParameters(int width, int height, rfb::PixelFormat pf) override;
   virtual void stopped() override;
+  virtual void bufferRemoved(pw_buffer* buffer) override;
 
 protected:
-  void processFrame(spa_buffer* buffer);
+  bool processFrame(pw_buffer* buffer);
   void processCursor(spa_buffer* buffer);
   void processDamage(spa_buffer* buffer);
 
@@ -52,11 +53,22 @@ protected:
                  const unsigned char* rgbaData);
   bool supportedCursorPixelformat(int format_);
 
+  // Finds the areas where the given frame differs from the current
+  // contents of the pixel buffer
+  core::Region detectChanges(const uint8_t* data, int stride);
+
+  // Switches back to our own copy of the framebuffer and gives the
+  // kept PipeWire buffer back
+  void releaseBuffer();
+
 private:
   rfb::VNCServer* server;
   rfb::PixelFormat pipewirePixelFormat;
   core::Region accumulatedDamage;
   PipeWireCursor* cursor;
   uint64_t lastSequence;
+  bool haveFrame;
+  // PipeWire buffer we are currently encoding from, if any
+  pw_buffer* heldBuffer;
 };
 #endif // __PIPEWIRE_PIXEL_BUFFER_H__
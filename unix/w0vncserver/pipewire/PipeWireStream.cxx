@@ -48,7 +48,9 @@ const pw_stream_events PipeWireStream::streamEventsHandler {
     ((PipeWireStream*)self)->handleStreamParamChanged(id, param);
    },
   .add_buffer = nullptr,
-  .remove_buffer = nullptr,
+  .remove_buffer = [](void* self, pw_buffer* buffer) {
+    ((PipeWireStream*)self)->bufferRemoved(buffer);
+  },
   .process = [](void* self) {
     ((PipeWireStream*)self)->handleProcess();
   },
@@ -303,11 +305,22 @@ void PipeWireStream::handleProcess()
     return;
   }
 
-  processBuffer(buffer);
+  // The buffer might be kept until a later frame replaces it
+  if (processBuffer(buffer))
+    return;
 
   pw_stream_queue_buffer(stream, buffer);
 }
 
+void PipeWireStream::queueBuffer(pw_buffer* buffer)
+{
+  pw_stream_queue_buffer(stream, buffer);
+}
+
+void PipeWireStream::bufferRemoved(pw_buffer* /*buffer*/)
+{
+}
+
 void PipeWireStream::stopped()
 {
   active = false;
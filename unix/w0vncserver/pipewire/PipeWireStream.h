@@ -35,6 +35,11 @@ public:
 protected:
   virtual void stopped();
 
+  // Gives back a buffer that processBuffer() decided to keep
+  void queueBuffer(pw_buffer* buffer);
+  // Called before a buffer is freed, even if it is currently kept
+  virtual void bufferRemoved(pw_buffer* buffer);
+
 private:
   void start(int nodeId);
 
@@ -45,7 +50,9 @@ private:
   void handleProcess();
 
   virtual void setParameters(int width, int height, rfb::PixelFormat pf) = 0;
-  virtual void processBuffer(pw_buffer* buffer) = 0;
+  // Returns true if the buffer should not be given back to PipeWire
+  // yet, in which case it must later be returned using queueBuffer()
+  virtual bool processBuffer(pw_buffer* buffer) = 0;
 
   rfb::PixelFormat convertPixelformat(int spaFormat);
 
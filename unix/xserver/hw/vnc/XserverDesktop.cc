@@ -82,7 +82,7 @@ XserverDesktop::XserverDesktop(int screenIndex_,
   : screenIndex(screenIndex_),
     server(0), listeners(listeners_),
     shadowFramebuffer(nullptr),
-    queryConnectId(0), queryConnectTimer(this)
+    queryConnectId(0), queryConnectTimer(this), presenting(false)
 {
   format = pf;
 
@@ -286,6 +286,9 @@ void XserverDesktop::setCursorPos(int x, int y, bool warped)
 
 void XserverDesktop::add_changed(const core::Region& region)
 {
+  if (presenting)
+    presented.assign_union(region);
+
   try {
     server->add_changed(region);
   } catch (std::exception& e) {
@@ -296,6 +299,9 @@ void XserverDesktop::add_changed(const core::Region& region)
 void XserverDesktop::add_copied(const core::Region& dest,
                                 const core::Point& delta)
 {
+  if (presenting)
+    presented.assign_union(dest);
+
   try {
     server->add_copied(dest, delta);
   } catch (std::exception& e) {
@@ -303,6 +309,15 @@ void XserverDesktop::add_copied(const core::Region& dest,
   }
 }
 
+void XserverDesktop::frameComplete(const core::Region& region)
+{
+  try {
+    server->frameComplete(region);
+  } catch (std::exception& e) {
+    vlog.error("XserverDesktop::frameComplete: %s",e.what());
+  }
+}
+
 void XserverDesktop::handleSocketEvent(int fd, bool read, bool write)
 {
   try {
@@ -501,6 +516,9 @@ void XserverDesktop::frameTick(uint64_t msc)
 {
   std::map<uint64_t, uint64_t>::iterator iter, next;
 
+  presenting = true;
+  presented.clear();
+
   for (iter = pendingMsc.begin(); iter != pendingMsc.end();) {
     next = iter; next++;
 
@@ -511,6 +529,13 @@ void XserverDesktop::frameTick(uint64_t msc)
 
     iter = next;
   }
+
+  presenting = false;
+
+  // Present has now copied out any frames that were waiting for this
+  // tick, so that area of the screen should be in a consistent state
+  if (!presented.is_empty())
+    frameComplete(presented);
 }
 
 void XserverDesktop::handleClipboardRequest()
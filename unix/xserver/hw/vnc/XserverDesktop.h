@@ -31,6 +31,7 @@
 
 #include <stdint.h>
 
+#include <core/Region.h>
 #include <core/Timer.h>
 
 #include <rfb/SDesktop.h>
@@ -75,6 +76,7 @@ public:
   void setCursorPos(int x, int y, bool warped);
   void add_changed(const core::Region& region);
   void add_copied(const core::Region& dest, const core::Point& delta);
+  void frameComplete(const core::Region& region);
   void handleSocketEvent(int fd, bool read, bool write);
   void blockHandler(int* timeout);
   bool addClient(network::Socket* sock, bool reverse, bool viewOnly);
@@ -133,6 +135,10 @@ private:
 
   std::map<uint64_t, uint64_t> pendingMsc;
 
+  // What Present draws whilst handling a frame tick
+  bool presenting;
+  core::Region presented;
+
   core::Point oldCursorPos;
 };
 #endif
@@ -427,6 +427,19 @@ void vncAddCopied(int scrIdx, int nRects,
   }
 }
 
+void vncFrameComplete(int scrIdx, int nRects,
+                      const struct UpdateRect *rects)
+{
+  core::Region region;
+
+  for (int i = 0;i < nRects;i++) {
+    region.assign_union({{rects[i].x1, rects[i].y1,
+                          rects[i].x2, rects[i].y2}});
+  }
+
+  desktop[scrIdx]->frameComplete(region);
+}
+
 void vncSetCursorSprite(int width, int height, int hotX, int hotY,
                         const unsigned char *rgbaData)
 {
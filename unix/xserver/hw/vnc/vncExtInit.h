@@ -78,6 +78,8 @@ void vncAddChanged(int scrIdx, int nRects,
 void vncAddCopied(int scrIdx, int nRects,
                   const struct UpdateRect *rects,
                   int dx, int dy);
+void vncFrameComplete(int scrIdx, int nRects,
+                      const struct UpdateRect *rects);
 
 void vncSetCursorSprite(int width, int height, int hotX, int hotY,
                         const unsigned char *rgbaData);
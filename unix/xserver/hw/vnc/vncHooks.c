@@ -382,6 +382,18 @@ static inline void add_copied(ScreenPtr pScreen, RegionPtr dst,
                (const struct UpdateRect*)RegionRects(dst), dx, dy);
 }
 
+static inline void frame_complete(ScreenPtr pScreen, RegionPtr reg)
+{
+  vncHooksScreenPtr vncHooksScreen = vncHooksScreenPrivate(pScreen);
+  if (vncHooksScreen->ignoreHooks)
+    return;
+  if (RegionNil(reg))
+    return;
+  vncFrameComplete(pScreen->myNum,
+                   RegionNumRects(reg),
+                   (const struct UpdateRect*)RegionRects(reg));
+}
+
 static inline Bool is_visible(DrawablePtr drawable)
 {
   PixmapPtr scrPixmap;
@@ -1495,6 +1507,14 @@ static RegionPtr vncHooksCopyArea(DrawablePtr pSrc, DrawablePtr pDst,
 
   add_changed(pGC->pScreen, &changed);
 
+  // Copying an off screen buffer over an entire window is what a GL
+  // buffer swap looks like, which means the application has a
+  // complete frame for us
+  if ((pDst->type == DRAWABLE_WINDOW) && is_visible(pDst) &&
+      !is_visible(pSrc) && (dstx == 0) && (dsty == 0) &&
+      (w == pDst->width) && (h == pDst->height))
+    frame_complete(pGC->pScreen, &changed);
+
   RegionUninit(&dst);
   RegionUninit(&src);
   RegionUninit(&changed);
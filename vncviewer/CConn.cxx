@@ -28,7 +28,6 @@
 #endif
 
 #include <core/LogWriter.h>
-#include <core/Timer.h>
 #include <core/string.h>
 #include <core/time.h>
 
@@ -54,6 +53,7 @@
 #include "OptionsDialog.h"
 #include "DesktopWindow.h"
 #include "PlatformPixelBuffer.h"
+#include "SocketReader.h"
 #include "i18n.h"
 #include "parameters.h"
 #include "vncviewer.h"
@@ -77,10 +77,15 @@ static const rfb::PixelFormat mediumColourPF(8, 8, false, true,
 // Time new bandwidth estimates are weighted against (in ms)
 static const unsigned bpsEstimateWindow = 1000;
 
+// Maximum time we parse messages before going back to the main loop
+// to handle input and redraws (in ms)
+static const unsigned maxProcessingTime = 10;
+
 CConn::CConn()
-  : serverPort(0), sock(nullptr), desktop(nullptr),
+  : serverPort(0), sock(nullptr), reader(nullptr), desktop(nullptr),
     updateCount(0), pixelCount(0),
-    lastServerEncoding((unsigned int)-1), bpsEstimate(20000000)
+    lastServerEncoding((unsigned int)-1), bpsEstimate(20000000),
+    latencyPingPending(false)
 {
   setShared(::shared);
 
@@ -88,12 +93,15 @@ CConn::CConn()
   supportsCursorPosition = true;
   supportsDesktopResize = true;
   supportsLEDState = true;
+  supportsCursorCache = ::cursorCache;
 
   if (customCompressLevel)
     setCompressLevel(::compressLevel);
 
   setQualityLevel(::qualityLevel);
 
+  setTileCacheSize(::tileCacheSize);
+
   OptionsDialog::addCallback(handleOptions, this);
 }
 
@@ -101,12 +109,18 @@ CConn::~CConn()
 {
   close();
 
+  logLatencyStats();
+
   OptionsDialog::removeCallback(handleOptions);
   Fl::remove_timeout(handleUpdateTimeout, this);
+  Fl::remove_timeout(handleSocketData, this);
 
   if (desktop)
     delete desktop;
 
+  // Stop the reader thread before we touch the socket ourselves
+  delete reader;
+
   if (sock) {
     struct timeval now;
 
@@ -173,10 +187,19 @@ void CConn::connect(const char* vncServerName, network::Socket* socket)
     }
   }
 
-  Fl::add_fd(sock->getFd(), FL_READ | FL_EXCEPT, socketEvent, this);
+#ifndef WIN32
+  // A server on the same host can hand us a shared framebuffer
+  if (::sharedMemory &&
+      (dynamic_cast<network::UnixSocket*>(sock) != nullptr)) {
+    sock->inStream().acceptFds(true);
+    supportsSharedMemory = true;
+  }
+#endif
+
+  reader = new SocketReader(sock, handleSocketData, this);
 
   setServerName(serverHost.c_str());
-  setStreams(&sock->inStream(), &sock->outStream());
+  setStreams(reader, &sock->outStream());
 
   initialiseProtocol();
 }
@@ -239,42 +262,45 @@ unsigned CConn::getPixelCount()
 
 unsigned CConn::getPosition()
 {
-  return sock->inStream().pos();
+  return reader->pos();
 }
 
-void CConn::socketEvent(FL_SOCKET fd, void *data)
+void CConn::handleSocketData(void *data)
 {
   CConn *cc;
   static bool recursing = false;
-  int when;
+  struct timeval start;
 
   assert(data);
   cc = (CConn*)data;
 
-  // I don't think processMsg() is recursion safe, so add this check
-  assert(!recursing);
+  // processMsg() isn't recursion safe, but the outer call will pick up
+  // any new data once it gets control back
+  if (recursing)
+    return;
 
   recursing = true;
-  Fl::remove_fd(fd);
+  Fl::remove_timeout(handleSocketData, data);
 
-  try {
-    // We might have been called to flush unwritten socket data
-    cc->sock->outStream().flush();
+  gettimeofday(&start, nullptr);
 
+  try {
     cc->getOutStream()->cork(true);
 
     // processMsg() only processes one message, so we need to loop
     // until the buffers are empty or things will stall.
     while (cc->processMsg()) {
-
-      // Make sure that the FLTK handling and the timers gets some CPU
-      // time in case of back to back messages
-      Fl::check();
-      core::Timer::checkTimeouts();
-
       // Also check if we need to stop reading and terminate
       if (should_disconnect())
         break;
+
+      // Make sure that the FLTK handling and the timers gets some CPU
+      // time in case of back to back messages. The reader thread keeps
+      // draining the socket in the mean time.
+      if (core::msSince(&start) >= maxProcessingTime) {
+        Fl::add_timeout(0.0, handleSocketData, data);
+        break;
+      }
     }
 
     cc->getOutStream()->cork(false);
@@ -301,14 +327,39 @@ void CConn::socketEvent(FL_SOCKET fd, void *data)
     abort_connection_with_unexpected_error(e);
   }
 
-  when = FL_READ | FL_EXCEPT;
-  if (cc->sock->outStream().hasBufferedData())
-    when |= FL_WRITE;
-
-  Fl::add_fd(fd, when, socketEvent, data);
+  cc->updateWriteWatch();
   recursing = false;
 }
 
+void CConn::socketEvent(FL_SOCKET fd, void *data)
+{
+  CConn *cc;
+
+  assert(data);
+  cc = (CConn*)data;
+
+  try {
+    cc->sock->outStream().flush();
+  } catch (std::exception& e) {
+    vlog.error("%s", e.what());
+    abort_connection_with_unexpected_error(e);
+    Fl::remove_fd(fd);
+    return;
+  }
+
+  cc->updateWriteWatch();
+}
+
+void CConn::updateWriteWatch()
+{
+  // Reading is handled by the SocketReader thread, so we only need to
+  // know when we can flush out any unwritten data
+  if (sock->outStream().hasBufferedData())
+    Fl::add_fd(sock->getFd(), FL_WRITE, socketEvent, this);
+  else
+    Fl::remove_fd(sock->getFd());
+}
+
 void CConn::resetPassword()
 {
     dlg.resetPassword();
@@ -371,9 +422,11 @@ void CConn::framebufferUpdateStart()
 {
   CConnection::framebufferUpdateStart();
 
-  // For bandwidth estimate
+  // For bandwidth estimate. What has already been queued up by the
+  // reader thread says nothing about the link, so we look at what
+  // arrives on the socket whilst we handle the update.
   gettimeofday(&updateStartTime, nullptr);
-  updateStartPos = sock->inStream().pos();
+  updateStartReceived = reader->bytesReceived();
 
   // Update the screen prematurely for very slow updates
   Fl::add_timeout(1.0, handleUpdateTimeout, this);
@@ -385,7 +438,7 @@ void CConn::framebufferUpdateStart()
 // appropriately, and then request another incremental update.
 void CConn::framebufferUpdateEnd()
 {
-  unsigned long long elapsed, bps, weight;
+  unsigned long long elapsed, received, bps, weight;
   struct timeval now;
 
   CConnection::framebufferUpdateEnd();
@@ -398,16 +451,24 @@ void CConn::framebufferUpdateEnd()
   elapsed += now.tv_usec - updateStartTime.tv_usec;
   if (elapsed == 0)
     elapsed = 1;
-  bps = (unsigned long long)(sock->inStream().pos() -
-                             updateStartPos) * 8 *
-                            1000000 / elapsed;
-  // Allow this update to influence things more the longer it took, to a
-  // maximum of 20% of the new value.
-  weight = elapsed * 1000 / bpsEstimateWindow;
-  if (weight > 200000)
-    weight = 200000;
-  bpsEstimate = ((bpsEstimate * (1000000 - weight)) +
-                 (bps * weight)) / 1000000;
+  received = reader->bytesReceived() - updateStartReceived;
+  // Nothing arrives if the reader thread had already queued up all of
+  // the update, which tells us nothing about the link
+  if (received > 0) {
+    bps = received * 8 * 1000000 / elapsed;
+    // Allow this update to influence things more the longer it took, to
+    // a maximum of 20% of the new value.
+    weight = elapsed * 1000 / bpsEstimateWindow;
+    if (weight > 200000)
+      weight = 200000;
+    bpsEstimate = ((bpsEstimate * (1000000 - weight)) +
+                   (bps * weight)) / 1000000;
+  }
+
+  if (latencyTrace) {
+    updateLatency.addInterval(&updateStartTime, &now);
+    writeLatencyPing();
+  }
 
   Fl::remove_timeout(handleUpdateTimeout, this);
   desktop->updateWindow();
@@ -420,6 +481,31 @@ void CConn::framebufferUpdateEnd()
   }
 }
 
+// fence() is overridden so that we can see the responses to our own
+// latency pings. Everything else is handled by CConnection.
+void CConn::fence(uint32_t flags, unsigned len, const uint8_t data[])
+{
+  struct timeval now;
+
+  CConnection::fence(flags, len, data);
+
+  if (flags & rfb::fenceFlagRequest)
+    return;
+
+  if (!latencyPingPending)
+    return;
+
+  if ((len != 1) || (data[0] != 1)) {
+    vlog.error("Fence response of unexpected type received");
+    return;
+  }
+
+  gettimeofday(&now, nullptr);
+  roundTripLatency.addInterval(&latencyPingTime, &now);
+
+  latencyPingPending = false;
+}
+
 // The rest of the callbacks are fairly self-explanatory...
 
 void CConn::bell()
@@ -480,6 +566,11 @@ void CConn::handleClipboardData(const char* data)
 
 ////////////////////// Internal methods //////////////////////
 
+int CConn::takeFd()
+{
+  return sock->inStream().takeFd();
+}
+
 void CConn::resizeFramebuffer()
 {
   desktop->resizeFramebuffer(server.width(), server.height());
@@ -581,6 +672,39 @@ void CConn::updatePixelFormat()
   }
 }
 
+// writeLatencyPing() measures the round trip to the server. The server
+// handles fences in order with everything else, so this includes any
+// time it spends on queued messages from us.
+void CConn::writeLatencyPing()
+{
+  uint8_t type;
+
+  if (!server.supportsFence)
+    return;
+
+  // Only one at a time so that queued pings don't skew the result
+  if (latencyPingPending)
+    return;
+
+  type = 1;
+  writer()->writeFence(rfb::fenceFlagRequest | rfb::fenceFlagBlockBefore,
+                       sizeof(type), &type);
+
+  gettimeofday(&latencyPingTime, nullptr);
+  latencyPingPending = true;
+}
+
+void CConn::logLatencyStats()
+{
+  if ((updateLatency.getCount() == 0) &&
+      (roundTripLatency.getCount() == 0))
+    return;
+
+  vlog.info("Update latency:");
+  updateLatency.logStats(&vlog, "Receiving and decoding");
+  roundTripLatency.logStats(&vlog, "Round trip");
+}
+
 void CConn::handleOptions(void *data)
 {
   CConn *self = (CConn*)data;
@@ -23,12 +23,14 @@
 #include <FL/Fl.H>
 
 #include <rfb/CConnection.h>
+#include <rfb/LatencyStats.h>
 
 #include "UserDialog.h"
 
 namespace network { class Socket; }
 
 class DesktopWindow;
+class SocketReader;
 
 class CConn : public rfb::CConnection
 {
@@ -46,8 +48,11 @@ public:
 
 protected:
 
-  // Callback when socket is ready (or broken)
+  // Callback when the socket reader has new data (or is broken)
+  static void handleSocketData(void *data);
+  // Callback when socket is ready for writing
   static void socketEvent(FL_SOCKET fd, void *data);
+  void updateWriteWatch();
 
   // Forget any saved password
   void resetPassword();
@@ -73,6 +78,9 @@ protected:
   void framebufferUpdateEnd() override;
   bool dataRect(const core::Rect& r, int encoding) override;
 
+  void fence(uint32_t flags, unsigned len,
+             const uint8_t data[]) override;
+
   void setCursor(int width, int height, const core::Point& hotspot,
                  const uint8_t* data) override;
   void setCursorPos(const core::Point& pos) override;
@@ -83,6 +91,8 @@ protected:
   void handleClipboardAnnounce(bool available) override;
   void handleClipboardData(const char* data) override;
 
+  int takeFd() override;
+
 private:
 
   void resizeFramebuffer() override;
@@ -92,6 +102,9 @@ private:
   void updateQualityLevel();
   void updatePixelFormat();
 
+  void writeLatencyPing();
+  void logLatencyStats();
+
   static void handleOptions(void *data);
 
   static void handleUpdateTimeout(void *data);
@@ -100,6 +113,7 @@ private:
   std::string serverHost;
   int serverPort;
   network::Socket* sock;
+  SocketReader* reader;
 
   DesktopWindow *desktop;
 
@@ -111,9 +125,14 @@ private:
   int lastServerEncoding;
 
   struct timeval updateStartTime;
-  size_t updateStartPos;
+  unsigned long long updateStartReceived;
   unsigned long long bpsEstimate;
 
+  bool latencyPingPending;
+  struct timeval latencyPingTime;
+  rfb::LatencyStats updateLatency;
+  rfb::LatencyStats roundTripLatency;
+
   UserDialog dlg;
 };
 
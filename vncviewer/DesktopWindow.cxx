@@ -63,6 +63,10 @@
 #include <Carbon/Carbon.h>
 #endif
 
+#if !defined(WIN32) && !defined(__APPLE__) && defined(HAVE_XRANDR)
+#include <X11/extensions/Xrandr.h>
+#endif
+
 // width of each "edge" region where scrolling happens,
 // as a ratio compared to the window size
 // default: 1/16th of the window size
@@ -92,7 +96,10 @@ DesktopWindow::DesktopWindow(int w, int h, CConn* cc_)
     pendingRemoteResize(false), lastResize({0, 0}),
     keyboardGrabbed(false), mouseGrabbed(false), regrabOnFocus(false),
     statsLastUpdates(0), statsLastPixels(0), statsLastPosition(0),
-    statsGraph(nullptr)
+    statsGraph(nullptr), refreshRate(0), presentPending(false),
+    presentRequested({0, 0}), lastPresent({0, 0}),
+    presentDrawPending(false), presentDrawRequested({0, 0}),
+    presentCount(0), presentLatencyTotal(0), presentLatencyMax(0)
 {
   Fl_Group* group;
 
@@ -227,6 +234,9 @@ DesktopWindow::DesktopWindow(int w, int h, CConn* cc_)
   // Adjust layout now that we're visible and know our final size
   repositionWidgets();
 
+  memset(presentLatencyHistogram, 0, sizeof(presentLatencyHistogram));
+  updateRefreshRate();
+
   // Throughput graph for debugging
   if (vlog.getLevel() >= core::LogWriter::LEVEL_DEBUG) {
     memset(&stats, 0, sizeof(stats));
@@ -267,9 +277,12 @@ DesktopWindow::~DesktopWindow()
   Fl::remove_timeout(handleFullscreenTimeout, this);
   Fl::remove_timeout(handleEdgeScroll, this);
   Fl::remove_timeout(handleStatsTimeout, this);
+  Fl::remove_timeout(handlePresentTimeout, this);
   Fl::remove_timeout(updateOverlay, this);
   Fl::remove_idle(checkFocus, this);
 
+  logPresentStats();
+
   OptionsDialog::removeCallback(handleOptions);
 
   while (!overlays.empty()) {
@@ -346,16 +359,41 @@ void DesktopWindow::updateCaption()
 
 
 // Copy the areas of the framebuffer that have been changed (damaged)
-// to the displayed window.
+// to the displayed window. Updates are coalesced so that we present
+// at most once per display refresh.
 
 void DesktopWindow::updateWindow()
 {
+  double interval;
+  unsigned elapsed;
+
   if (firstUpdate) {
     firstUpdate = false;
     remoteResize();
   }
 
-  viewport->updateWindow();
+  if (!presentPending) {
+    presentPending = true;
+    gettimeofday(&presentRequested, nullptr);
+  }
+
+  // Already waiting for the next interval?
+  if (Fl::has_timeout(handlePresentTimeout, this))
+    return;
+
+  if (refreshRate > 0)
+    interval = 1000.0 / refreshRate;
+  else
+    interval = 1000.0 / ::frameRate;
+
+  elapsed = core::msSince(&lastPresent);
+  if (elapsed >= interval) {
+    present();
+    return;
+  }
+
+  Fl::add_timeout((interval - elapsed) / 1000.0,
+                  handlePresentTimeout, this);
 }
 
 
@@ -485,6 +523,29 @@ void DesktopWindow::draw()
 
   int X, Y, W, H;
 
+  if (presentDrawPending) {
+    unsigned latency, bucket;
+
+    presentDrawPending = false;
+
+    latency = core::msSince(&presentDrawRequested);
+
+    presentCount++;
+    presentLatencyTotal += latency;
+    if (latency > presentLatencyMax)
+      presentLatencyMax = latency;
+
+    // Buckets of 0-1, 2-3, 4-7, ... 128+ ms
+    bucket = 0;
+    while ((latency >>= 1) != 0)
+      bucket++;
+    if (bucket >= sizeof(presentLatencyHistogram) /
+                  sizeof(presentLatencyHistogram[0]))
+      bucket = sizeof(presentLatencyHistogram) /
+               sizeof(presentLatencyHistogram[0]) - 1;
+    presentLatencyHistogram[bucket]++;
+  }
+
   // X11 needs an off screen buffer for compositing to avoid flicker,
   // and alpha blending doesn't work for windows on Win32
 #if !defined(__APPLE__)
@@ -722,6 +783,10 @@ void DesktopWindow::resize(int x, int y, int w, int h)
 
     repositionWidgets();
   }
+
+  // We might have moved to a different monitor
+  if (shown())
+    updateRefreshRate();
 }
 
 void DesktopWindow::addOverlayTip(const char* text, ...)
@@ -1725,6 +1790,132 @@ void DesktopWindow::handleEdgeScroll(void *data)
   Fl::repeat_timeout(EDGE_SCROLL_SECONDS_PER_FRAME, handleEdgeScroll, data);
 }
 
+void DesktopWindow::updateRefreshRate()
+{
+  double rate;
+
+  rate = 0;
+
+#if defined(WIN32)
+  HMONITOR monitor;
+  MONITORINFOEXA info;
+  DEVMODEA mode;
+
+  monitor = MonitorFromWindow(fl_xid(this), MONITOR_DEFAULTTONEAREST);
+
+  info.cbSize = sizeof(info);
+  memset(&mode, 0, sizeof(mode));
+  mode.dmSize = sizeof(mode);
+
+  if (GetMonitorInfoA(monitor, &info) &&
+      EnumDisplaySettingsA(info.szDevice, ENUM_CURRENT_SETTINGS, &mode)) {
+    // 0 and 1 mean the hardware default, which we can't know
+    if (mode.dmDisplayFrequency > 1)
+      rate = mode.dmDisplayFrequency;
+  }
+#elif !defined(__APPLE__) && defined(HAVE_XRANDR)
+  XRRScreenResources *res;
+  int cx, cy;
+
+  // Use the monitor that has the centre of the window
+  cx = x() + w() / 2;
+  cy = y() + h() / 2;
+
+  res = XRRGetScreenResourcesCurrent(fl_display,
+                                     DefaultRootWindow(fl_display));
+  if (res) {
+    for (int i = 0; (i < res->ncrtc) && (rate == 0); i++) {
+      XRRCrtcInfo *crtc;
+
+      crtc = XRRGetCrtcInfo(fl_display, res, res->crtcs[i]);
+      if (!crtc)
+        continue;
+
+      if ((crtc->mode != None) &&
+          (cx >= crtc->x) && (cx < crtc->x + (int)crtc->width) &&
+          (cy >= crtc->y) && (cy < crtc->y + (int)crtc->height)) {
+        for (int j = 0; j < res->nmode; j++) {
+          XRRModeInfo *mode = &res->modes[j];
+
+          if (mode->id != crtc->mode)
+            continue;
+
+          if ((mode->hTotal != 0) && (mode->vTotal != 0))
+            rate = (double)mode->dotClock /
+                   ((double)mode->hTotal * mode->vTotal);
+          break;
+        }
+      }
+
+      XRRFreeCrtcInfo(crtc);
+    }
+
+    XRRFreeScreenResources(res);
+  }
+#endif
+
+  if (rate == refreshRate)
+    return;
+
+  refreshRate = rate;
+
+  if (refreshRate > 0)
+    vlog.debug("Display refresh rate is %g Hz", refreshRate);
+  else
+    vlog.debug("Unknown display refresh rate, using %d Hz",
+               (int)::frameRate);
+}
+
+void DesktopWindow::present()
+{
+  Fl::remove_timeout(handlePresentTimeout, this);
+
+  gettimeofday(&lastPresent, nullptr);
+
+  // Only a single present can be in flight, so any earlier one that
+  // hasn't been drawn yet is merged with this one
+  if (!presentDrawPending) {
+    presentDrawPending = true;
+    presentDrawRequested = presentRequested;
+  }
+  presentPending = false;
+
+  viewport->updateWindow();
+}
+
+void DesktopWindow::handlePresentTimeout(void *data)
+{
+  DesktopWindow *self = (DesktopWindow*)data;
+
+  self->present();
+}
+
+void DesktopWindow::logPresentStats()
+{
+  const size_t bucketCount = sizeof(presentLatencyHistogram) /
+                             sizeof(presentLatencyHistogram[0]);
+
+  if (presentCount == 0)
+    return;
+
+  vlog.info("Screen updates: %u, average latency %g ms, maximum %u ms",
+            presentCount, (double)presentLatencyTotal / presentCount,
+            presentLatencyMax);
+
+  for (size_t i = 0; i < bucketCount; i++) {
+    if (presentLatencyHistogram[i] == 0)
+      continue;
+
+    if (i == 0)
+      vlog.info("    0-1 ms: %u", presentLatencyHistogram[i]);
+    else if (i == bucketCount - 1)
+      vlog.info("    %u+ ms: %u", 1U << i, presentLatencyHistogram[i]);
+    else
+      vlog.info("    %u-%u ms: %u", 1U << i, (1U << (i + 1)) - 1,
+                presentLatencyHistogram[i]);
+  }
+}
+
 void DesktopWindow::handleStatsTimeout(void *data)
 {
   DesktopWindow *self = (DesktopWindow*)data;
@@ -121,6 +121,11 @@ private:
 
   static void handleStatsTimeout(void *data);
 
+  void updateRefreshRate();
+  void present();
+  static void handlePresentTimeout(void *data);
+  void logPresentStats();
+
 private:
   CConn* cc;
   Fl_Scrollbar *hscroll, *vscroll;
@@ -161,6 +166,21 @@ private:
   unsigned statsLastPosition;
 
   Surface *statsGraph;
+
+  // Display refresh rate, or 0 if unknown
+  double refreshRate;
+
+  bool presentPending;
+  struct timeval presentRequested;
+  struct timeval lastPresent;
+
+  bool presentDrawPending;
+  struct timeval presentDrawRequested;
+
+  unsigned presentCount;
+  unsigned long long presentLatencyTotal;
+  unsigned presentLatencyMax;
+  unsigned presentLatencyHistogram[8];
 };
 
 #endif
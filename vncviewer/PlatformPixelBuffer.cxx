@@ -29,6 +29,7 @@
 #endif
 
 #include <stdexcept>
+#include <vector>
 
 #include <FL/Fl.H>
 #include <FL/x.H>
@@ -39,11 +40,70 @@
 
 static core::LogWriter vlog("PlatformPixelBuffer");
 
+// Every separate upload has a fixed cost, which we estimate as being
+// equivalent to this many pixels. Damage rectangles are merged when
+// the extra pixels cost less than an extra upload.
+static const int uploadOverhead = 64 * 64;
+
+// Merging is quadratic, so give up and use the bounding box if things
+// get too fragmented
+static const int maxDamageRects = 64;
+
+static void mergeDamage(const core::Region& damage,
+                        std::vector<core::Rect>* rects)
+{
+  bool merged;
+  std::vector<core::Rect> merges;
+  core::Region covered;
+
+  rects->clear();
+
+  if (damage.numRects() > maxDamageRects) {
+    rects->push_back(damage.get_bounding_rect());
+    return;
+  }
+
+  damage.get_rects(rects);
+
+  do {
+    merged = false;
+
+    for (size_t i = 0; i < rects->size() && !merged; i++) {
+      for (size_t j = i + 1; j < rects->size(); j++) {
+        core::Rect bounds;
+        int waste;
+
+        bounds = (*rects)[i].union_boundary((*rects)[j]);
+        waste = bounds.area() - (*rects)[i].area() - (*rects)[j].area();
+        if (waste > uploadOverhead)
+          continue;
+
+        (*rects)[i] = bounds;
+        rects->erase(rects->begin() + j);
+        merged = true;
+        break;
+      }
+    }
+  } while (merged);
+
+  // Merged rectangles can overlap each other, and there is no point in
+  // uploading the same pixels twice
+  merges.swap(*rects);
+  for (const core::Rect& merge : merges) {
+    std::vector<core::Rect> parts;
+
+    core::Region(merge).subtract(covered).get_rects(&parts);
+    rects->insert(rects->end(), parts.begin(), parts.end());
+
+    covered.assign_union(merge);
+  }
+}
+
 PlatformPixelBuffer::PlatformPixelBuffer(int width, int height) :
   FullFramePixelBuffer(rfb::PixelFormat(32, 24, false, true,
                                         255, 255, 255, 16, 8, 0),
                        0, 0, nullptr, 0),
-  Surface(width, height)
+  Surface(width, height), lastUpload(0)
 #if !defined(WIN32) && !defined(__APPLE__)
   , shminfo(nullptr), xim(nullptr)
 #endif
@@ -99,32 +159,47 @@ void PlatformPixelBuffer::commitBufferRW(const core::Rect& r)
   mutex.unlock();
 }
 
-core::Rect PlatformPixelBuffer::getDamage(void)
+core::Region PlatformPixelBuffer::getDamage(void)
 {
-  core::Rect r;
+  std::vector<core::Rect> rects;
+  core::Region r;
 
   mutex.lock();
-  r = damage.get_bounding_rect();
+  mergeDamage(damage, &rects);
   damage.clear();
   mutex.unlock();
 
+  lastUpload = 0;
+  for (const core::Rect& rect : rects) {
+    r.assign_union(rect);
+    lastUpload += rect.area();
+  }
+
 #if !defined(WIN32) && !defined(__APPLE__)
-  if (r.width() == 0 || r.height() == 0)
+  if (r.is_empty())
     return r;
 
   GC gc;
 
   gc = XCreateGC(fl_display, pixmap, 0, nullptr);
+  for (const core::Rect& rect : rects) {
+    if (rect.is_empty())
+      continue;
+
+    if (shminfo) {
+      XShmPutImage(fl_display, pixmap, gc, xim,
+                   rect.tl.x, rect.tl.y, rect.tl.x, rect.tl.y,
+                   rect.width(), rect.height(), False);
+    } else {
+      XPutImage(fl_display, pixmap, gc, xim,
+                rect.tl.x, rect.tl.y, rect.tl.x, rect.tl.y,
+                rect.width(), rect.height());
+    }
+  }
   if (shminfo) {
-    XShmPutImage(fl_display, pixmap, gc, xim,
-                 r.tl.x, r.tl.y, r.tl.x, r.tl.y,
-                 r.width(), r.height(), False);
     // Need to make sure the X server has finished reading the
     // shared memory before we return
     XSync(fl_display, False);
-  } else {
-    XPutImage(fl_display, pixmap, gc, xim,
-              r.tl.x, r.tl.y, r.tl.x, r.tl.y, r.width(), r.height());
   }
   XFreeGC(fl_display, gc);
 #endif
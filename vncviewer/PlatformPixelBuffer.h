@@ -42,7 +42,13 @@ public:
 
   void commitBufferRW(const core::Rect& r) override;
 
-  core::Rect getDamage(void);
+  // Returns the damaged area since the last call, after making sure
+  // it is ready to be drawn to screen
+  core::Region getDamage(void);
+
+  // Returns how many pixels the last call to getDamage() pushed out,
+  // which can be more than the damaged area
+  size_t getLastUpload() const { return lastUpload; }
 
   using rfb::FullFramePixelBuffer::width;
   using rfb::FullFramePixelBuffer::height;
@@ -50,6 +56,7 @@ public:
 protected:
   std::mutex mutex;
   core::Region damage;
+  size_t lastUpload;
 
 #if !defined(WIN32) && !defined(__APPLE__)
 protected:
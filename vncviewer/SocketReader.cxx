@@ -0,0 +1,217 @@
+/* Copyright (C) 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <assert.h>
+#include <errno.h>
+#include <string.h>
+
+#ifdef WIN32
+#include <winsock2.h>
+#define errorNumber WSAGetLastError()
+#include <core/winerrno.h>
+#else
+#include <sys/select.h>
+#define errorNumber errno
+#endif
+
+#include <set>
+
+#include <core/Exception.h>
+
+#include <rdr/FdInStream.h>
+
+#include <network/Socket.h>
+
+#include <FL/Fl.H>
+
+#include "SocketReader.h"
+
+// How much data we allow to pile up before the GUI thread has had a
+// chance to parse it
+static const size_t maxQueued = 4 * 1024 * 1024;
+
+// How often the thread checks if it has been asked to stop (in ms)
+static const int pollInterval = 100;
+
+// Readers that are still alive, so that we can ignore wake ups that
+// were queued up before a reader was destroyed. Only accessed from the
+// GUI thread.
+static std::set<SocketReader*> activeReaders;
+
+SocketReader::SocketReader(network::Socket* sock_,
+                           void (*dataCallback_)(void*),
+                           void* callbackData_)
+  : sock(sock_), dataCallback(dataCallback_),
+    callbackData(callbackData_), chunkOffset(0), queued(0),
+    received(0),
+    notified(false), stopRequested(false), exception(nullptr),
+    thread(nullptr)
+{
+  activeReaders.insert(this);
+
+  thread = new std::thread(&SocketReader::worker, this);
+}
+
+SocketReader::~SocketReader()
+{
+  std::unique_lock<std::mutex> lock(mutex);
+  stopRequested = true;
+  producerCond.notify_all();
+  lock.unlock();
+
+  thread->join();
+  delete thread;
+
+  activeReaders.erase(this);
+}
+
+unsigned long long SocketReader::bytesReceived()
+{
+  const std::lock_guard<std::mutex> lock(mutex);
+  return received;
+}
+
+bool SocketReader::fillBuffer()
+{
+  const std::lock_guard<std::mutex> lock(mutex);
+
+  if (chunks.empty()) {
+    // The thread needs to tell us when more data arrives
+    notified = false;
+
+    if (exception)
+      std::rethrow_exception(exception);
+
+    return false;
+  }
+
+  while (!chunks.empty() && (availSpace() > 0)) {
+    std::vector<uint8_t>& chunk = chunks.front();
+    size_t len;
+
+    len = chunk.size() - chunkOffset;
+    if (len > availSpace())
+      len = availSpace();
+
+    memcpy((uint8_t*)end, chunk.data() + chunkOffset, len);
+    end += len;
+
+    chunkOffset += len;
+    queued -= len;
+
+    if (chunkOffset == chunk.size()) {
+      chunks.pop_front();
+      chunkOffset = 0;
+    }
+  }
+
+  producerCond.notify_one();
+
+  return true;
+}
+
+void SocketReader::worker()
+{
+  std::unique_lock<std::mutex> lock(mutex);
+
+  while (!stopRequested) {
+    std::vector<uint8_t> chunk;
+
+    // Don't run too far ahead of the GUI thread
+    if (queued >= maxQueued) {
+      producerCond.wait(lock);
+      continue;
+    }
+
+    lock.unlock();
+
+    try {
+      rdr::InStream& is = sock->inStream();
+
+      if (waitForSocket() && is.hasData(1)) {
+        const uint8_t* data;
+        size_t len;
+
+        len = is.avail();
+        data = is.getptr(len);
+        chunk.assign(data, data + len);
+        is.setptr(len);
+      }
+    } catch (std::exception&) {
+      lock.lock();
+      exception = std::current_exception();
+      if (!notified) {
+        notified = true;
+        Fl::awake(handleAwake, this);
+      }
+      return;
+    }
+
+    lock.lock();
+
+    if (chunk.empty())
+      continue;
+
+    queued += chunk.size();
+    received += chunk.size();
+    chunks.push_back(std::move(chunk));
+
+    if (!notified) {
+      notified = true;
+      Fl::awake(handleAwake, this);
+    }
+  }
+}
+
+bool SocketReader::waitForSocket()
+{
+  int fd, n;
+
+  fd = sock->getFd();
+
+  do {
+    fd_set fds;
+    struct timeval tv;
+
+    tv.tv_sec = 0;
+    tv.tv_usec = pollInterval * 1000;
+
+    FD_ZERO(&fds);
+    FD_SET(fd, &fds);
+    n = select(fd+1, &fds, nullptr, nullptr, &tv);
+  } while (n < 0 && errorNumber == EINTR);
+
+  if (n < 0)
+    throw core::socket_error("select", errorNumber);
+
+  return n > 0;
+}
+
+void SocketReader::handleAwake(void* data)
+{
+  SocketReader* self = (SocketReader*)data;
+
+  if (activeReaders.count(self) == 0)
+    return;
+
+  self->dataCallback(self->callbackData);
+}
@@ -0,0 +1,81 @@
+/* Copyright (C) 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+//
+// SocketReader reads from a socket on a dedicated thread so that the
+// network is drained even when the GUI thread is busy redrawing. The
+// GUI thread consumes the data through the normal InStream interface
+// and never blocks on the socket.
+//
+
+#ifndef __SOCKETREADER_H__
+#define __SOCKETREADER_H__
+
+#include <condition_variable>
+#include <exception>
+#include <list>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <rdr/BufferedInStream.h>
+
+namespace network { class Socket; }
+
+class SocketReader : public rdr::BufferedInStream {
+public:
+  // The callback is invoked on the GUI thread whenever new data has
+  // arrived after fillBuffer() previously ran out of data
+  SocketReader(network::Socket* sock,
+               void (*dataCallback)(void*), void* callbackData);
+  virtual ~SocketReader();
+
+  // bytesReceived() returns how much has been read from the socket so
+  // far, including data the GUI thread has yet to consume
+  unsigned long long bytesReceived();
+
+private:
+  bool fillBuffer() override;
+
+  void worker();
+  bool waitForSocket();
+
+  static void handleAwake(void* data);
+
+private:
+  network::Socket* sock;
+
+  void (*dataCallback)(void*);
+  void* callbackData;
+
+  std::mutex mutex;
+  std::condition_variable producerCond;
+
+  std::list<std::vector<uint8_t>> chunks;
+  size_t chunkOffset;
+  size_t queued;
+  unsigned long long received;
+
+  bool notified;
+  bool stopRequested;
+  std::exception_ptr exception;
+
+  std::thread* thread;
+};
+
+#endif
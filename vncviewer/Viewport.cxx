@@ -26,6 +26,7 @@
 #include <string.h>
 
 #include <stdexcept>
+#include <vector>
 
 #include <core/LogWriter.h>
 #include <core/string.h>
@@ -185,10 +186,12 @@ const rfb::PixelFormat &Viewport::getPreferredPF()
 
 void Viewport::updateWindow()
 {
-  core::Rect r;
+  std::vector<core::Rect> rects;
 
-  r = frameBuffer->getDamage();
-  damage(FL_DAMAGE_USER1, r.tl.x + x(), r.tl.y + y(), r.width(), r.height());
+  frameBuffer->getDamage().get_rects(&rects);
+  for (const core::Rect& r : rects)
+    damage(FL_DAMAGE_USER1, r.tl.x + x(), r.tl.y + y(),
+           r.width(), r.height());
 }
 
 static const char * dotcursor_xpm[] = {
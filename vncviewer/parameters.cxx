@@ -57,6 +57,23 @@ core::IntParameter
                        "Time in milliseconds to rate-limit successive "
                        "pointer events",
                        17, 0, INT_MAX);
+core::IntParameter
+  frameRate("FrameRate",
+            "Maximum number of screen updates per second if the refresh "
+            "rate of the display cannot be determined",
+            60, 1, 1000);
+core::BoolParameter
+  latencyTrace("LatencyTrace",
+               "Measure the time spent receiving and decoding each "
+               "update, as well as the round trip to the server, and "
+               "log the results on disconnect",
+               false);
+core::BoolParameter
+  sharedMemory("SharedMemory",
+               "Let a server on the same host pass screen updates "
+               "through shared memory, when connected over a UNIX "
+               "socket",
+               false);
 core::BoolParameter
   emulateMiddleButton("EmulateMiddleButton",
                       "Emulate middle mouse button by pressing left "
@@ -141,6 +158,16 @@ core::IntParameter
   qualityLevel("QualityLevel",
                "JPEG quality level. 0 = Low, 9 = High",
                8, 0, 9);
+core::IntParameter
+  tileCacheSize("TileCacheSize",
+                "Memory (in MiB) to use for caching content the server "
+                "might send again. 0 = Disabled",
+                0, 0, 32768);
+core::BoolParameter
+  cursorCache("CursorCache",
+              "Keep recently used cursor shapes so that the server "
+              "doesn't have to send them again",
+              false);
 
 core::BoolParameter
   maximize("Maximize", "Maximize viewer window", false);
@@ -267,6 +294,9 @@ static core::VoidParameter* parameterArray[] = {
   &compressLevel,
   &rfb::CConnection::noJpeg,
   &qualityLevel,
+  &tileCacheSize,
+  &cursorCache,
+  &sharedMemory,
   /* Display */
   &fullScreen,
   &fullScreenMode,
@@ -33,6 +33,8 @@
 
 
 extern core::IntParameter pointerEventInterval;
+extern core::IntParameter frameRate;
+extern core::BoolParameter latencyTrace;
 extern core::BoolParameter emulateMiddleButton;
 extern core::BoolParameter dotWhenNoCursor; // deprecated
 extern core::BoolParameter alwaysCursor;
@@ -49,6 +51,9 @@ extern core::EnumParameter preferredEncoding;
 extern core::BoolParameter customCompressLevel;
 extern core::IntParameter compressLevel;
 extern core::IntParameter qualityLevel;
+extern core::IntParameter tileCacheSize;
+extern core::BoolParameter cursorCache;
+extern core::BoolParameter sharedMemory;
 
 extern core::BoolParameter maximize;
 extern core::BoolParameter fullScreen;
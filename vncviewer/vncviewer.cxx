@@ -56,6 +56,10 @@
 #ifdef HAVE_GNUTLS
 #include <rfb/CSecurityTLS.h>
 #endif
+#ifdef HAVE_NETTLE
+#include <rfb/CSecurityRSAAES.h>
+#include <rfb/SecurityClient.h>
+#endif
 
 #include <core/xdgdirs.h>
 
@@ -384,6 +388,10 @@ static void init_fltk()
       delete icons[i];
 #endif
 
+  // Enable thread support so that the network thread can wake us up
+  // using Fl::awake()
+  Fl::lock();
+
   // Turn off the annoying behaviour where popups track the mouse.
   fl_message_hotspot(false);
 
@@ -740,6 +748,19 @@ int main(int argc, char** argv)
 
   create_base_dirs();
 
+#ifdef HAVE_NETTLE
+  // Generating the client key for RSA-AES is slow, so get it going
+  // while the user is still picking a server
+  {
+    rfb::SecurityClient security;
+    if (security.IsSupported(rfb::secTypeRA2) ||
+        security.IsSupported(rfb::secTypeRA2ne) ||
+        security.IsSupported(rfb::secTypeRA256) ||
+        security.IsSupported(rfb::secTypeRAne256))
+      rfb::CSecurityRSAAES::prepareKeyPair();
+  }
+#endif
+
   network::Socket* sock = nullptr;
 
 #ifndef WIN32